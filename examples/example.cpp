@@ -26,7 +26,6 @@
 
 #include <inttypes.h>
 
-#include <avsystem/commons/avs_list_cxx.hpp>
 #include <avsystem/commons/avs_log.h>
 
 #include <anjay/anjay.h>
@@ -34,6 +33,8 @@
 #include <anjay/security.h>
 #include <anjay/server.h>
 
+#include "avs_log_sink.h"
+#include "avs_serve_loop.h"
 #include "avs_socket_global.h"
 
 #define ENDPOINT_NAME "urn:dev:os:anjay-mbedos-test"
@@ -67,27 +68,12 @@
 
 namespace {
 
-void serve(anjay_t *anjay,
-           AVS_LIST(avs_net_socket_t *const) sockets,
-           uint32_t timeout_ms) {
-    avs::List<avs_net_socket_t *> ready;
-    AvsSocketGlobal::poll(
-            ready, avs::ListView<avs_net_socket_t *const>(sockets), timeout_ms);
-
-    avs::ListIterator<avs_net_socket_t *> it;
-    for (it = ready.begin(); it != ready.end(); ++it) {
-        if (anjay_serve(anjay, *it)) {
-            avs_log(lwm2m, ERROR, "anjay_serve failed");
-        }
-    }
-}
-
 void serve_forever(anjay_t *anjay) {
+    AvsServeLoop loop(anjay);
     while (true) {
-        AVS_LIST(avs_net_socket_t *const) sockets = anjay_get_sockets(anjay);
-        int timeout_ms = anjay_sched_calculate_wait_time_ms(anjay, 100);
-        serve(anjay, sockets, timeout_ms);
-        anjay_sched_run(anjay);
+        if (loop.run_once()) {
+            avs_log(lwm2m, ERROR, "serve loop failed");
+        }
 
         if (anjay_all_connections_failed(anjay)) {
             anjay_transport_schedule_reconnect(anjay, ANJAY_TRANSPORT_SET_ALL);
@@ -170,16 +156,10 @@ int setup_server_object(anjay_t *anjay) {
     return 0;
 }
 
-void log_handler(avs_log_level_t level,
-                 const char *module,
-                 const char *message) {
-    (void) level;
-    (void) module;
-    printf("%s\r\n", message);
-}
-
 void lwm2m_serve(void) {
-    avs_log_set_handler(log_handler);
+    // writing logs to UART is slow, especially with trace logs enabled, so
+    // let's do that in a separate thread instead of blocking the Anjay one
+    avs_log_set_handler(AvsAsyncLogSink::handler);
     if (MBED_CONF_PLATFORM_STDIO_BAUD_RATE >= 38400) {
         avs_log_set_default_level(AVS_LOG_TRACE);
         avs_log_set_level(anjay_sched, AVS_LOG_DEBUG);
@@ -338,10 +318,15 @@ int main() {
 
     {
         AvsSocketGlobal avs(&network, 32, 1536, AVS_NET_AF_INET4);
+        // the sink holds the whole ring buffer, which would not fit on the
+        // default main thread stack
+        static AvsAsyncLogSink log_sink;
 
         thread.start(callback(lwm2m_serve));
         for (;;) {
-            ThisThread::sleep_for(1);
+            // the main thread has nothing else to do; keep it from waking up
+            // the MCU periodically
+            ThisThread::sleep_for(osWaitForever);
         }
     }
 }
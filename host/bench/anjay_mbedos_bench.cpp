@@ -0,0 +1,861 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Microbenchmarks of the integration layer, run on the host build.
+//
+// Usage: anjay-mbedos-bench [--batches N] [SUITE...]
+//
+// Available suites: poll, udp_router, containers, send_vectored, footprint,
+// socket_mode, addrinfo, time, threading, fw_update. All suites are run if
+// none are specified. Results are printed to stdout as a single JSON document,
+// so that they can be stored and compared between releases, e.g.:
+//
+// {"version": 1, "results": [
+//   {"suite": "poll", "name": "idle", "params": {"sockets": 1},
+//    "iterations": 31000, "ns_per_op": {"min": 812.3, "median": 845.1,
+//    "mean": 850.0}},
+//   ...
+// ]}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <HeapBlockDevice.h>
+#include <mbed.h>
+
+#include <mbedtls/sha256.h>
+#include <mbedtls/version.h>
+
+#include <avsystem/commons/avs_addrinfo.h>
+#include <avsystem/commons/avs_condvar.h>
+#include <avsystem/commons/avs_list_cxx.hpp>
+#include <avsystem/commons/avs_log.h>
+#include <avsystem/commons/avs_mutex.h>
+#include <avsystem/commons/avs_net.h>
+#include <avsystem/commons/avs_time.h>
+
+#include "avs_fw_update_block_device.h"
+#include "avs_small_vector.h"
+#include "avs_socket_global.h"
+
+namespace {
+
+int BATCHES = 31;
+bool FIRST_RESULT = true;
+
+class Params {
+    std::string json_;
+
+public:
+    Params &add(const char *name, long value) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%s\"%s\": %ld", json_.empty() ? "" : ", ",
+                 name, value);
+        json_ += buf;
+        return *this;
+    }
+
+    const std::string &json() const {
+        return json_;
+    }
+};
+
+void report(const char *suite,
+            const char *name,
+            const Params &params,
+            size_t batch_size,
+            std::vector<double> &batch_ns) {
+    std::sort(batch_ns.begin(), batch_ns.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < batch_ns.size(); ++i) {
+        sum += batch_ns[i];
+    }
+    printf("%s\n  {\"suite\": \"%s\", \"name\": \"%s\", \"params\": {%s}, "
+           "\"iterations\": %lu, \"ns_per_op\": {\"min\": %.1f, "
+           "\"median\": %.1f, \"mean\": %.1f}}",
+           FIRST_RESULT ? "" : ",", suite, name, params.json().c_str(),
+           (unsigned long) (batch_size * batch_ns.size()),
+           batch_ns.front() / batch_size,
+           batch_ns[batch_ns.size() / 2] / batch_size,
+           sum / batch_ns.size() / batch_size);
+    fflush(stdout);
+    FIRST_RESULT = false;
+}
+
+// Runs op() in BATCHES batches of batch_size iterations each and reports
+// per-operation statistics of the batch timings.
+template <typename Op>
+void run(const char *suite,
+         const char *name,
+         const Params &params,
+         size_t batch_size,
+         Op op) {
+    // warm-up
+    for (size_t i = 0; i < batch_size; ++i) {
+        op();
+    }
+    std::vector<double> batch_ns;
+    for (int batch = 0; batch < BATCHES; ++batch) {
+        std::chrono::steady_clock::time_point start =
+                std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batch_size; ++i) {
+            op();
+        }
+        batch_ns.push_back(std::chrono::duration<double, std::nano>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count());
+    }
+    report(suite, name, params, batch_size, batch_ns);
+}
+
+void check(avs_error_t err, const char *what) {
+    if (avs_is_err(err)) {
+        fprintf(stderr, "%s failed: category %u, code %u\n", what,
+                (unsigned) err.category, (unsigned) err.code);
+        exit(1);
+    }
+}
+
+avs_net_socket_t *udp_socket(bool reuse_addr = false) {
+    avs_net_socket_configuration_t config;
+    memset(&config, 0, sizeof(config));
+    config.reuse_addr = reuse_addr;
+    avs_net_socket_t *socket = nullptr;
+    check(avs_net_udp_socket_create(&socket, &config), "socket creation");
+    return socket;
+}
+
+avs_net_socket_t *bound_udp_socket(const char *port = "0",
+                                   bool reuse_addr = false) {
+    avs_net_socket_t *socket = udp_socket(reuse_addr);
+    check(avs_net_socket_bind(socket, "127.0.0.1", port), "bind");
+    return socket;
+}
+
+std::string local_port(avs_net_socket_t *socket) {
+    char port[16];
+    check(avs_net_socket_get_local_port(socket, port, sizeof(port)),
+          "get_local_port");
+    return port;
+}
+
+void cleanup(std::vector<avs_net_socket_t *> &sockets) {
+    for (size_t i = 0; i < sockets.size(); ++i) {
+        avs_net_socket_cleanup(&sockets[i]);
+    }
+    sockets.clear();
+}
+
+void receive_one(avs_net_socket_t *socket) {
+    char buf[64];
+    size_t size;
+    check(avs_net_socket_receive(socket, &size, buf, sizeof(buf)), "receive");
+}
+
+void bench_poll() {
+    static const int SOCKET_COUNTS[] = { 1, 2, 4, 8, 16, 32, 64 };
+    for (size_t c = 0; c < sizeof(SOCKET_COUNTS) / sizeof(*SOCKET_COUNTS);
+         ++c) {
+        std::vector<avs_net_socket_t *> sockets;
+        avs::List<avs_net_socket_t *> socket_list;
+        for (int i = 0; i < SOCKET_COUNTS[c]; ++i) {
+            sockets.push_back(bound_udp_socket());
+            socket_list.push_back(sockets.back());
+        }
+        avs::ListView<avs_net_socket_t *const> view(socket_list);
+        avs::List<avs_net_socket_t *> ready;
+        Params params;
+        params.add("sockets", SOCKET_COUNTS[c]);
+
+        run("poll", "idle", params, 1000,
+            [&] { AvsSocketGlobal::poll(ready, view, 0); });
+
+        // a datagram queued on the last socket keeps it ready until received
+        avs_net_socket_t *sender = bound_udp_socket();
+        check(avs_net_socket_send_to(sender, "x", 1, "127.0.0.1",
+                                     local_port(sockets.back()).c_str()),
+              "send_to");
+        while (ready.empty()) {
+            AvsSocketGlobal::poll(ready, view, 1000);
+        }
+        run("poll", "one_ready", params, 1000,
+            [&] { AvsSocketGlobal::poll(ready, view, 0); });
+        avs_net_socket_cleanup(&sender);
+        cleanup(sockets);
+    }
+}
+
+void bench_udp_router() {
+    static const int SOCKET_COUNTS[] = { 1, 4, 16, 64 };
+    for (size_t c = 0; c < sizeof(SOCKET_COUNTS) / sizeof(*SOCKET_COUNTS);
+         ++c) {
+        const int count = SOCKET_COUNTS[c];
+        // all "servers" share one router; each is connected to its own peer
+        std::vector<avs_net_socket_t *> servers;
+        std::vector<avs_net_socket_t *> peers;
+        std::string shared_port;
+        for (int i = 0; i < count; ++i) {
+            servers.push_back(bound_udp_socket(
+                    shared_port.empty() ? "0" : shared_port.c_str(), true));
+            if (shared_port.empty()) {
+                shared_port = local_port(servers.back());
+            }
+            peers.push_back(bound_udp_socket());
+            check(avs_net_socket_connect(peers.back(), "127.0.0.1",
+                                         shared_port.c_str()),
+                  "connect");
+            check(avs_net_socket_connect(servers.back(), "127.0.0.1",
+                                         local_port(peers.back()).c_str()),
+                  "connect");
+        }
+        Params params;
+        params.add("sockets", count);
+
+        // one datagram at a time, addressed to the last registered socket,
+        // i.e. the worst case of peer lookup
+        run("udp_router", "demux", params, 1000, [&] {
+            check(avs_net_socket_send(peers.back(), "x", 1), "send");
+            receive_one(servers.back());
+        });
+
+        // all peers send first, then datagrams are received in reverse order,
+        // so that all of them except one go through recvd_msgs_ queues
+        run("udp_router", "queue", Params(params).add("batch", count),
+            std::max(1, 1000 / count), [&] {
+                for (int i = 0; i < count; ++i) {
+                    check(avs_net_socket_send(peers[i], "x", 1), "send");
+                }
+                for (int i = count - 1; i >= 0; --i) {
+                    receive_one(servers[i]);
+                }
+            });
+        cleanup(servers);
+        cleanup(peers);
+    }
+}
+
+// Lookups in the UDP router table and in a router's socket table, as done on
+// every bind and every received datagram, respectively. "list" is the
+// avs::List of pointers previously used for both tables, "vector" is the
+// AvsSmallVector layout that replaced it, with the router's local port stored
+// in the table entry. The entry searched for is always the last one. Sockets
+// and routers are allocated between other objects, as they would be on a
+// device, so that they are not adjacent in memory.
+void bench_containers() {
+    struct FakeSocket {
+        SocketAddress remote_address;
+        char other_fields[128];
+    };
+    struct FakeRouter {
+        SocketAddress local_address;
+        char other_fields[256];
+    };
+    struct RouterEntry {
+        uint16_t port;
+        FakeRouter *router;
+    };
+    static const int ENTRY_COUNTS[] = { 1, 4, 16, 64 };
+    for (size_t c = 0; c < sizeof(ENTRY_COUNTS) / sizeof(*ENTRY_COUNTS);
+         ++c) {
+        const int count = ENTRY_COUNTS[c];
+        std::vector<FakeSocket *> sockets;
+        std::vector<FakeRouter *> routers;
+        std::vector<std::vector<char> *> spacers;
+        avs::List<FakeSocket *> socket_list;
+        avs::List<FakeRouter *> router_list;
+        AvsSmallVector<FakeSocket *, 4> socket_vector;
+        AvsSmallVector<RouterEntry, 4> router_vector;
+        for (int i = 0; i < count; ++i) {
+            sockets.push_back(new FakeSocket());
+            sockets.back()->remote_address =
+                    SocketAddress("127.0.0.1", (uint16_t) (10000 + i));
+            spacers.push_back(new std::vector<char>(96));
+            routers.push_back(new FakeRouter());
+            routers.back()->local_address =
+                    SocketAddress("0.0.0.0", (uint16_t) (20000 + i));
+            spacers.push_back(new std::vector<char>(96));
+            socket_list.push_back(sockets.back());
+            router_list.push_back(routers.back());
+            socket_vector.push_back(sockets.back());
+            RouterEntry entry = { routers.back()->local_address.get_port(),
+                                  routers.back() };
+            router_vector.push_back(entry);
+        }
+        const SocketAddress peer = sockets.back()->remote_address;
+        const SocketAddress local = routers.back()->local_address;
+        volatile uintptr_t sink = 0;
+        Params params;
+        params.add("entries", count);
+
+        run("containers", "socket_lookup_list", params, 1000, [&] {
+            for (avs::ListIterator<FakeSocket *> it = socket_list.begin();
+                 it != socket_list.end(); ++it) {
+                if ((*it)->remote_address == peer) {
+                    sink = (uintptr_t) *it;
+                    break;
+                }
+            }
+        });
+        run("containers", "socket_lookup_vector", params, 1000, [&] {
+            for (FakeSocket **it = socket_vector.begin();
+                 it != socket_vector.end(); ++it) {
+                if ((*it)->remote_address == peer) {
+                    sink = (uintptr_t) *it;
+                    break;
+                }
+            }
+        });
+        run("containers", "router_lookup_list", params, 1000, [&] {
+            for (avs::ListIterator<FakeRouter *> it = router_list.begin();
+                 it != router_list.end(); ++it) {
+                if ((*it)->local_address == local) {
+                    sink = (uintptr_t) *it;
+                    break;
+                }
+            }
+        });
+        run("containers", "router_lookup_vector", params, 1000, [&] {
+            const uint16_t port = local.get_port();
+            for (RouterEntry *it = router_vector.begin();
+                 it != router_vector.end(); ++it) {
+                if (it->port == port && it->router->local_address == local) {
+                    sink = (uintptr_t) it->router;
+                    break;
+                }
+            }
+        });
+        (void) sink;
+        for (size_t i = 0; i < sockets.size(); ++i) {
+            delete sockets[i];
+            delete routers[i];
+        }
+        for (size_t i = 0; i < spacers.size(); ++i) {
+            delete spacers[i];
+        }
+    }
+}
+
+avs_net_socket_t *tcp_socket() {
+    avs_net_socket_configuration_t config;
+    memset(&config, 0, sizeof(config));
+    avs_net_socket_t *socket = nullptr;
+    check(avs_net_tcp_socket_create(&socket, &config), "socket creation");
+    return socket;
+}
+
+void receive_exact(avs_net_socket_t *socket, size_t size) {
+    char buf[2048];
+    while (size) {
+        size_t received;
+        check(avs_net_socket_receive(socket, &received, buf,
+                                     std::min(size, sizeof(buf))),
+              "receive");
+        size -= received;
+    }
+}
+
+// A block-wise transfer message: CoAP header with token, options, payload
+// marker and a payload block. "staged" assembles it in a caller-side buffer,
+// as upper layers do with a contiguous send API; "vectored" passes the parts
+// to AvsSocketGlobal::send_vectored(). The params show bytes copied by the
+// caller and the integration layer per message, and the size of staging
+// buffers needed just for that message (the caller's one, and temporary ones
+// allocated by send_vectored()), measured on a single send using
+// AvsSendVectoredStats.
+void bench_send_vectored() {
+    static const size_t BLOCK_SIZES[] = { 16, 64, 256, 1024 };
+    static const uint8_t HEADER[] = { 0x48, 0x02, 0x12, 0x34, 1, 2, 3, 4,
+                                      5,    6,    7,    8 };
+    static const uint8_t OPTIONS[] = { 0xB1, '5', 0x01, '0', 0x01, '0',
+                                       0xC1, 0x2A, 0xD1, 0x02, 0x16, 0xFF };
+    std::vector<uint8_t> payload(1024, 0xA5);
+
+    avs_net_socket_t *udp_receiver = bound_udp_socket();
+    avs_net_socket_t *udp_sender = bound_udp_socket();
+    check(avs_net_socket_connect(udp_sender, "127.0.0.1",
+                                 local_port(udp_receiver).c_str()),
+          "connect");
+
+    avs_net_socket_t *listener = tcp_socket();
+    check(avs_net_socket_bind(listener, "127.0.0.1", "0"), "bind");
+    avs_net_socket_t *tcp_sender = tcp_socket();
+    check(avs_net_socket_connect(tcp_sender, "127.0.0.1",
+                                 local_port(listener).c_str()),
+          "connect");
+    avs_net_socket_t *tcp_receiver = tcp_socket();
+    check(avs_net_socket_accept(listener, tcp_receiver), "accept");
+
+    for (size_t b = 0; b < sizeof(BLOCK_SIZES) / sizeof(*BLOCK_SIZES); ++b) {
+        const size_t block_size = BLOCK_SIZES[b];
+        const size_t total = sizeof(HEADER) + sizeof(OPTIONS) + block_size;
+        const AvsIoVec iov[] = { { HEADER, sizeof(HEADER) },
+                                 { OPTIONS, sizeof(OPTIONS) },
+                                 { &payload[0], block_size } };
+        std::vector<uint8_t> staging(total);
+        // bytes copied and staging buffer bytes used by the caller itself
+        size_t caller_copied = 0;
+        size_t caller_staging = 0;
+        auto send_staged = [&](avs_net_socket_t *socket) {
+            memcpy(&staging[0], HEADER, sizeof(HEADER));
+            memcpy(&staging[sizeof(HEADER)], OPTIONS, sizeof(OPTIONS));
+            memcpy(&staging[sizeof(HEADER) + sizeof(OPTIONS)], &payload[0],
+                   block_size);
+            caller_copied += total;
+            caller_staging += staging.size();
+            check(avs_net_socket_send(socket, &staging[0], total), "send");
+        };
+        auto send_vectored = [&](avs_net_socket_t *socket) {
+            check(AvsSocketGlobal::send_vectored(
+                          socket, iov, sizeof(iov) / sizeof(*iov)),
+                  "send_vectored");
+        };
+        auto measured_params = [&](const std::function<void()> &send) {
+            caller_copied = 0;
+            caller_staging = 0;
+            AvsSocketGlobal::reset_send_vectored_stats();
+            send();
+            AvsSendVectoredStats stats;
+            AvsSocketGlobal::get_send_vectored_stats(&stats);
+            return Params()
+                    .add("block_size", (long) block_size)
+                    .add("copied_bytes",
+                         (long) (caller_copied + stats.copied_bytes))
+                    .add("staging_bytes",
+                         (long) (caller_staging
+                                 + stats.temporary_buffer_bytes));
+        };
+
+        auto udp_staged = [&] {
+            send_staged(udp_sender);
+            receive_exact(udp_receiver, total);
+        };
+        run("send_vectored", "udp_staged", measured_params(udp_staged), 100,
+            udp_staged);
+        // gathered once into the router's buffer, shared by all sockets
+        // bound to the same port
+        auto udp_vectored = [&] {
+            send_vectored(udp_sender);
+            receive_exact(udp_receiver, total);
+        };
+        run("send_vectored", "udp_vectored", measured_params(udp_vectored),
+            100, udp_vectored);
+        auto tcp_staged = [&] {
+            send_staged(tcp_sender);
+            receive_exact(tcp_receiver, total);
+        };
+        run("send_vectored", "tcp_staged", measured_params(tcp_staged), 100,
+            tcp_staged);
+        auto tcp_vectored = [&] {
+            send_vectored(tcp_sender);
+            receive_exact(tcp_receiver, total);
+        };
+        run("send_vectored", "tcp_vectored", measured_params(tcp_vectored),
+            100, tcp_vectored);
+    }
+
+    avs_net_socket_cleanup(&tcp_receiver);
+    avs_net_socket_cleanup(&tcp_sender);
+    avs_net_socket_cleanup(&listener);
+    avs_net_socket_cleanup(&udp_sender);
+    avs_net_socket_cleanup(&udp_receiver);
+}
+
+// RAM taken by the routers' staging buffers (reported as the buffer_bytes
+// param) with each socket bound to its own port, i.e. using its own router,
+// for both per-router and shared buffers; the timed operation is one
+// send_vectored() and receive on each socket.
+void bench_footprint() {
+    static const int ROUTER_COUNTS[] = { 1, 2, 4, 8 };
+    static const int POOL_SIZES[] = { 0, 1, 2 };
+    static const AvsIoVec IOV[] = { { "x", 1 }, { "y", 1 } };
+    for (size_t p = 0; p < sizeof(POOL_SIZES) / sizeof(*POOL_SIZES); ++p) {
+        check(AvsSocketGlobal::set_shared_recv_buffers(POOL_SIZES[p]),
+              "set_shared_recv_buffers");
+        size_t single_router_bytes = 0;
+        for (size_t c = 0; c < sizeof(ROUTER_COUNTS) / sizeof(*ROUTER_COUNTS);
+             ++c) {
+            // each socket is connected to itself
+            std::vector<avs_net_socket_t *> sockets;
+            for (int i = 0; i < ROUTER_COUNTS[c]; ++i) {
+                sockets.push_back(bound_udp_socket());
+                check(avs_net_socket_connect(sockets.back(), "127.0.0.1",
+                                             local_port(sockets.back())
+                                                     .c_str()),
+                      "connect");
+            }
+            auto round = [&] {
+                for (size_t i = 0; i < sockets.size(); ++i) {
+                    check(AvsSocketGlobal::send_vectored(
+                                  sockets[i], IOV, sizeof(IOV) / sizeof(*IOV)),
+                          "send_vectored");
+                    receive_exact(sockets[i], 2);
+                }
+            };
+            // lets routers allocate their buffers before measuring
+            round();
+            AvsUdpRouterStats stats;
+            AvsSocketGlobal::get_udp_router_stats(&stats);
+            // per-router buffers grow with the number of routers, while the
+            // shared ones must not grow at all
+            if (!c) {
+                single_router_bytes = stats.buffer_bytes;
+            }
+            const size_t expected_bytes =
+                    POOL_SIZES[p] ? single_router_bytes
+                                  : single_router_bytes * ROUTER_COUNTS[c];
+            if (stats.buffer_bytes != expected_bytes) {
+                fprintf(stderr,
+                        "footprint: %lu buffer bytes with %d routers and %d "
+                        "shared buffers, expected %lu\n",
+                        (unsigned long) stats.buffer_bytes, ROUTER_COUNTS[c],
+                        POOL_SIZES[p], (unsigned long) expected_bytes);
+                exit(1);
+            }
+            run("footprint", "routers",
+                Params().add("routers", (long) stats.routers)
+                        .add("shared_buffers", POOL_SIZES[p])
+                        .add("buffer_bytes", (long) stats.buffer_bytes),
+                std::max(1, 100 / ROUTER_COUNTS[c]), round);
+            cleanup(sockets);
+        }
+    }
+    check(AvsSocketGlobal::set_shared_recv_buffers(0),
+          "set_shared_recv_buffers");
+}
+
+// A TCP request-response exchange driven by AvsSocketGlobal::poll(), as in
+// the Anjay event loop. The params show how many blocking mode and timeout
+// changes were requested by the integration layer during a number of
+// exchanges, how many of them were skipped because the mbed socket already
+// was in the requested mode, and how many reached the network stack. The
+// suite fails if nothing was skipped, or if the number of changes that
+// reached the network stack differs from the number of applied ones.
+void bench_socket_mode() {
+    static const int EXCHANGES = 1000;
+    avs_net_socket_t *listener = tcp_socket();
+    check(avs_net_socket_bind(listener, "127.0.0.1", "0"), "bind");
+    avs_net_socket_t *client = tcp_socket();
+    check(avs_net_socket_connect(client, "127.0.0.1",
+                                 local_port(listener).c_str()),
+          "connect");
+    avs_net_socket_t *server = tcp_socket();
+    check(avs_net_socket_accept(listener, server), "accept");
+
+    avs::List<avs_net_socket_t *> socket_list;
+    socket_list.push_back(server);
+    avs::ListView<avs_net_socket_t *const> view(socket_list);
+    avs::List<avs_net_socket_t *> ready;
+    auto exchange = [&] {
+        check(avs_net_socket_send(client, "x", 1), "send");
+        do {
+            AvsSocketGlobal::poll(ready, view, 1000);
+        } while (ready.empty());
+        receive_exact(server, 1);
+        check(avs_net_socket_send(server, "y", 1), "send");
+        receive_exact(client, 1);
+    };
+
+    exchange();
+    AvsSocketGlobal::reset_socket_mode_stats();
+    const unsigned long stack_calls = mbed_host_socket_mode_calls();
+    for (int i = 0; i < EXCHANGES; ++i) {
+        exchange();
+    }
+    AvsSocketModeStats stats;
+    AvsSocketGlobal::get_socket_mode_stats(&stats);
+    const unsigned long measured_stack_calls =
+            mbed_host_socket_mode_calls() - stack_calls;
+    // skipped changes must never reach the network stack
+    if (!stats.skipped || measured_stack_calls != stats.applied) {
+        fprintf(stderr,
+                "socket_mode: %lu changes applied and %lu skipped, but %lu "
+                "reached the network stack\n",
+                (unsigned long) stats.applied, (unsigned long) stats.skipped,
+                measured_stack_calls);
+        exit(1);
+    }
+    run("socket_mode", "tcp_exchange",
+        Params().add("exchanges", EXCHANGES)
+                .add("requested", (long) (stats.applied + stats.skipped))
+                .add("skipped", (long) stats.skipped)
+                .add("stack_calls", (long) measured_stack_calls),
+        100, exchange);
+
+    avs_net_socket_cleanup(&server);
+    avs_net_socket_cleanup(&client);
+    avs_net_socket_cleanup(&listener);
+}
+
+void bench_addrinfo() {
+    struct Case {
+        const char *name;
+        const char *host;
+    };
+    // there is no DNS cache in the integration layer itself; "localhost" is
+    // answered from /etc/hosts or the system resolver cache on the host
+    static const Case CASES[] = { { "literal_v4", "127.0.0.1" },
+                                  { "literal_v6", "::1" },
+                                  { "cached_host", "localhost" } };
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(*CASES); ++i) {
+        const char *host = CASES[i].host;
+        run("addrinfo", CASES[i].name, Params(), 100, [host] {
+            avs_net_addrinfo_t *info = avs_net_addrinfo_resolve_ex(
+                    AVS_NET_UDP_SOCKET, AVS_NET_AF_UNSPEC, host, "5683", 0,
+                    nullptr);
+            if (!info) {
+                fprintf(stderr, "cannot resolve %s\n", host);
+                exit(1);
+            }
+            avs_net_addrinfo_delete(&info);
+        });
+    }
+}
+
+void bench_time() {
+    volatile int64_t sink = 0;
+    run("time", "monotonic_now", Params(), 10000, [&] {
+        sink = sink + avs_time_monotonic_now().since_monotonic_epoch.seconds;
+    });
+}
+
+struct PingPong {
+    avs_mutex_t *mutex;
+    avs_condvar_t *condvar;
+    unsigned turn;
+    bool stop;
+};
+
+void pong_thread(PingPong *state) {
+    avs_mutex_lock(state->mutex);
+    while (!state->stop) {
+        if (state->turn % 2) {
+            ++state->turn;
+            avs_condvar_notify_all(state->condvar);
+        } else {
+            avs_condvar_wait(state->condvar, state->mutex,
+                             AVS_TIME_MONOTONIC_INVALID);
+        }
+    }
+    avs_mutex_unlock(state->mutex);
+}
+
+void bench_threading() {
+    avs_mutex_t *mutex = nullptr;
+    avs_condvar_t *condvar = nullptr;
+    if (avs_mutex_create(&mutex) || avs_condvar_create(&condvar)) {
+        fprintf(stderr, "cannot create mutex or condvar\n");
+        exit(1);
+    }
+
+    run("threading", "mutex_lock_unlock", Params(), 10000, [mutex] {
+        avs_mutex_lock(mutex);
+        avs_mutex_unlock(mutex);
+    });
+
+    PingPong state = { mutex, condvar, 0, false };
+    Thread thread;
+    thread.start(callback(pong_thread, &state));
+    run("threading", "condvar_round_trip", Params(), 100, [&state] {
+        avs_mutex_lock(state.mutex);
+        ++state.turn;
+        avs_condvar_notify_all(state.condvar);
+        while (state.turn % 2) {
+            avs_condvar_wait(state.condvar, state.mutex,
+                             AVS_TIME_MONOTONIC_INVALID);
+        }
+        avs_mutex_unlock(state.mutex);
+    });
+    avs_mutex_lock(mutex);
+    state.stop = true;
+    avs_condvar_notify_all(condvar);
+    avs_mutex_unlock(mutex);
+    thread.join();
+
+    avs_condvar_cleanup(&condvar);
+    avs_mutex_cleanup(&mutex);
+}
+
+#ifdef ANJAY_MBEDOS_WITH_FW_UPDATE_BLOCK_DEVICE
+void check_image(BlockDevice &device,
+                 const std::vector<uint8_t> &image,
+                 const char *variant) {
+    std::vector<uint8_t> contents(image.size());
+    if (device.read(contents.data(), 0, contents.size())
+        || contents != image) {
+        fprintf(stderr, "fw_update: %s wrote a corrupted image\n", variant);
+        exit(1);
+    }
+}
+
+// Download of a firmware image into a HeapBlockDevice with simulated flash
+// timing. Blocks "arrive" every NETWORK_US, i.e. the receiving thread sleeps
+// before handling each of them. "direct" erases and programs on the
+// receiving thread, as a naive stream_write() handler would, while
+// "double_buffered" uses AvsFwUpdateBlockDevice, which also computes the
+// SHA-256 digest of the image. Ideally, the latter takes only as long as the
+// network transfer itself. "resumed" is the same, except that the download
+// is interrupted in the middle of the image and continued with a new writer
+// from the state returned by get_resume_state(), as after a reboot. The image
+// is read back and verified after each variant, and so is the digest.
+void bench_fw_update() {
+    const size_t IMAGE_SIZE = 16 * 1024;
+    const size_t BLOCK_SIZE = 1024;
+    const size_t SECTOR_SIZE = 4096;
+    const uint32_t NETWORK_US = 2000;
+    HeapBlockDevice device(IMAGE_SIZE, 1, 256, SECTOR_SIZE);
+    device.init();
+    // 400 us per 1 KiB block, 1500 us per block when amortizing erases
+    device.set_delays(100, 6000);
+
+    std::vector<uint8_t> image(IMAGE_SIZE);
+    for (size_t i = 0; i < image.size(); ++i) {
+        image[i] = (uint8_t) rand();
+    }
+    Params params;
+    params.add("image_bytes", (long) IMAGE_SIZE)
+            .add("block_bytes", (long) BLOCK_SIZE)
+            .add("network_us", (long) NETWORK_US);
+
+    run("fw_update", "direct", params, 1, [&] {
+        for (size_t offset = 0; offset < image.size(); offset += BLOCK_SIZE) {
+            std::this_thread::sleep_for(std::chrono::microseconds(NETWORK_US));
+            if (offset % SECTOR_SIZE == 0) {
+                device.erase(offset, SECTOR_SIZE);
+            }
+            device.program(&image[offset], offset, BLOCK_SIZE);
+        }
+    });
+    check_image(device, image, "direct");
+
+    uint8_t digest[32];
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+    mbedtls_sha256(image.data(), image.size(), digest, 0);
+#else  // MBEDTLS_VERSION_NUMBER >= 0x03000000
+    mbedtls_sha256_ret(image.data(), image.size(), digest, 0);
+#endif // MBEDTLS_VERSION_NUMBER >= 0x03000000
+    auto check_digest = [&](AvsFwUpdateBlockDevice &writer,
+                            const char *variant) {
+        if (writer.image_size() != image.size() || !writer.image_digest()
+            || memcmp(writer.image_digest(), digest, sizeof(digest))) {
+            fprintf(stderr, "fw_update: %s produced unexpected image size or "
+                            "digest\n",
+                    variant);
+            exit(1);
+        }
+    };
+    auto write_blocks = [&](AvsFwUpdateBlockDevice &writer, size_t begin,
+                            size_t end) {
+        for (size_t offset = begin; offset < end; offset += BLOCK_SIZE) {
+            std::this_thread::sleep_for(std::chrono::microseconds(NETWORK_US));
+            writer.write(&image[offset], BLOCK_SIZE);
+        }
+    };
+
+    AvsFwUpdateBlockDevice writer(&device, 0, IMAGE_SIZE);
+    run("fw_update", "double_buffered", params, 1, [&] {
+        writer.open();
+        write_blocks(writer, 0, image.size());
+        writer.finish();
+    });
+    check_digest(writer, "double_buffered");
+    check_image(device, image, "double_buffered");
+
+    // interrupted one block past the middle, so that the last complete erase
+    // unit ends exactly there
+    const size_t INTERRUPTED_AT = IMAGE_SIZE / 2 + BLOCK_SIZE;
+    const size_t RESUME_POINT = INTERRUPTED_AT / SECTOR_SIZE * SECTOR_SIZE;
+    AvsFwUpdateResumeState state;
+    AvsFwUpdateBlockDevice resumed_writer(&device, 0, IMAGE_SIZE);
+    run("fw_update", "resumed", params, 1, [&] {
+        {
+            AvsFwUpdateBlockDevice interrupted_writer(&device, 0, IMAGE_SIZE);
+            interrupted_writer.open();
+            write_blocks(interrupted_writer, 0, INTERRUPTED_AT);
+            // erase units are programmed in the background
+            for (int i = 0; i < 1000
+                            && (interrupted_writer.get_resume_state(&state)
+                                || state.offset < RESUME_POINT);
+                 ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        if (state.offset != RESUME_POINT || resumed_writer.resume(&state)) {
+            fprintf(stderr, "fw_update: could not resume at %lu\n",
+                    (unsigned long) RESUME_POINT);
+            exit(1);
+        }
+        write_blocks(resumed_writer, state.offset, image.size());
+        resumed_writer.finish();
+    });
+    check_digest(resumed_writer, "resumed");
+    check_image(device, image, "resumed");
+}
+#endif // ANJAY_MBEDOS_WITH_FW_UPDATE_BLOCK_DEVICE
+
+struct Suite {
+    const char *name;
+    void (*func)();
+};
+
+const Suite SUITES[] = { { "poll", bench_poll },
+                         { "udp_router", bench_udp_router },
+                         { "containers", bench_containers },
+                         { "send_vectored", bench_send_vectored },
+                         { "footprint", bench_footprint },
+                         { "socket_mode", bench_socket_mode },
+                         { "addrinfo", bench_addrinfo },
+                         { "time", bench_time },
+                         { "threading", bench_threading },
+#ifdef ANJAY_MBEDOS_WITH_FW_UPDATE_BLOCK_DEVICE
+                         { "fw_update", bench_fw_update },
+#endif // ANJAY_MBEDOS_WITH_FW_UPDATE_BLOCK_DEVICE
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::string> selected;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--batches") && i + 1 < argc) {
+            BATCHES = std::max(1, atoi(argv[++i]));
+        } else {
+            selected.push_back(argv[i]);
+        }
+    }
+
+    avs_log_set_default_level(AVS_LOG_QUIET);
+    NetworkInterface &network = *NetworkInterface::get_default_instance();
+    AvsSocketGlobal avs(&network, 4, 1536, AVS_NET_AF_INET4);
+
+    printf("{\"version\": 1, \"results\": [");
+    for (size_t i = 0; i < sizeof(SUITES) / sizeof(*SUITES); ++i) {
+        if (selected.empty()
+            || std::find(selected.begin(), selected.end(), SUITES[i].name)
+                       != selected.end()) {
+            SUITES[i].func();
+        }
+    }
+    printf("\n]}\n");
+    return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MBED_HOST_BLOCKDEVICE_H
+#define MBED_HOST_BLOCKDEVICE_H
+
+// Stand-in for the Mbed OS BlockDevice interface, limited to the parts used by
+// the integration layer. See HeapBlockDevice.h for an implementation.
+
+#include <stdint.h>
+
+typedef uint64_t bd_addr_t;
+typedef uint64_t bd_size_t;
+
+enum bd_error {
+    BD_ERROR_OK = 0,
+    BD_ERROR_DEVICE_ERROR = -4001
+};
+
+namespace mbed {
+
+class BlockDevice {
+public:
+    virtual ~BlockDevice() {}
+
+    virtual int init() = 0;
+    virtual int deinit() = 0;
+    virtual int sync() {
+        return 0;
+    }
+    virtual int read(void *buffer, bd_addr_t addr, bd_size_t size) = 0;
+    virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size) = 0;
+    virtual int erase(bd_addr_t addr, bd_size_t size) {
+        (void) addr;
+        (void) size;
+        return 0;
+    }
+    virtual bd_size_t get_read_size() const = 0;
+    virtual bd_size_t get_program_size() const = 0;
+    virtual bd_size_t get_erase_size() const {
+        return get_program_size();
+    }
+    virtual bd_size_t get_erase_size(bd_addr_t addr) const {
+        (void) addr;
+        return get_erase_size();
+    }
+    virtual int get_erase_value() const {
+        return -1;
+    }
+    virtual bd_size_t size() const = 0;
+    virtual const char *get_type() const = 0;
+
+    bool is_valid_read(bd_addr_t addr, bd_size_t size) const {
+        return addr % get_read_size() == 0 && size % get_read_size() == 0
+               && addr + size <= this->size();
+    }
+    bool is_valid_program(bd_addr_t addr, bd_size_t size) const {
+        return addr % get_program_size() == 0
+               && size % get_program_size() == 0
+               && addr + size <= this->size();
+    }
+    bool is_valid_erase(bd_addr_t addr, bd_size_t size) const {
+        return addr % get_erase_size(addr) == 0
+               && (addr + size) % get_erase_size(addr + size - 1) == 0
+               && addr + size <= this->size();
+    }
+};
+
+} // namespace mbed
+
+using mbed::BlockDevice;
+
+#endif /* MBED_HOST_BLOCKDEVICE_H */
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MBED_HOST_CALLBACK_H
+#define MBED_HOST_CALLBACK_H
+
+#include <functional>
+
+namespace mbed {
+
+template <typename F>
+class Callback;
+
+template <typename R, typename... Args>
+class Callback<R(Args...)> {
+    std::function<R(Args...)> func_;
+
+public:
+    Callback() : func_() {}
+    Callback(R (*func)(Args...)) : func_(func) {}
+
+    template <typename T, typename U>
+    Callback(U *obj, R (T::*method)(Args...))
+            : func_([obj, method](Args... args) -> R {
+                  return (obj->*method)(args...);
+              }) {}
+
+    template <typename T, typename U>
+    Callback(R (*func)(T *, Args...), U *arg)
+            : func_([func, arg](Args... args) -> R {
+                  return func(arg, args...);
+              }) {}
+
+    R call(Args... args) const {
+        return func_(args...);
+    }
+
+    R operator()(Args... args) const {
+        return func_(args...);
+    }
+
+    explicit operator bool() const {
+        return static_cast<bool>(func_);
+    }
+};
+
+template <typename R, typename... Args>
+Callback<R(Args...)> callback(R (*func)(Args...)) {
+    return Callback<R(Args...)>(func);
+}
+
+template <typename R, typename... Args>
+Callback<R(Args...)> callback(const Callback<R(Args...)> &func) {
+    return func;
+}
+
+template <typename T, typename U, typename R, typename... Args>
+Callback<R(Args...)> callback(U *obj, R (T::*method)(Args...)) {
+    return Callback<R(Args...)>(obj, method);
+}
+
+template <typename T, typename U, typename R, typename... Args>
+Callback<R(Args...)> callback(R (*func)(T *, Args...), U *arg) {
+    return Callback<R(Args...)>(func, arg);
+}
+
+} // namespace mbed
+
+#endif /* MBED_HOST_CALLBACK_H */
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MBED_HOST_HEAPBLOCKDEVICE_H
+#define MBED_HOST_HEAPBLOCKDEVICE_H
+
+// Stand-in for the Mbed OS HeapBlockDevice. Unlike the original, it behaves
+// like NOR flash: erased bytes read as 0xFF, and programming a block that has
+// not been erased since it was last programmed fails, so that missing erases
+// are caught on the host. Flash timing can be simulated with set_delays().
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "BlockDevice.h"
+
+namespace mbed {
+
+class HeapBlockDevice : public BlockDevice {
+    bd_size_t size_;
+    bd_size_t read_size_;
+    bd_size_t program_size_;
+    bd_size_t erase_size_;
+    std::vector<uint8_t> data_;
+    // one entry per program block
+    std::vector<bool> programmed_;
+    uint32_t program_delay_us_;
+    uint32_t erase_delay_us_;
+
+public:
+    HeapBlockDevice(bd_size_t size, bd_size_t block = 512);
+    HeapBlockDevice(bd_size_t size,
+                    bd_size_t read,
+                    bd_size_t program,
+                    bd_size_t erase);
+    virtual ~HeapBlockDevice() {}
+
+    // Host only: makes each program() sleep for program_us per program block,
+    // and each erase() for erase_us per erase block
+    void set_delays(uint32_t program_us, uint32_t erase_us);
+
+    virtual int init();
+    virtual int deinit();
+    virtual int read(void *buffer, bd_addr_t addr, bd_size_t size);
+    virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size);
+    virtual int erase(bd_addr_t addr, bd_size_t size);
+    virtual bd_size_t get_read_size() const;
+    virtual bd_size_t get_program_size() const;
+    virtual bd_size_t get_erase_size() const;
+    virtual bd_size_t get_erase_size(bd_addr_t addr) const;
+    virtual int get_erase_value() const;
+    virtual bd_size_t size() const;
+    virtual const char *get_type() const;
+};
+
+} // namespace mbed
+
+using mbed::HeapBlockDevice;
+
+#endif /* MBED_HOST_HEAPBLOCKDEVICE_H */
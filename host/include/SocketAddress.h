@@ -0,0 +1,55 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MBED_HOST_SOCKET_ADDRESS_H
+#define MBED_HOST_SOCKET_ADDRESS_H
+
+#include <stdint.h>
+
+#include "nsapi_types.h"
+
+class SocketAddress {
+    nsapi_addr_t addr_;
+    uint16_t port_;
+    mutable char ip_address_[NSAPI_IP_SIZE];
+
+public:
+    SocketAddress();
+    SocketAddress(const nsapi_addr_t &addr, uint16_t port = 0);
+    SocketAddress(const char *addr, uint16_t port = 0);
+    SocketAddress(const void *bytes, nsapi_version_t version, uint16_t port = 0);
+    SocketAddress(const SocketAddress &addr);
+    SocketAddress &operator=(const SocketAddress &addr);
+
+    bool set_ip_address(const char *addr);
+    void set_ip_bytes(const void *bytes, nsapi_version_t version);
+    void set_addr(const nsapi_addr_t &addr);
+    void set_port(uint16_t port);
+
+    const char *get_ip_address() const;
+    const void *get_ip_bytes() const;
+    nsapi_version_t get_ip_version() const;
+    nsapi_addr_t get_addr() const;
+    uint16_t get_port() const;
+
+    operator bool() const;
+
+    // NOTE: just like in Mbed OS, this does NOT compare ports
+    friend bool operator==(const SocketAddress &a, const SocketAddress &b);
+    friend bool operator!=(const SocketAddress &a, const SocketAddress &b);
+};
+
+#endif /* MBED_HOST_SOCKET_ADDRESS_H */
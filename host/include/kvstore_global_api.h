@@ -0,0 +1,68 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef MBED_HOST_KVSTORE_GLOBAL_API_H
+#define MBED_HOST_KVSTORE_GLOBAL_API_H
+
+// File-backed stand-in for the Mbed OS KVStore global API. Each key is stored
+// as a separate file in the directory named by the
+// ANJAY_MBEDOS_HOST_KVSTORE_DIR environment variable ("kvstore" in the current
+// working directory by default), regardless of the partition name. Flags are
+// accepted, but not enforced.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mbed_error.h"
+
+#define KV_MAX_KEY_LENGTH 128
+
+#define KV_WRITE_ONCE_FLAG (1 << 0)
+#define KV_REQUIRE_CONFIDENTIALITY_FLAG (1 << 1)
+#define KV_RESERVED_FLAG (1 << 2)
+#define KV_REQUIRE_REPLAY_PROTECTION_FLAG (1 << 3)
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct info {
+    size_t size;
+    uint32_t flags;
+} kv_info_t;
+
+typedef struct _opaque_kv_key_iterator *kv_iterator_t;
+
+int kv_set(const char *full_name_key,
+           const void *buffer,
+           size_t size,
+           uint32_t create_flags);
+int kv_get(const char *full_name_key,
+           void *buffer,
+           size_t buffer_size,
+           size_t *actual_size);
+int kv_get_info(const char *full_name_key, kv_info_t *info);
+int kv_remove(const char *full_name_key);
+int kv_iterator_open(kv_iterator_t *it, const char *full_prefix);
+int kv_iterator_next(kv_iterator_t it, char *key, size_t key_size);
+int kv_iterator_close(kv_iterator_t it);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif // __cplusplus
+
+#endif /* MBED_HOST_KVSTORE_GLOBAL_API_H */
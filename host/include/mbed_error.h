@@ -0,0 +1,31 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MBED_ERROR_H
+#define MBED_ERROR_H
+
+#include "mbed_host_platform.h"
+
+// Only the error codes that the host stand-ins actually return
+enum {
+    MBED_SUCCESS = 0,
+    MBED_ERROR_INVALID_ARGUMENT = -1,
+    MBED_ERROR_INVALID_SIZE = -2,
+    MBED_ERROR_ITEM_NOT_FOUND = -3,
+    MBED_ERROR_FAILED_OPERATION = -4
+};
+
+#endif /* MBED_ERROR_H */
@@ -0,0 +1,222 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MBED_HOST_NETSOCKET_H
+#define MBED_HOST_NETSOCKET_H
+
+#include <stdint.h>
+
+#include "Callback.h"
+#include "SocketAddress.h"
+#include "nsapi_types.h"
+
+class NetworkInterface;
+
+class NetworkStack {
+    NetworkInterface *interface_;
+
+    NetworkStack(const NetworkStack &);
+    NetworkStack &operator=(const NetworkStack &);
+
+public:
+    explicit NetworkStack(NetworkInterface *interface)
+            : interface_(interface) {}
+
+    NetworkInterface *get_interface() const {
+        return interface_;
+    }
+};
+
+/**
+ * Host stand-in for Mbed OS network interfaces. Sockets opened on it are plain
+ * POSIX sockets; the interface only carries the IP address reported to the
+ * library and, optionally, a system interface name that sockets are bound to
+ * with SO_BINDTODEVICE.
+ */
+class NetworkInterface {
+    NetworkStack stack_;
+    nsapi_connection_status_t status_;
+    SocketAddress ip_address_;
+    char device_name_[16];
+
+    NetworkInterface(const NetworkInterface &);
+    NetworkInterface &operator=(const NetworkInterface &);
+
+public:
+    explicit NetworkInterface(const char *ip_address = "127.0.0.1",
+                              const char *device_name = nullptr);
+    virtual ~NetworkInterface() {}
+
+    static NetworkInterface *get_default_instance();
+
+    virtual nsapi_error_t connect();
+    virtual nsapi_error_t disconnect();
+    virtual nsapi_connection_status_t get_connection_status() const;
+    virtual nsapi_error_t get_ip_address(SocketAddress *address);
+    virtual const char *get_ip_address();
+    virtual const char *get_mac_address();
+
+    NetworkStack *get_stack() {
+        return &stack_;
+    }
+
+    const char *get_device_name() const {
+        return device_name_[0] ? device_name_ : nullptr;
+    }
+};
+
+NetworkStack *nsapi_create_stack(NetworkInterface *interface);
+NetworkStack *nsapi_create_stack(NetworkStack *stack);
+
+class Socket {
+public:
+    virtual ~Socket() {}
+
+    virtual nsapi_error_t close() = 0;
+    virtual nsapi_error_t connect(const SocketAddress &address) = 0;
+    virtual nsapi_size_or_error_t send(const void *data, nsapi_size_t size) = 0;
+    virtual nsapi_size_or_error_t recv(void *data, nsapi_size_t size) = 0;
+    virtual nsapi_size_or_error_t
+    sendto(const SocketAddress &address, const void *data, nsapi_size_t size) = 0;
+    virtual nsapi_size_or_error_t
+    recvfrom(SocketAddress *address, void *data, nsapi_size_t size) = 0;
+    virtual nsapi_error_t bind(const SocketAddress &address) = 0;
+    virtual void set_blocking(bool blocking) = 0;
+    virtual void set_timeout(int timeout) = 0;
+    virtual nsapi_error_t setsockopt(int level,
+                                     int optname,
+                                     const void *optval,
+                                     unsigned optlen) = 0;
+    virtual nsapi_error_t
+    getsockopt(int level, int optname, void *optval, unsigned *optlen) = 0;
+    virtual Socket *accept(nsapi_error_t *error = nullptr) = 0;
+    virtual nsapi_error_t listen(int backlog = 1) = 0;
+    virtual void sigio(mbed::Callback<void()> func) = 0;
+};
+
+class InternetSocket : public Socket {
+    InternetSocket(const InternetSocket &);
+    InternetSocket &operator=(const InternetSocket &);
+
+protected:
+    NetworkInterface *interface_;
+    int fd_;
+    int timeout_;
+    mbed::Callback<void()> sigio_;
+
+    InternetSocket();
+
+    nsapi_error_t open_fd(NetworkStack *stack, int type);
+    void adopt_fd(NetworkInterface *interface, int fd);
+    // waits until the socket is ready for the given poll() events, respecting
+    // the configured timeout; returns 0 or NSAPI_ERROR_WOULD_BLOCK
+    nsapi_error_t wait_for(short events);
+    void rearm_sigio(short events);
+
+public:
+    virtual ~InternetSocket();
+
+    nsapi_error_t open(NetworkStack *stack);
+
+    nsapi_error_t open(NetworkInterface *interface) {
+        return open(nsapi_create_stack(interface));
+    }
+
+    virtual nsapi_error_t close();
+    virtual nsapi_error_t bind(const SocketAddress &address);
+    virtual void set_blocking(bool blocking);
+    virtual void set_timeout(int timeout);
+    virtual nsapi_error_t
+    setsockopt(int level, int optname, const void *optval, unsigned optlen);
+    virtual nsapi_error_t
+    getsockopt(int level, int optname, void *optval, unsigned *optlen);
+    virtual void sigio(mbed::Callback<void()> func);
+
+    // host-only extension, there is no equivalent public API in Mbed OS
+    int32_t host_local_port() const;
+
+    // invoked by the host sigio dispatcher thread
+    void host_dispatch_sigio();
+
+protected:
+    virtual int socket_type() const = 0;
+};
+
+class UDPSocket : public InternetSocket {
+protected:
+    virtual int socket_type() const;
+
+public:
+    UDPSocket() {}
+    virtual ~UDPSocket() {}
+
+    virtual nsapi_error_t connect(const SocketAddress &address);
+    virtual nsapi_size_or_error_t send(const void *data, nsapi_size_t size);
+    virtual nsapi_size_or_error_t recv(void *data, nsapi_size_t size);
+    virtual nsapi_size_or_error_t
+    sendto(const SocketAddress &address, const void *data, nsapi_size_t size);
+    virtual nsapi_size_or_error_t
+    recvfrom(SocketAddress *address, void *data, nsapi_size_t size);
+    virtual Socket *accept(nsapi_error_t *error = nullptr);
+    virtual nsapi_error_t listen(int backlog = 1);
+};
+
+class TCPSocket : public InternetSocket {
+    bool connect_in_progress_;
+
+    nsapi_error_t finish_connect();
+
+protected:
+    virtual int socket_type() const;
+
+public:
+    TCPSocket() : connect_in_progress_(false) {}
+    virtual ~TCPSocket() {}
+
+    virtual nsapi_error_t connect(const SocketAddress &address);
+    virtual nsapi_size_or_error_t send(const void *data, nsapi_size_t size);
+    virtual nsapi_size_or_error_t recv(void *data, nsapi_size_t size);
+    virtual nsapi_size_or_error_t
+    sendto(const SocketAddress &address, const void *data, nsapi_size_t size);
+    virtual nsapi_size_or_error_t
+    recvfrom(SocketAddress *address, void *data, nsapi_size_t size);
+    virtual TCPSocket *accept(nsapi_error_t *error = nullptr);
+    virtual nsapi_error_t listen(int backlog = 1);
+};
+
+nsapi_size_or_error_t nsapi_dns_query_multiple(NetworkStack *stack,
+                                               const char *host,
+                                               SocketAddress *addr,
+                                               nsapi_size_t addr_count,
+                                               const char *interface_name,
+                                               nsapi_version_t version);
+
+nsapi_error_t nsapi_dns_query(NetworkStack *stack,
+                              const char *host,
+                              SocketAddress *addr,
+                              const char *interface_name,
+                              nsapi_version_t version);
+
+// host-only extension: number of UDP datagrams dropped by the system because
+// of full socket receive buffers (RcvbufErrors in /proc/net/snmp), or -1 if
+// not available; note that it covers all sockets in the network namespace
+long mbed_host_udp_rx_drops();
+
+// host-only extension: total number of set_blocking() and set_timeout() calls
+// on all sockets, which are expensive on some offloaded network stacks
+unsigned long mbed_host_socket_mode_calls();
+
+#endif /* MBED_HOST_NETSOCKET_H */
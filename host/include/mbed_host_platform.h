@@ -0,0 +1,118 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MBED_HOST_PLATFORM_H
+#define MBED_HOST_PLATFORM_H
+
+// Minimal POSIX-backed stand-in for the parts of Mbed OS platform API that are
+// used by anjay-mbedos. This is NOT a general purpose Mbed OS emulation layer;
+// only the functions that the library and its examples actually call are
+// provided, with semantics of the newest supported Mbed OS version.
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MBED_MAJOR_VERSION 6
+#define MBED_MINOR_VERSION 16
+#define MBED_PATCH_VERSION 0
+
+#ifndef MBED_CONF_PLATFORM_STDIO_BAUD_RATE
+#define MBED_CONF_PLATFORM_STDIO_BAUD_RATE 115200
+#endif // MBED_CONF_PLATFORM_STDIO_BAUD_RATE
+
+#ifdef NDEBUG
+#define MBED_ASSERT(expr) ((void) 0)
+#else // NDEBUG
+#define MBED_ASSERT(expr)                                              \
+    do {                                                               \
+        if (!(expr)) {                                                 \
+            mbed_assert_internal(#expr, __FILE__, __LINE__);           \
+        }                                                              \
+    } while (0)
+#endif // NDEBUG
+
+#ifdef __cplusplus
+#define MBED_STATIC_ASSERT(expr, msg) static_assert(expr, msg)
+#else // __cplusplus
+#define MBED_STATIC_ASSERT(expr, msg) _Static_assert(expr, msg)
+#endif // __cplusplus
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef void *osThreadId_t;
+typedef osThreadId_t osThreadId;
+
+typedef enum {
+    osOK = 0,
+    osError = -1,
+    osErrorTimeout = -2,
+    osErrorResource = -3,
+    osErrorParameter = -4,
+    osErrorNoMemory = -5
+} osStatus_t;
+typedef osStatus_t osStatus;
+
+typedef enum {
+    osPriorityIdle = 1,
+    osPriorityLow = 8,
+    osPriorityBelowNormal = 16,
+    osPriorityNormal = 24,
+    osPriorityAboveNormal = 32,
+    osPriorityHigh = 40,
+    osPriorityRealtime = 48
+} osPriority_t;
+typedef osPriority_t osPriority;
+
+#define osWaitForever 0xFFFFFFFFu
+
+#ifndef OS_STACK_SIZE
+#define OS_STACK_SIZE 4096
+#endif // OS_STACK_SIZE
+
+void mbed_assert_internal(const char *expr, const char *file, int line);
+
+void error(const char *format, ...);
+
+void core_util_critical_section_enter(void);
+void core_util_critical_section_exit(void);
+
+bool core_util_atomic_cas_u32(volatile uint32_t *ptr,
+                              uint32_t *expected_current_value,
+                              uint32_t desired_value);
+uint32_t core_util_atomic_incr_u32(volatile uint32_t *value_ptr,
+                                   uint32_t delta);
+uint32_t core_util_atomic_decr_u32(volatile uint32_t *value_ptr,
+                                   uint32_t delta);
+uint32_t core_util_atomic_load_u32(const volatile uint32_t *value_ptr);
+void core_util_atomic_store_u32(volatile uint32_t *value_ptr,
+                                uint32_t desired_value);
+uint32_t core_util_atomic_fetch_add_u32(volatile uint32_t *value_ptr,
+                                        uint32_t arg);
+
+void sleep_manager_lock_deep_sleep(void);
+void sleep_manager_unlock_deep_sleep(void);
+
+int mbedtls_platform_setup(void *ctx);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif // __cplusplus
+
+#endif /* MBED_HOST_PLATFORM_H */
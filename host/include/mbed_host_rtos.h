@@ -0,0 +1,169 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MBED_HOST_RTOS_H
+#define MBED_HOST_RTOS_H
+
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "Callback.h"
+#include "mbed_host_platform.h"
+
+namespace rtos {
+
+namespace Kernel {
+
+struct Clock {
+    typedef std::chrono::duration<uint32_t, std::milli> duration_u32;
+};
+
+uint64_t get_ms_count();
+
+} // namespace Kernel
+
+class Mutex {
+    std::recursive_timed_mutex mtx_;
+    // owner_ and count_ are protected by mtx_ itself
+    osThreadId_t owner_;
+    uint32_t count_;
+
+    Mutex(const Mutex &);
+    Mutex &operator=(const Mutex &);
+
+public:
+    Mutex();
+    explicit Mutex(const char *name);
+
+    void lock();
+    bool trylock();
+    bool trylock_for(Kernel::Clock::duration_u32 rel_time);
+    void unlock();
+    osThreadId_t get_owner();
+};
+
+class Semaphore {
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    int32_t count_;
+    int32_t max_count_;
+
+    Semaphore(const Semaphore &);
+    Semaphore &operator=(const Semaphore &);
+
+    bool acquire_until(const std::chrono::steady_clock::time_point *deadline);
+
+public:
+    explicit Semaphore(int32_t count = 0);
+    Semaphore(int32_t count, uint16_t max_count);
+
+    void acquire();
+    bool try_acquire();
+    bool try_acquire_for(Kernel::Clock::duration_u32 rel_time);
+    osStatus release();
+};
+
+class EventFlags {
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    uint32_t flags_;
+
+    EventFlags(const EventFlags &);
+    EventFlags &operator=(const EventFlags &);
+
+    uint32_t wait_for_any(uint32_t flags, uint32_t millisec, bool clear);
+
+public:
+    EventFlags();
+    explicit EventFlags(const char *name);
+
+    uint32_t set(uint32_t flags);
+    uint32_t clear(uint32_t flags = 0x7fffffff);
+    uint32_t get() const;
+    uint32_t wait_any(uint32_t flags = 0,
+                      uint32_t millisec = osWaitForever,
+                      bool clear = true);
+    uint32_t wait_any_for(uint32_t flags,
+                          Kernel::Clock::duration_u32 rel_time,
+                          bool clear = true);
+};
+
+class Thread {
+    // std::thread is hidden, because mbed.h does "using namespace std", and
+    // a global "thread" identifier is quite common in mbed applications
+    void *thread_;
+    osPriority_t priority_;
+    const char *name_;
+
+    Thread(const Thread &);
+    Thread &operator=(const Thread &);
+
+public:
+    explicit Thread(osPriority_t priority = osPriorityNormal,
+                    uint32_t stack_size = OS_STACK_SIZE,
+                    unsigned char *stack_mem = nullptr,
+                    const char *name = nullptr);
+    ~Thread();
+
+    osStatus start(mbed::Callback<void()> task);
+    osStatus join();
+    osStatus set_priority(osPriority_t priority);
+    osPriority_t get_priority() const;
+    const char *get_name() const;
+};
+
+namespace ThisThread {
+
+void sleep_for(uint32_t millisec);
+void sleep_for(Kernel::Clock::duration_u32 rel_time);
+void yield();
+osThreadId_t get_id();
+
+} // namespace ThisThread
+
+} // namespace rtos
+
+namespace mbed {
+
+template <typename Lockable>
+class ScopedLock {
+    Lockable &lockable_;
+
+    ScopedLock(const ScopedLock &);
+    ScopedLock &operator=(const ScopedLock &);
+
+public:
+    ScopedLock(Lockable &lockable) : lockable_(lockable) {
+        lockable_.lock();
+    }
+
+    ~ScopedLock() {
+        lockable_.unlock();
+    }
+};
+
+} // namespace mbed
+
+namespace rtos {
+
+typedef mbed::ScopedLock<Mutex> ScopedMutexLock;
+
+} // namespace rtos
+
+#endif /* MBED_HOST_RTOS_H */
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MBED_HOST_NSAPI_TYPES_H
+#define MBED_HOST_NSAPI_TYPES_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+enum nsapi_error {
+    NSAPI_ERROR_OK = 0,
+    NSAPI_ERROR_WOULD_BLOCK = -3001,
+    NSAPI_ERROR_UNSUPPORTED = -3002,
+    NSAPI_ERROR_PARAMETER = -3003,
+    NSAPI_ERROR_NO_CONNECTION = -3004,
+    NSAPI_ERROR_NO_SOCKET = -3005,
+    NSAPI_ERROR_NO_ADDRESS = -3006,
+    NSAPI_ERROR_NO_MEMORY = -3007,
+    NSAPI_ERROR_NO_SSID = -3008,
+    NSAPI_ERROR_DNS_FAILURE = -3009,
+    NSAPI_ERROR_DHCP_FAILURE = -3010,
+    NSAPI_ERROR_AUTH_FAILURE = -3011,
+    NSAPI_ERROR_DEVICE_ERROR = -3012,
+    NSAPI_ERROR_IN_PROGRESS = -3013,
+    NSAPI_ERROR_ALREADY = -3014,
+    NSAPI_ERROR_IS_CONNECTED = -3015,
+    NSAPI_ERROR_CONNECTION_LOST = -3016,
+    NSAPI_ERROR_CONNECTION_TIMEOUT = -3017,
+    NSAPI_ERROR_ADDRESS_IN_USE = -3018,
+    NSAPI_ERROR_TIMEOUT = -3019,
+    NSAPI_ERROR_BUSY = -3020
+};
+
+typedef signed int nsapi_error_t;
+typedef unsigned int nsapi_size_t;
+typedef signed int nsapi_size_or_error_t;
+typedef signed int nsapi_value_or_error_t;
+
+typedef enum nsapi_connection_status {
+    NSAPI_STATUS_LOCAL_UP = 0,
+    NSAPI_STATUS_GLOBAL_UP = 1,
+    NSAPI_STATUS_DISCONNECTED = 2,
+    NSAPI_STATUS_CONNECTING = 3,
+    NSAPI_STATUS_ERROR_UNSUPPORTED = NSAPI_ERROR_UNSUPPORTED
+} nsapi_connection_status_t;
+
+#define NSAPI_IPv4_SIZE 16
+#define NSAPI_IPv4_BYTES 4
+#define NSAPI_IPv6_SIZE 40
+#define NSAPI_IPv6_BYTES 16
+#define NSAPI_IP_SIZE NSAPI_IPv6_SIZE
+#define NSAPI_IP_BYTES NSAPI_IPv6_BYTES
+#define NSAPI_MAC_SIZE 18
+
+typedef enum nsapi_version {
+    NSAPI_UNSPEC,
+    NSAPI_IPv4,
+    NSAPI_IPv6
+} nsapi_version_t;
+
+typedef struct nsapi_addr {
+    nsapi_version_t version;
+    uint8_t bytes[NSAPI_IP_BYTES];
+} nsapi_addr_t;
+
+typedef void *nsapi_socket_t;
+
+typedef enum nsapi_protocol {
+    NSAPI_TCP,
+    NSAPI_UDP
+} nsapi_protocol_t;
+
+typedef enum nsapi_socket_level {
+    NSAPI_SOCKET = 7000
+} nsapi_socket_level_t;
+
+typedef enum nsapi_socket_option {
+    NSAPI_REUSEADDR,
+    NSAPI_KEEPALIVE,
+    NSAPI_KEEPIDLE,
+    NSAPI_KEEPINTVL,
+    NSAPI_LINGER,
+    NSAPI_SNDBUF,
+    NSAPI_RCVBUF
+} nsapi_socket_option_t;
+
+#ifdef __cplusplus
+} // extern "C"
+#endif // __cplusplus
+
+#endif /* MBED_HOST_NSAPI_TYPES_H */
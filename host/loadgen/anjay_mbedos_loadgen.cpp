@@ -0,0 +1,874 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Load generator for the UDP path of the integration layer, run on the host
+// build.
+//
+// An Anjay client instance is configured with N LwM2M Servers, all of which
+// are simulated by this program on the loopback interface. The client uses a
+// fixed local port, so all server connections share a single AvsUdpRouter.
+//
+// After the client registers, each simulated server:
+// - keeps a number of Read requests in flight,
+// - observes a resource with pmax=1, so notifications keep flowing (unless
+//   --observe 0 is given),
+// - optionally writes a firmware package to /5/0/0 using Block1 transfers
+//   (only effective if the Firmware Update object is available).
+//
+// Usage: anjay-mbedos-loadgen [--servers N] [--inflight K] [--duration S]
+//                             [--client-port PORT] [--fw-block-size BYTES]
+//                             [--observe 0|1] [--rx-thread 0|1]
+//
+// At the end, a JSON report with throughput, response latency percentiles,
+// router queue depths and drop counts, serve loop wakeups per minute and heap
+// high-water mark is printed to stdout. Running with "--inflight 0 --observe 0"
+// measures the wakeup rate of an idle client. "--rx-thread 1" receives the
+// client's datagrams using AvsUdpRxThread. If the library is built with
+// ANJAY_MBEDOS_WITH_MUTEX_PROFILE, the report also lists the statistics of all
+// profiled mutexes; the ones created by the Anjay client are named "anjay".
+
+#include <malloc.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mbed.h>
+
+#include <avsystem/commons/avs_log.h>
+
+#include <anjay/anjay.h>
+#include <anjay/security.h>
+#include <anjay/server.h>
+#ifdef ANJAY_WITH_MODULE_FW_UPDATE
+#include <anjay/fw_update.h>
+#endif // ANJAY_WITH_MODULE_FW_UPDATE
+
+#include "avs_mutex_profile.h"
+#include "avs_serve_loop.h"
+#include "avs_socket_global.h"
+#include "avs_udp_rx_thread.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    int servers;
+    int inflight;
+    int duration_s;
+    uint16_t client_port;
+    size_t fw_block_size;
+    bool observe;
+    bool rx_thread;
+};
+
+Options OPTIONS = { 4, 4, 10, 56830, 0, true, false };
+
+std::atomic<bool> STOP(false);
+
+//// CoAP ///////////////////////////////////////////////////////////////////
+
+enum {
+    COAP_CON = 0,
+    COAP_NON = 1,
+    COAP_ACK = 2,
+    COAP_RST = 3
+};
+
+#define COAP_CODE(Class, Detail) ((uint8_t) (((Class) << 5) | (Detail)))
+
+enum {
+    COAP_GET = COAP_CODE(0, 1),
+    COAP_POST = COAP_CODE(0, 2),
+    COAP_PUT = COAP_CODE(0, 3),
+    COAP_DELETE = COAP_CODE(0, 4),
+    COAP_CREATED = COAP_CODE(2, 1),
+    COAP_DELETED = COAP_CODE(2, 2),
+    COAP_CHANGED = COAP_CODE(2, 4),
+    COAP_CONTINUE = COAP_CODE(2, 31)
+};
+
+enum {
+    COAP_OPT_OBSERVE = 6,
+    COAP_OPT_LOCATION_PATH = 8,
+    COAP_OPT_URI_PATH = 11,
+    COAP_OPT_CONTENT_FORMAT = 12,
+    COAP_OPT_URI_QUERY = 15,
+    COAP_OPT_BLOCK1 = 27
+};
+
+struct CoapOption {
+    uint16_t number;
+    std::string value;
+};
+
+struct CoapMessage {
+    uint8_t type;
+    uint8_t code;
+    uint16_t msg_id;
+    std::string token;
+    std::vector<CoapOption> options;
+    std::string payload;
+
+    CoapMessage() : type(COAP_CON), code(0), msg_id(0) {}
+
+    void add_option(uint16_t number, const std::string &value) {
+        CoapOption option = { number, value };
+        options.push_back(option);
+    }
+
+    void add_uint_option(uint16_t number, uint32_t value) {
+        std::string encoded;
+        for (; value; value >>= 8) {
+            encoded.insert(encoded.begin(), (char) (value & 0xFF));
+        }
+        add_option(number, encoded);
+    }
+
+    void add_path(const std::string &path) {
+        size_t start = 0;
+        while (start < path.size()) {
+            size_t end = path.find('/', start);
+            if (end == std::string::npos) {
+                end = path.size();
+            }
+            if (end > start) {
+                add_option(COAP_OPT_URI_PATH, path.substr(start, end - start));
+            }
+            start = end + 1;
+        }
+    }
+
+    const CoapOption *find_option(uint16_t number) const {
+        for (size_t i = 0; i < options.size(); ++i) {
+            if (options[i].number == number) {
+                return &options[i];
+            }
+        }
+        return nullptr;
+    }
+
+    std::string uri_path() const {
+        std::string result;
+        for (size_t i = 0; i < options.size(); ++i) {
+            if (options[i].number == COAP_OPT_URI_PATH) {
+                result += "/" + options[i].value;
+            }
+        }
+        return result;
+    }
+};
+
+std::string serialize(CoapMessage msg) {
+    std::string out;
+    out.push_back((char) (0x40 | (msg.type << 4) | msg.token.size()));
+    out.push_back((char) msg.code);
+    out.push_back((char) (msg.msg_id >> 8));
+    out.push_back((char) (msg.msg_id & 0xFF));
+    out += msg.token;
+
+    std::stable_sort(msg.options.begin(), msg.options.end(),
+                     [](const CoapOption &a, const CoapOption &b) {
+                         return a.number < b.number;
+                     });
+    uint16_t last_number = 0;
+    for (size_t i = 0; i < msg.options.size(); ++i) {
+        uint32_t values[2] = { (uint32_t) (msg.options[i].number - last_number),
+                               (uint32_t) msg.options[i].value.size() };
+        uint8_t nibbles[2];
+        std::string extended;
+        for (int j = 0; j < 2; ++j) {
+            if (values[j] < 13) {
+                nibbles[j] = (uint8_t) values[j];
+            } else if (values[j] < 269) {
+                nibbles[j] = 13;
+                extended.push_back((char) (values[j] - 13));
+            } else {
+                nibbles[j] = 14;
+                extended.push_back((char) ((values[j] - 269) >> 8));
+                extended.push_back((char) ((values[j] - 269) & 0xFF));
+            }
+        }
+        out.push_back((char) ((nibbles[0] << 4) | nibbles[1]));
+        out += extended;
+        out += msg.options[i].value;
+        last_number = msg.options[i].number;
+    }
+    if (!msg.payload.empty()) {
+        out.push_back((char) 0xFF);
+        out += msg.payload;
+    }
+    return out;
+}
+
+bool read_extended(const uint8_t *&ptr,
+                   const uint8_t *end,
+                   uint32_t nibble,
+                   uint32_t *out) {
+    if (nibble < 13) {
+        *out = nibble;
+    } else if (nibble == 13 && ptr < end) {
+        *out = 13 + *ptr++;
+    } else if (nibble == 14 && ptr + 1 < end) {
+        *out = 269 + ((uint32_t) ptr[0] << 8) + ptr[1];
+        ptr += 2;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse(const uint8_t *data, size_t size, CoapMessage *out) {
+    if (size < 4 || (data[0] >> 6) != 1) {
+        return false;
+    }
+    const uint8_t *end = data + size;
+    size_t token_length = data[0] & 0x0F;
+    out->type = (data[0] >> 4) & 0x03;
+    out->code = data[1];
+    out->msg_id = (uint16_t) ((data[2] << 8) | data[3]);
+    if (token_length > 8 || 4 + token_length > size) {
+        return false;
+    }
+    out->token.assign((const char *) data + 4, token_length);
+    out->options.clear();
+    out->payload.clear();
+    const uint8_t *ptr = data + 4 + token_length;
+    uint32_t number = 0;
+    while (ptr < end) {
+        if (*ptr == 0xFF) {
+            out->payload.assign((const char *) ptr + 1, end - ptr - 1);
+            break;
+        }
+        uint8_t header = *ptr++;
+        uint32_t delta, length;
+        if (!read_extended(ptr, end, header >> 4, &delta)
+            || !read_extended(ptr, end, header & 0x0F, &length)
+            || ptr + length > end) {
+            return false;
+        }
+        number += delta;
+        CoapOption option = { (uint16_t) number,
+                              std::string((const char *) ptr, length) };
+        out->options.push_back(option);
+        ptr += length;
+    }
+    return true;
+}
+
+//// Statistics /////////////////////////////////////////////////////////////
+
+struct LatencyStats {
+    std::vector<double> samples_us;
+    unsigned long timeouts;
+    unsigned long errors;
+
+    LatencyStats() : timeouts(0), errors(0) {}
+
+    double percentile(double p) {
+        if (samples_us.empty()) {
+            return 0.0;
+        }
+        std::sort(samples_us.begin(), samples_us.end());
+        size_t index = (size_t) (p / 100.0 * (samples_us.size() - 1) + 0.5);
+        return samples_us[index];
+    }
+
+    void report(const char *name, double duration_s, bool last) {
+        printf("    \"%s\": {\"completed\": %lu, \"timeouts\": %lu, "
+               "\"errors\": %lu, \"throughput_per_s\": %.1f, \"latency_us\": "
+               "{\"p50\": %.0f, \"p90\": %.0f, \"p99\": %.0f, \"max\": "
+               "%.0f}}%s\n",
+               name, (unsigned long) samples_us.size(), timeouts, errors,
+               samples_us.size() / duration_s, percentile(50),
+               percentile(90), percentile(99), percentile(100),
+               last ? "" : ",");
+    }
+};
+
+size_t heap_in_use() {
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    return mallinfo2().uordblks;
+#else
+    return (size_t) mallinfo().uordblks;
+#endif
+}
+
+std::atomic<size_t> HEAP_HIGH_WATER(0);
+
+void heap_sampler() {
+    while (!STOP) {
+        size_t in_use = heap_in_use();
+        size_t prev = HEAP_HIGH_WATER;
+        while (in_use > prev
+               && !HEAP_HIGH_WATER.compare_exchange_weak(prev, in_use))
+            ;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+//// Simulated LwM2M Servers ////////////////////////////////////////////////
+
+struct PendingRequest {
+    enum Kind { READ, OBSERVE, WRITE_ATTRIBUTES, FW_BLOCK } kind;
+    uint16_t msg_id;
+    Clock::time_point sent;
+};
+
+class SimulatedServer {
+    int fd_;
+    uint16_t port_;
+    int ssid_;
+    sockaddr_in client_;
+    bool registered_;
+    uint16_t next_msg_id_;
+    uint32_t next_token_;
+    std::vector<PendingRequest> pending_;
+    std::string observe_token_;
+    uint32_t fw_block_;
+    bool fw_in_flight_;
+
+    void send(const CoapMessage &msg) {
+        std::string data = serialize(msg);
+        sendto(fd_, data.data(), data.size(), 0, (const sockaddr *) &client_,
+               sizeof(client_));
+    }
+
+    CoapMessage new_request(uint8_t code, const std::string &path) {
+        CoapMessage msg;
+        msg.type = COAP_CON;
+        msg.code = code;
+        msg.msg_id = next_msg_id_++;
+        uint32_t token = next_token_++;
+        msg.token.assign((const char *) &token, sizeof(token));
+        msg.add_path(path);
+        return msg;
+    }
+
+    void send_request(PendingRequest::Kind kind, const CoapMessage &msg) {
+        PendingRequest request = { kind, msg.msg_id, Clock::now() };
+        pending_.push_back(request);
+        send(msg);
+    }
+
+    std::string server_path(const char *rid = nullptr) const {
+        char path[32];
+        snprintf(path, sizeof(path), "/1/%d%s%s", ssid_, rid ? "/" : "",
+                 rid ? rid : "");
+        return path;
+    }
+
+    void send_read() {
+        send_request(PendingRequest::READ, new_request(COAP_GET, server_path()));
+    }
+
+    void start_observation() {
+        CoapMessage attrs = new_request(COAP_PUT, server_path("1"));
+        attrs.add_option(COAP_OPT_URI_QUERY, "pmax=1");
+        send_request(PendingRequest::WRITE_ATTRIBUTES, attrs);
+
+        CoapMessage observe = new_request(COAP_GET, server_path("1"));
+        observe.add_uint_option(COAP_OPT_OBSERVE, 0);
+        observe_token_ = observe.token;
+        send_request(PendingRequest::OBSERVE, observe);
+    }
+
+    void send_fw_block() {
+        CoapMessage msg = new_request(COAP_PUT, "/5/0/0");
+        msg.add_uint_option(COAP_OPT_CONTENT_FORMAT, 42); // octet-stream
+        // SZX is log2(size) - 4; the "more" flag is always set, so that the
+        // download never ends
+        uint32_t szx = 0;
+        while ((16u << szx) < OPTIONS.fw_block_size && szx < 6) {
+            ++szx;
+        }
+        msg.add_uint_option(COAP_OPT_BLOCK1, (fw_block_++ << 4) | 0x08 | szx);
+        msg.payload.assign(16u << szx, '\xA5');
+        fw_in_flight_ = true;
+        send_request(PendingRequest::FW_BLOCK, msg);
+    }
+
+    void handle_client_request(const CoapMessage &req) {
+        CoapMessage resp;
+        resp.type = COAP_ACK;
+        resp.msg_id = req.msg_id;
+        resp.token = req.token;
+        std::string path = req.uri_path();
+        if (req.code == COAP_POST && path == "/rd") {
+            char location[8];
+            snprintf(location, sizeof(location), "%d", ssid_);
+            resp.code = COAP_CREATED;
+            resp.add_option(COAP_OPT_LOCATION_PATH, "rd");
+            resp.add_option(COAP_OPT_LOCATION_PATH, location);
+            bool was_registered = registered_;
+            registered_ = true;
+            send(resp);
+            if (!was_registered && OPTIONS.observe) {
+                start_observation();
+            }
+            return;
+        } else if (req.code == COAP_DELETE) {
+            resp.code = COAP_DELETED;
+            registered_ = false;
+        } else {
+            // Update, Send etc.
+            resp.code = COAP_CHANGED;
+        }
+        if (req.type == COAP_CON) {
+            send(resp);
+        }
+    }
+
+public:
+    LatencyStats reads;
+    LatencyStats fw_blocks;
+    unsigned long notifications;
+
+    SimulatedServer(int ssid)
+            : fd_(socket(AF_INET, SOCK_DGRAM, 0)),
+              port_(0),
+              ssid_(ssid),
+              client_(),
+              registered_(false),
+              next_msg_id_((uint16_t) rand()),
+              next_token_((uint32_t) rand()),
+              pending_(),
+              observe_token_(),
+              fw_block_(0),
+              fw_in_flight_(false),
+              notifications(0) {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addr_len = sizeof(addr);
+        if (fd_ < 0 || bind(fd_, (const sockaddr *) &addr, sizeof(addr))
+            || getsockname(fd_, (sockaddr *) &addr, &addr_len)) {
+            perror("cannot create simulated server socket");
+            exit(1);
+        }
+        port_ = ntohs(addr.sin_port);
+    }
+
+    ~SimulatedServer() {
+        close(fd_);
+    }
+
+    int fd() const {
+        return fd_;
+    }
+
+    uint16_t port() const {
+        return port_;
+    }
+
+    bool registered() const {
+        return registered_;
+    }
+
+    void handle_incoming() {
+        uint8_t buf[2048];
+        socklen_t addr_len = sizeof(client_);
+        ssize_t size = recvfrom(fd_, buf, sizeof(buf), 0, (sockaddr *) &client_,
+                                &addr_len);
+        CoapMessage msg;
+        if (size <= 0 || !parse(buf, (size_t) size, &msg)) {
+            return;
+        }
+        if (msg.code >= COAP_GET && msg.code <= COAP_DELETE) {
+            handle_client_request(msg);
+            return;
+        }
+        if (msg.type == COAP_ACK || msg.type == COAP_RST) {
+            for (size_t i = 0; i < pending_.size(); ++i) {
+                if (pending_[i].msg_id != msg.msg_id) {
+                    continue;
+                }
+                double latency_us =
+                        std::chrono::duration<double, std::micro>(
+                                Clock::now() - pending_[i].sent)
+                                .count();
+                bool success = msg.type == COAP_ACK && (msg.code >> 5) == 2;
+                switch (pending_[i].kind) {
+                case PendingRequest::READ:
+                    reads.samples_us.push_back(latency_us);
+                    reads.errors += !success;
+                    break;
+                case PendingRequest::FW_BLOCK:
+                    fw_blocks.samples_us.push_back(latency_us);
+                    fw_blocks.errors += (msg.code != COAP_CONTINUE);
+                    fw_in_flight_ = false;
+                    break;
+                default:;
+                }
+                pending_.erase(pending_.begin() + i);
+                return;
+            }
+        }
+        if (!observe_token_.empty() && msg.token == observe_token_
+            && msg.find_option(COAP_OPT_OBSERVE)) {
+            ++notifications;
+            if (msg.type == COAP_CON) {
+                CoapMessage ack;
+                ack.type = COAP_ACK;
+                ack.msg_id = msg.msg_id;
+                send(ack);
+            }
+        }
+    }
+
+    void generate_load() {
+        if (!registered_) {
+            return;
+        }
+        Clock::time_point now = Clock::now();
+        for (size_t i = 0; i < pending_.size();) {
+            if (now - pending_[i].sent > std::chrono::seconds(2)) {
+                if (pending_[i].kind == PendingRequest::READ) {
+                    ++reads.timeouts;
+                } else if (pending_[i].kind == PendingRequest::FW_BLOCK) {
+                    ++fw_blocks.timeouts;
+                    fw_in_flight_ = false;
+                }
+                pending_.erase(pending_.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+        int reads_in_flight = 0;
+        for (size_t i = 0; i < pending_.size(); ++i) {
+            reads_in_flight += (pending_[i].kind == PendingRequest::READ);
+        }
+        for (; reads_in_flight < OPTIONS.inflight; ++reads_in_flight) {
+            send_read();
+        }
+        if (OPTIONS.fw_block_size && !fw_in_flight_) {
+            send_fw_block();
+        }
+    }
+};
+
+void servers_thread(std::vector<SimulatedServer *> *servers,
+                    Clock::time_point *load_start) {
+    std::vector<pollfd> fds(servers->size());
+    for (size_t i = 0; i < servers->size(); ++i) {
+        fds[i].fd = (*servers)[i]->fd();
+        fds[i].events = POLLIN;
+    }
+    bool all_registered = false;
+    while (!STOP) {
+        if (::poll(fds.data(), fds.size(), 10) > 0) {
+            for (size_t i = 0; i < fds.size(); ++i) {
+                if (fds[i].revents & POLLIN) {
+                    (*servers)[i]->handle_incoming();
+                }
+            }
+        }
+        if (!all_registered) {
+            all_registered = true;
+            for (size_t i = 0; i < servers->size(); ++i) {
+                all_registered = all_registered && (*servers)[i]->registered();
+            }
+            if (!all_registered) {
+                continue;
+            }
+            *load_start = Clock::now();
+        }
+        for (size_t i = 0; i < servers->size(); ++i) {
+            (*servers)[i]->generate_load();
+        }
+    }
+}
+
+//// Client /////////////////////////////////////////////////////////////////
+
+#ifdef ANJAY_WITH_MODULE_FW_UPDATE
+int fw_stream_open(void *, const char *, const struct anjay_etag *) {
+    return 0;
+}
+
+int fw_stream_write(void *, const void *, size_t) {
+    return 0;
+}
+
+int fw_stream_finish(void *) {
+    return 0;
+}
+
+void fw_reset(void *) {}
+
+int fw_perform_upgrade(void *) {
+    return -1;
+}
+#endif // ANJAY_WITH_MODULE_FW_UPDATE
+
+anjay_t *create_client(const std::vector<SimulatedServer *> &servers) {
+    anjay_configuration_t config;
+    memset(&config, 0, sizeof(config));
+    config.endpoint_name = "urn:dev:os:anjay-mbedos-loadgen";
+    config.in_buffer_size = 4096;
+    config.out_buffer_size = 4096;
+    config.udp_listen_port = OPTIONS.client_port;
+    anjay_t *anjay;
+    {
+        AvsMutexProfile::Scope mutex_scope("anjay");
+        anjay = anjay_new(&config);
+    }
+    if (!anjay || anjay_security_object_install(anjay)
+        || anjay_server_object_install(anjay)) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < servers.size(); ++i) {
+        char uri[64];
+        snprintf(uri, sizeof(uri), "coap://127.0.0.1:%u",
+                 (unsigned) servers[i]->port());
+
+        anjay_security_instance_t security;
+        memset(&security, 0, sizeof(security));
+        security.ssid = (anjay_ssid_t) (i + 1);
+        security.server_uri = uri;
+        security.security_mode = ANJAY_SECURITY_NOSEC;
+        anjay_iid_t security_iid = (anjay_iid_t) (i + 1);
+
+        anjay_server_instance_t server;
+        memset(&server, 0, sizeof(server));
+        server.ssid = (anjay_ssid_t) (i + 1);
+        server.lifetime = 86400;
+        server.default_min_period = -1;
+        server.default_max_period = -1;
+        server.disable_timeout = -1;
+        server.binding = "U";
+        anjay_iid_t server_iid = (anjay_iid_t) (i + 1);
+
+        if (anjay_security_object_add_instance(anjay, &security, &security_iid)
+            || anjay_server_object_add_instance(anjay, &server, &server_iid)) {
+            anjay_delete(anjay);
+            return nullptr;
+        }
+    }
+#ifdef ANJAY_WITH_MODULE_FW_UPDATE
+    static anjay_fw_update_handlers_t handlers;
+    memset(&handlers, 0, sizeof(handlers));
+    handlers.stream_open = fw_stream_open;
+    handlers.stream_write = fw_stream_write;
+    handlers.stream_finish = fw_stream_finish;
+    handlers.reset = fw_reset;
+    handlers.perform_upgrade = fw_perform_upgrade;
+    if (anjay_fw_update_install(anjay, &handlers, nullptr, nullptr)) {
+        anjay_delete(anjay);
+        return nullptr;
+    }
+#endif // ANJAY_WITH_MODULE_FW_UPDATE
+    return anjay;
+}
+
+#ifdef ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+void report_mutex(const AvsMutexStats *stats, void *first_) {
+    bool *first = (bool *) first_;
+    char address[24];
+    snprintf(address, sizeof(address), "%p", stats->mutex);
+    printf("%s\n    {\"name\": \"%s\", \"acquisitions\": %lu, "
+           "\"contended\": %lu, \"total_wait_us\": %llu, "
+           "\"max_wait_us\": %lu, \"max_hold_us\": %lu}",
+           *first ? "" : ",", stats->name ? stats->name : address,
+           (unsigned long) stats->acquisitions,
+           (unsigned long) stats->contended,
+           (unsigned long long) stats->total_wait_us,
+           (unsigned long) stats->max_wait_us,
+           (unsigned long) stats->max_hold_us);
+    *first = false;
+}
+#endif // ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+
+void parse_options(int argc, char **argv) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        long value = atol(argv[i + 1]);
+        if (!strcmp(argv[i], "--servers")) {
+            OPTIONS.servers = (int) value;
+        } else if (!strcmp(argv[i], "--inflight")) {
+            OPTIONS.inflight = (int) value;
+        } else if (!strcmp(argv[i], "--duration")) {
+            OPTIONS.duration_s = (int) value;
+        } else if (!strcmp(argv[i], "--client-port")) {
+            OPTIONS.client_port = (uint16_t) value;
+        } else if (!strcmp(argv[i], "--fw-block-size")) {
+            OPTIONS.fw_block_size = (size_t) value;
+        } else if (!strcmp(argv[i], "--observe")) {
+            OPTIONS.observe = (value != 0);
+        } else if (!strcmp(argv[i], "--rx-thread")) {
+            OPTIONS.rx_thread = (value != 0);
+        } else {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            exit(1);
+        }
+    }
+    if (OPTIONS.servers < 1 || OPTIONS.inflight < 0
+        || OPTIONS.duration_s < 1) {
+        fprintf(stderr, "invalid options\n");
+        exit(1);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    parse_options(argc, argv);
+    avs_log_set_default_level(AVS_LOG_QUIET);
+
+    NetworkInterface &network = *NetworkInterface::get_default_instance();
+    AvsSocketGlobal avs(&network, 4, 4096, AVS_NET_AF_INET4);
+    std::unique_ptr<AvsUdpRxThread> rx_thread;
+    if (OPTIONS.rx_thread) {
+        rx_thread.reset(new AvsUdpRxThread());
+    }
+
+    std::vector<SimulatedServer *> servers;
+    for (int i = 0; i < OPTIONS.servers; ++i) {
+        servers.push_back(new SimulatedServer(i + 1));
+    }
+    anjay_t *anjay = create_client(servers);
+    if (!anjay) {
+        fprintf(stderr, "cannot create Anjay client\n");
+        return 1;
+    }
+
+    Clock::time_point load_start = Clock::time_point();
+    std::thread heap_thread(heap_sampler);
+    std::thread peer_thread(servers_thread, &servers, &load_start);
+
+    // the same loop as in the example, but with queue depth sampling
+    AvsSocketGlobal::reset_udp_router_stats();
+#ifdef ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+    AvsMutexProfile::reset();
+#endif // ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+    AvsUdpRouterStats initial_stats;
+    AvsSocketGlobal::get_udp_router_stats(&initial_stats);
+    unsigned long samples = 0;
+    double queued_sum = 0.0;
+    size_t queued_max = 0;
+    Clock::time_point loop_start = Clock::now();
+    Clock::time_point deadline =
+            loop_start + std::chrono::seconds(OPTIONS.duration_s);
+    AvsServeLoop loop(anjay);
+    Clock::time_point now;
+    while ((now = Clock::now()) < deadline) {
+        loop.run_once((int) std::chrono::duration_cast<
+                              std::chrono::milliseconds>(deadline - now)
+                              .count());
+
+        AvsUdpRouterStats stats;
+        AvsSocketGlobal::get_udp_router_stats(&stats);
+        ++samples;
+        queued_sum += stats.queued_messages;
+        queued_max = std::max(queued_max, stats.queued_messages);
+    }
+    double loop_duration_min =
+            std::chrono::duration<double>(Clock::now() - loop_start).count()
+            / 60.0;
+    AvsServeLoopStats loop_stats;
+    loop.get_stats(&loop_stats);
+    STOP = true;
+    peer_thread.join();
+    heap_thread.join();
+
+    AvsUdpRouterStats stats;
+    AvsSocketGlobal::get_udp_router_stats(&stats);
+    double load_duration_s =
+            load_start == Clock::time_point()
+                    ? 0.0
+                    : std::chrono::duration<double>(Clock::now() - load_start)
+                              .count();
+    unsigned long notifications = 0;
+    LatencyStats reads;
+    LatencyStats fw_blocks;
+    for (size_t i = 0; i < servers.size(); ++i) {
+        notifications += servers[i]->notifications;
+        reads.samples_us.insert(reads.samples_us.end(),
+                                servers[i]->reads.samples_us.begin(),
+                                servers[i]->reads.samples_us.end());
+        reads.timeouts += servers[i]->reads.timeouts;
+        reads.errors += servers[i]->reads.errors;
+        fw_blocks.samples_us.insert(fw_blocks.samples_us.end(),
+                                    servers[i]->fw_blocks.samples_us.begin(),
+                                    servers[i]->fw_blocks.samples_us.end());
+        fw_blocks.timeouts += servers[i]->fw_blocks.timeouts;
+        fw_blocks.errors += servers[i]->fw_blocks.errors;
+    }
+
+    printf("{\n  \"servers\": %d,\n  \"inflight\": %d,\n"
+           "  \"load_duration_s\": %.3f,\n",
+           OPTIONS.servers, OPTIONS.inflight, load_duration_s);
+    if (load_duration_s > 0.0) {
+        printf("  \"requests\": {\n");
+        reads.report("read", load_duration_s, !OPTIONS.fw_block_size);
+        if (OPTIONS.fw_block_size) {
+            fw_blocks.report("fw_block", load_duration_s, true);
+        }
+        printf("  },\n");
+    } else {
+        fprintf(stderr, "not all servers registered, no load generated\n");
+    }
+    printf("  \"notifications\": %lu,\n"
+           "  \"udp_router\": {\"routers\": %lu, \"sockets\": %lu, "
+           "\"queued_mean\": %.2f, \"queued_max\": %lu, "
+           "\"queue_high_water\": %lu, \"rx_thread\": %s, "
+           "\"rx_handoff_drops\": %lu, \"stack_rx_drops\": %ld, "
+           "\"buffer_bytes\": %lu},\n"
+           "  \"serve_loop\": {\"wakeups\": %lu, \"socket_wakeups\": %lu, "
+           "\"wakeups_per_minute\": %.1f},\n"
+           "  \"heap_high_water_bytes\": %lu",
+           notifications, (unsigned long) stats.routers,
+           (unsigned long) stats.sockets, samples ? queued_sum / samples : 0.0,
+           (unsigned long) queued_max, (unsigned long) stats.queue_high_water,
+           OPTIONS.rx_thread ? "true" : "false",
+           (unsigned long) stats.rx_handoff_drops,
+           stats.stack_rx_drops < 0
+                   ? -1L
+                   : stats.stack_rx_drops - initial_stats.stack_rx_drops,
+           (unsigned long) stats.buffer_bytes,
+           (unsigned long) loop_stats.wakeups,
+           (unsigned long) loop_stats.socket_wakeups,
+           loop_stats.wakeups / loop_duration_min,
+           (unsigned long) HEAP_HIGH_WATER.load());
+#ifdef ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+    printf(",\n  \"mutexes\": [");
+    bool first = true;
+    size_t unprofiled = AvsMutexProfile::dump(report_mutex, &first);
+    printf("\n  ],\n  \"unprofiled_mutexes\": %lu",
+           (unsigned long) unprofiled);
+#endif // ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+    printf("\n}\n");
+
+    anjay_delete(anjay);
+    for (size_t i = 0; i < servers.size(); ++i) {
+        delete servers[i];
+    }
+    return load_duration_s > 0.0 ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+
+#include "HeapBlockDevice.h"
+
+namespace mbed {
+
+namespace {
+
+void sleep_us(uint64_t us) {
+    if (us) {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+}
+
+} // namespace
+
+HeapBlockDevice::HeapBlockDevice(bd_size_t size, bd_size_t block)
+        : HeapBlockDevice(size, block, block, block) {}
+
+HeapBlockDevice::HeapBlockDevice(bd_size_t size,
+                                 bd_size_t read,
+                                 bd_size_t program,
+                                 bd_size_t erase)
+        : size_(size),
+          read_size_(read),
+          program_size_(program),
+          erase_size_(erase),
+          data_(),
+          programmed_(),
+          program_delay_us_(0),
+          erase_delay_us_(0) {}
+
+void HeapBlockDevice::set_delays(uint32_t program_us, uint32_t erase_us) {
+    program_delay_us_ = program_us;
+    erase_delay_us_ = erase_us;
+}
+
+int HeapBlockDevice::init() {
+    if (data_.empty()) {
+        data_.assign(size_, 0xFF);
+        programmed_.assign(size_ / program_size_, false);
+    }
+    return BD_ERROR_OK;
+}
+
+int HeapBlockDevice::deinit() {
+    return BD_ERROR_OK;
+}
+
+int HeapBlockDevice::read(void *buffer, bd_addr_t addr, bd_size_t size) {
+    if (data_.empty() || !is_valid_read(addr, size)) {
+        return BD_ERROR_DEVICE_ERROR;
+    }
+    memcpy(buffer, &data_[addr], size);
+    return BD_ERROR_OK;
+}
+
+int HeapBlockDevice::program(const void *buffer,
+                             bd_addr_t addr,
+                             bd_size_t size) {
+    if (data_.empty() || !is_valid_program(addr, size)) {
+        return BD_ERROR_DEVICE_ERROR;
+    }
+    for (bd_addr_t block = addr / program_size_;
+         block < (addr + size) / program_size_; ++block) {
+        if (programmed_[block]) {
+            return BD_ERROR_DEVICE_ERROR;
+        }
+        programmed_[block] = true;
+    }
+    memcpy(&data_[addr], buffer, size);
+    sleep_us(program_delay_us_ * (size / program_size_));
+    return BD_ERROR_OK;
+}
+
+int HeapBlockDevice::erase(bd_addr_t addr, bd_size_t size) {
+    if (data_.empty() || !is_valid_erase(addr, size)) {
+        return BD_ERROR_DEVICE_ERROR;
+    }
+    memset(&data_[addr], 0xFF, size);
+    for (bd_addr_t block = addr / program_size_;
+         block < (addr + size) / program_size_; ++block) {
+        programmed_[block] = false;
+    }
+    sleep_us(erase_delay_us_ * (size / erase_size_));
+    return BD_ERROR_OK;
+}
+
+bd_size_t HeapBlockDevice::get_read_size() const {
+    return read_size_;
+}
+
+bd_size_t HeapBlockDevice::get_program_size() const {
+    return program_size_;
+}
+
+bd_size_t HeapBlockDevice::get_erase_size() const {
+    return erase_size_;
+}
+
+bd_size_t HeapBlockDevice::get_erase_size(bd_addr_t) const {
+    return erase_size_;
+}
+
+int HeapBlockDevice::get_erase_value() const {
+    return 0xFF;
+}
+
+bd_size_t HeapBlockDevice::size() const {
+    return size_;
+}
+
+const char *HeapBlockDevice::get_type() const {
+    return "HEAP";
+}
+
+} // namespace mbed
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+
+#include "kvstore_global_api.h"
+
+struct _opaque_kv_key_iterator {
+    DIR *dir;
+    std::string prefix;
+};
+
+namespace {
+
+std::string storage_dir() {
+    const char *dir = getenv("ANJAY_MBEDOS_HOST_KVSTORE_DIR");
+    return dir && *dir ? dir : "kvstore";
+}
+
+// "/partition/key" -> "key"
+bool key_name(std::string &out, const char *full_name_key) {
+    if (!full_name_key || full_name_key[0] != '/') {
+        return false;
+    }
+    const char *name = strchr(full_name_key + 1, '/');
+    if (!name) {
+        return false;
+    }
+    out = name + 1;
+    return out.size() < KV_MAX_KEY_LENGTH
+           && out.find_first_of("/\\*?:;\"|<> ") == std::string::npos;
+}
+
+bool key_path(std::string &out, const char *full_name_key) {
+    std::string name;
+    if (!key_name(name, full_name_key)) {
+        return false;
+    }
+    out = storage_dir() + "/" + name;
+    return true;
+}
+
+} // namespace
+
+extern "C" {
+
+int kv_set(const char *full_name_key,
+           const void *buffer,
+           size_t size,
+           uint32_t create_flags) {
+    (void) create_flags;
+    std::string path;
+    if (!key_path(path, full_name_key) || (size && !buffer)) {
+        return MBED_ERROR_INVALID_ARGUMENT;
+    }
+    mkdir(storage_dir().c_str(), 0755);
+    // write to a temporary file first, so that the update is atomic like in
+    // the real KVStore implementations
+    std::string tmp_path = path + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "wb");
+    if (!f) {
+        return MBED_ERROR_FAILED_OPERATION;
+    }
+    bool ok = fwrite(buffer, 1, size, f) == size;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str())) {
+        remove(tmp_path.c_str());
+        return MBED_ERROR_FAILED_OPERATION;
+    }
+    return MBED_SUCCESS;
+}
+
+int kv_get(const char *full_name_key,
+           void *buffer,
+           size_t buffer_size,
+           size_t *actual_size) {
+    std::string path;
+    if (!key_path(path, full_name_key) || (buffer_size && !buffer)) {
+        return MBED_ERROR_INVALID_ARGUMENT;
+    }
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return MBED_ERROR_ITEM_NOT_FOUND;
+    }
+    size_t read = fread(buffer, 1, buffer_size, f);
+    bool failed = ferror(f);
+    fclose(f);
+    if (failed) {
+        return MBED_ERROR_FAILED_OPERATION;
+    }
+    if (actual_size) {
+        *actual_size = read;
+    }
+    return MBED_SUCCESS;
+}
+
+int kv_get_info(const char *full_name_key, kv_info_t *info) {
+    std::string path;
+    if (!key_path(path, full_name_key) || !info) {
+        return MBED_ERROR_INVALID_ARGUMENT;
+    }
+    struct stat st;
+    if (stat(path.c_str(), &st) || !S_ISREG(st.st_mode)) {
+        return MBED_ERROR_ITEM_NOT_FOUND;
+    }
+    info->size = (size_t) st.st_size;
+    info->flags = 0;
+    return MBED_SUCCESS;
+}
+
+int kv_remove(const char *full_name_key) {
+    std::string path;
+    if (!key_path(path, full_name_key)) {
+        return MBED_ERROR_INVALID_ARGUMENT;
+    }
+    return remove(path.c_str()) ? MBED_ERROR_ITEM_NOT_FOUND : MBED_SUCCESS;
+}
+
+int kv_iterator_open(kv_iterator_t *it, const char *full_prefix) {
+    std::string prefix;
+    if (!it) {
+        return MBED_ERROR_INVALID_ARGUMENT;
+    }
+    if (full_prefix && !key_name(prefix, full_prefix)) {
+        return MBED_ERROR_INVALID_ARGUMENT;
+    }
+    *it = new _opaque_kv_key_iterator();
+    (*it)->dir = opendir(storage_dir().c_str());
+    (*it)->prefix = prefix;
+    return MBED_SUCCESS;
+}
+
+int kv_iterator_next(kv_iterator_t it, char *key, size_t key_size) {
+    if (!it || !key) {
+        return MBED_ERROR_INVALID_ARGUMENT;
+    }
+    while (it->dir) {
+        struct dirent *entry = readdir(it->dir);
+        if (!entry) {
+            break;
+        }
+        std::string name = entry->d_name;
+        if (name.compare(0, it->prefix.size(), it->prefix) != 0
+            || name[0] == '.'
+            || (name.size() > 4
+                && name.compare(name.size() - 4, 4, ".tmp") == 0)) {
+            continue;
+        }
+        if (name.size() >= key_size) {
+            return MBED_ERROR_INVALID_SIZE;
+        }
+        memcpy(key, name.c_str(), name.size() + 1);
+        return MBED_SUCCESS;
+    }
+    return MBED_ERROR_ITEM_NOT_FOUND;
+}
+
+int kv_iterator_close(kv_iterator_t it) {
+    if (!it) {
+        return MBED_ERROR_INVALID_ARGUMENT;
+    }
+    if (it->dir) {
+        closedir(it->dir);
+    }
+    delete it;
+    return MBED_SUCCESS;
+}
+
+} // extern "C"
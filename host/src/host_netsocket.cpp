@@ -0,0 +1,912 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mbed_host_netsocket.h"
+#include "mbed_host_platform.h"
+
+using namespace std;
+
+namespace {
+
+// see mbed_host_socket_mode_calls()
+atomic<unsigned long> MODE_CALLS(0);
+
+// POSIX sockets have no equivalent of Mbed's sigio() callbacks, so a
+// dispatcher thread poll()s all open sockets and invokes the callbacks.
+//
+// Mbed OS network stacks signal sigio once per event rather than as long as
+// the socket stays readable, so to avoid spinning, each socket is disarmed
+// after its callback is called, and rearmed when the owner performs an
+// operation that may consume the pending event.
+//
+// Callbacks are invoked with dispatch_mtx_ held. remove() and
+// replace_callback() take it as well, so once close() returns, or a callback
+// is replaced, the old callback is neither running nor will it be called
+// again. It is recursive so that callbacks may operate on sockets themselves.
+class SigioDispatcher {
+    struct Entry {
+        int fd;
+        short events;
+        InternetSocket *socket;
+    };
+
+    // lock order: dispatch_mtx_, then mtx_
+    recursive_mutex dispatch_mtx_;
+    mutex mtx_;
+    vector<Entry> entries_;
+    int wakeup_pipe_[2];
+    bool started_;
+
+    SigioDispatcher()
+            : dispatch_mtx_(), mtx_(), entries_(), started_(false) {
+        if (pipe(wakeup_pipe_)) {
+            error("cannot create sigio wakeup pipe\n");
+        }
+        fcntl(wakeup_pipe_[0], F_SETFL, O_NONBLOCK);
+        fcntl(wakeup_pipe_[1], F_SETFL, O_NONBLOCK);
+    }
+
+    void wake_up() {
+        char byte = 0;
+        (void) !write(wakeup_pipe_[1], &byte, 1);
+    }
+
+    void run() {
+        vector<struct pollfd> fds;
+        vector<InternetSocket *> sockets;
+        while (true) {
+            fds.clear();
+            sockets.clear();
+            struct pollfd wakeup_fd = { wakeup_pipe_[0], POLLIN, 0 };
+            fds.push_back(wakeup_fd);
+            sockets.push_back(nullptr);
+            {
+                lock_guard<mutex> lock(mtx_);
+                for (size_t i = 0; i < entries_.size(); ++i) {
+                    if (entries_[i].events) {
+                        struct pollfd fd = { entries_[i].fd, entries_[i].events,
+                                             0 };
+                        fds.push_back(fd);
+                        sockets.push_back(entries_[i].socket);
+                    }
+                }
+            }
+            if (::poll(&fds[0], fds.size(), -1) <= 0) {
+                continue;
+            }
+            if (fds[0].revents) {
+                char buf[64];
+                while (read(wakeup_pipe_[0], buf, sizeof(buf)) > 0) {
+                }
+            }
+            for (size_t i = 1; i < fds.size(); ++i) {
+                if (!fds[i].revents) {
+                    continue;
+                }
+                lock_guard<recursive_mutex> dispatch_lock(dispatch_mtx_);
+                bool still_registered = false;
+                {
+                    lock_guard<mutex> lock(mtx_);
+                    for (size_t j = 0; j < entries_.size(); ++j) {
+                        if (entries_[j].socket == sockets[i]
+                            && entries_[j].fd == fds[i].fd) {
+                            entries_[j].events &=
+                                    (short) ~(fds[i].revents | POLLIN | POLLOUT);
+                            still_registered = true;
+                        }
+                    }
+                }
+                if (still_registered) {
+                    sockets[i]->host_dispatch_sigio();
+                }
+            }
+        }
+    }
+
+    static void thread_main() {
+        instance().run();
+    }
+
+public:
+    static SigioDispatcher &instance() {
+        static SigioDispatcher INSTANCE;
+        return INSTANCE;
+    }
+
+    void arm(InternetSocket *socket, int fd, short events) {
+        {
+            lock_guard<mutex> lock(mtx_);
+            if (!started_) {
+                thread(thread_main).detach();
+                started_ = true;
+            }
+            bool found = false;
+            for (size_t i = 0; i < entries_.size(); ++i) {
+                if (entries_[i].socket == socket) {
+                    entries_[i].fd = fd;
+                    entries_[i].events |= events;
+                    found = true;
+                }
+            }
+            if (!found) {
+                Entry entry = { fd, events, socket };
+                entries_.push_back(entry);
+            }
+        }
+        wake_up();
+    }
+
+    void remove(InternetSocket *socket) {
+        {
+            lock_guard<recursive_mutex> dispatch_lock(dispatch_mtx_);
+            lock_guard<mutex> lock(mtx_);
+            for (size_t i = 0; i < entries_.size(); ++i) {
+                if (entries_[i].socket == socket) {
+                    entries_.erase(entries_.begin() + i);
+                    break;
+                }
+            }
+        }
+        wake_up();
+    }
+
+    void replace_callback(mbed::Callback<void()> &slot,
+                          const mbed::Callback<void()> &func) {
+        lock_guard<recursive_mutex> dispatch_lock(dispatch_mtx_);
+        slot = func;
+    }
+};
+
+nsapi_error_t errno_to_nsapi_error(int error) {
+    switch (error) {
+    case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+    case EWOULDBLOCK:
+#endif
+        return NSAPI_ERROR_WOULD_BLOCK;
+    case EINPROGRESS:
+        return NSAPI_ERROR_IN_PROGRESS;
+    case EALREADY:
+        return NSAPI_ERROR_ALREADY;
+    case EISCONN:
+        return NSAPI_ERROR_IS_CONNECTED;
+    case EADDRINUSE:
+        return NSAPI_ERROR_ADDRESS_IN_USE;
+    case ENOMEM:
+    case ENOBUFS:
+        return NSAPI_ERROR_NO_MEMORY;
+    case ENOTCONN:
+    case ECONNREFUSED:
+        return NSAPI_ERROR_NO_CONNECTION;
+    case ECONNRESET:
+    case EPIPE:
+        return NSAPI_ERROR_CONNECTION_LOST;
+    case ETIMEDOUT:
+        return NSAPI_ERROR_CONNECTION_TIMEOUT;
+    case EINVAL:
+    case EAFNOSUPPORT:
+        return NSAPI_ERROR_PARAMETER;
+    case EBADF:
+        return NSAPI_ERROR_NO_SOCKET;
+    default:
+        return NSAPI_ERROR_DEVICE_ERROR;
+    }
+}
+
+socklen_t to_sockaddr(struct sockaddr_storage *out,
+                      const SocketAddress &address) {
+    memset(out, 0, sizeof(*out));
+    if (address.get_ip_version() == NSAPI_IPv6) {
+        struct sockaddr_in6 *sin6 = reinterpret_cast<struct sockaddr_in6 *>(out);
+        sin6->sin6_family = AF_INET6;
+        memcpy(&sin6->sin6_addr, address.get_ip_bytes(), NSAPI_IPv6_BYTES);
+        sin6->sin6_port = htons(address.get_port());
+        return sizeof(*sin6);
+    } else {
+        struct sockaddr_in *sin = reinterpret_cast<struct sockaddr_in *>(out);
+        sin->sin_family = AF_INET;
+        if (address.get_ip_version() == NSAPI_IPv4) {
+            memcpy(&sin->sin_addr, address.get_ip_bytes(), NSAPI_IPv4_BYTES);
+        }
+        sin->sin_port = htons(address.get_port());
+        return sizeof(*sin);
+    }
+}
+
+SocketAddress from_sockaddr(const struct sockaddr *addr) {
+    if (addr->sa_family == AF_INET6) {
+        const struct sockaddr_in6 *sin6 =
+                reinterpret_cast<const struct sockaddr_in6 *>(addr);
+        return SocketAddress(&sin6->sin6_addr, NSAPI_IPv6,
+                             ntohs(sin6->sin6_port));
+    } else if (addr->sa_family == AF_INET) {
+        const struct sockaddr_in *sin =
+                reinterpret_cast<const struct sockaddr_in *>(addr);
+        return SocketAddress(&sin->sin_addr, NSAPI_IPv4, ntohs(sin->sin_port));
+    }
+    return SocketAddress();
+}
+
+NetworkInterface DEFAULT_INTERFACE;
+
+} // namespace
+
+SocketAddress::SocketAddress() : addr_(), port_(0), ip_address_() {}
+
+SocketAddress::SocketAddress(const nsapi_addr_t &addr, uint16_t port)
+        : addr_(addr), port_(port), ip_address_() {}
+
+SocketAddress::SocketAddress(const char *addr, uint16_t port)
+        : addr_(), port_(port), ip_address_() {
+    set_ip_address(addr);
+}
+
+SocketAddress::SocketAddress(const void *bytes,
+                             nsapi_version_t version,
+                             uint16_t port)
+        : addr_(), port_(port), ip_address_() {
+    set_ip_bytes(bytes, version);
+}
+
+SocketAddress::SocketAddress(const SocketAddress &addr)
+        : addr_(addr.addr_), port_(addr.port_), ip_address_() {}
+
+SocketAddress &SocketAddress::operator=(const SocketAddress &addr) {
+    addr_ = addr.addr_;
+    port_ = addr.port_;
+    ip_address_[0] = '\0';
+    return *this;
+}
+
+bool SocketAddress::set_ip_address(const char *addr) {
+    nsapi_addr_t result;
+    memset(&result, 0, sizeof(result));
+    if (addr && inet_pton(AF_INET, addr, result.bytes) == 1) {
+        result.version = NSAPI_IPv4;
+    } else if (addr && inet_pton(AF_INET6, addr, result.bytes) == 1) {
+        result.version = NSAPI_IPv6;
+    } else {
+        addr_ = nsapi_addr_t();
+        ip_address_[0] = '\0';
+        return false;
+    }
+    set_addr(result);
+    return true;
+}
+
+void SocketAddress::set_ip_bytes(const void *bytes, nsapi_version_t version) {
+    nsapi_addr_t addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.version = version;
+    if (version == NSAPI_IPv4) {
+        memcpy(addr.bytes, bytes, NSAPI_IPv4_BYTES);
+    } else if (version == NSAPI_IPv6) {
+        memcpy(addr.bytes, bytes, NSAPI_IPv6_BYTES);
+    }
+    set_addr(addr);
+}
+
+void SocketAddress::set_addr(const nsapi_addr_t &addr) {
+    addr_ = addr;
+    ip_address_[0] = '\0';
+}
+
+void SocketAddress::set_port(uint16_t port) {
+    port_ = port;
+}
+
+const char *SocketAddress::get_ip_address() const {
+    if (addr_.version == NSAPI_UNSPEC) {
+        return nullptr;
+    }
+    if (!ip_address_[0]) {
+        inet_ntop(addr_.version == NSAPI_IPv4 ? AF_INET : AF_INET6,
+                  addr_.bytes, ip_address_, sizeof(ip_address_));
+    }
+    return ip_address_;
+}
+
+const void *SocketAddress::get_ip_bytes() const {
+    return addr_.bytes;
+}
+
+nsapi_version_t SocketAddress::get_ip_version() const {
+    return addr_.version;
+}
+
+nsapi_addr_t SocketAddress::get_addr() const {
+    return addr_;
+}
+
+uint16_t SocketAddress::get_port() const {
+    return port_;
+}
+
+SocketAddress::operator bool() const {
+    for (size_t i = 0; i < sizeof(addr_.bytes); ++i) {
+        if (addr_.bytes[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool operator==(const SocketAddress &a, const SocketAddress &b) {
+    if (!a && !b) {
+        return true;
+    }
+    return a.addr_.version == b.addr_.version
+           && !memcmp(a.addr_.bytes, b.addr_.bytes,
+                      a.addr_.version == NSAPI_IPv4 ? NSAPI_IPv4_BYTES
+                                                    : NSAPI_IPv6_BYTES);
+}
+
+bool operator!=(const SocketAddress &a, const SocketAddress &b) {
+    return !(a == b);
+}
+
+NetworkInterface::NetworkInterface(const char *ip_address,
+                                   const char *device_name)
+        : stack_(this),
+          status_(NSAPI_STATUS_DISCONNECTED),
+          ip_address_(ip_address),
+          device_name_() {
+    if (device_name) {
+        strncpy(device_name_, device_name, sizeof(device_name_) - 1);
+    }
+}
+
+NetworkInterface *NetworkInterface::get_default_instance() {
+    return &DEFAULT_INTERFACE;
+}
+
+nsapi_error_t NetworkInterface::connect() {
+    status_ = NSAPI_STATUS_GLOBAL_UP;
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t NetworkInterface::disconnect() {
+    status_ = NSAPI_STATUS_DISCONNECTED;
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_connection_status_t NetworkInterface::get_connection_status() const {
+    return status_;
+}
+
+nsapi_error_t NetworkInterface::get_ip_address(SocketAddress *address) {
+    *address = ip_address_;
+    return NSAPI_ERROR_OK;
+}
+
+const char *NetworkInterface::get_ip_address() {
+    return ip_address_.get_ip_address();
+}
+
+const char *NetworkInterface::get_mac_address() {
+    return "00:00:00:00:00:00";
+}
+
+NetworkStack *nsapi_create_stack(NetworkInterface *interface) {
+    return interface ? interface->get_stack() : nullptr;
+}
+
+NetworkStack *nsapi_create_stack(NetworkStack *stack) {
+    return stack;
+}
+
+InternetSocket::InternetSocket()
+        : interface_(nullptr), fd_(-1), timeout_(-1), sigio_() {}
+
+InternetSocket::~InternetSocket() {
+    close();
+}
+
+nsapi_error_t InternetSocket::open(NetworkStack *stack) {
+    return open_fd(stack, socket_type());
+}
+
+nsapi_error_t InternetSocket::open_fd(NetworkStack *stack, int type) {
+    if (!stack) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+    if (fd_ >= 0) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+    // dual-stack socket, IPv4 addresses are handled as v4-mapped
+    int fd = socket(AF_INET6, type, 0);
+    if (fd < 0) {
+        return errno_to_nsapi_error(errno);
+    }
+    int v6only = 0;
+    ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only));
+#ifdef SO_BINDTODEVICE
+    const char *device = stack->get_interface()->get_device_name();
+    if (device) {
+        ::setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, device,
+                     (socklen_t) strlen(device));
+    }
+#endif // SO_BINDTODEVICE
+    adopt_fd(stack->get_interface(), fd);
+    return NSAPI_ERROR_OK;
+}
+
+void InternetSocket::adopt_fd(NetworkInterface *interface, int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    interface_ = interface;
+    fd_ = fd;
+    rearm_sigio(POLLIN);
+}
+
+nsapi_error_t InternetSocket::wait_for(short events) {
+    if (timeout_ == 0) {
+        return NSAPI_ERROR_WOULD_BLOCK;
+    }
+    struct pollfd fd = { fd_, events, 0 };
+    int result = ::poll(&fd, 1, timeout_);
+    if (result <= 0) {
+        return NSAPI_ERROR_WOULD_BLOCK;
+    }
+    return NSAPI_ERROR_OK;
+}
+
+void InternetSocket::rearm_sigio(short events) {
+    if (fd_ >= 0) {
+        SigioDispatcher::instance().arm(this, fd_, events);
+    }
+}
+
+void InternetSocket::host_dispatch_sigio() {
+    if (sigio_) {
+        sigio_();
+    }
+}
+
+nsapi_error_t InternetSocket::close() {
+    if (fd_ < 0) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    SigioDispatcher::instance().remove(this);
+    ::close(fd_);
+    fd_ = -1;
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t InternetSocket::bind(const SocketAddress &address) {
+    if (fd_ < 0) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    SocketAddress v6address = address;
+    if (address.get_ip_version() == NSAPI_IPv4) {
+        uint8_t bytes[NSAPI_IPv6_BYTES] = { 0, 0, 0, 0, 0,    0,
+                                            0, 0, 0, 0, 0xFF, 0xFF };
+        memcpy(&bytes[12], address.get_ip_bytes(), NSAPI_IPv4_BYTES);
+        v6address = SocketAddress(bytes, NSAPI_IPv6, address.get_port());
+    } else if (address.get_ip_version() == NSAPI_UNSPEC) {
+        uint8_t bytes[NSAPI_IPv6_BYTES] = { 0 };
+        v6address = SocketAddress(bytes, NSAPI_IPv6, address.get_port());
+    }
+    struct sockaddr_storage addr;
+    socklen_t addrlen = to_sockaddr(&addr, v6address);
+    if (::bind(fd_, reinterpret_cast<struct sockaddr *>(&addr), addrlen)) {
+        return errno_to_nsapi_error(errno);
+    }
+    return NSAPI_ERROR_OK;
+}
+
+void InternetSocket::set_blocking(bool blocking) {
+    ++MODE_CALLS;
+    timeout_ = blocking ? -1 : 0;
+}
+
+void InternetSocket::set_timeout(int timeout) {
+    ++MODE_CALLS;
+    timeout_ = timeout < 0 ? -1 : timeout;
+}
+
+nsapi_error_t InternetSocket::setsockopt(int level,
+                                         int optname,
+                                         const void *optval,
+                                         unsigned optlen) {
+    if (fd_ < 0) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    if (level == NSAPI_SOCKET && optname == NSAPI_REUSEADDR) {
+        if (::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, optval,
+                         (socklen_t) optlen)) {
+            return errno_to_nsapi_error(errno);
+        }
+        return NSAPI_ERROR_OK;
+    }
+    return NSAPI_ERROR_UNSUPPORTED;
+}
+
+nsapi_error_t InternetSocket::getsockopt(int level,
+                                         int optname,
+                                         void *optval,
+                                         unsigned *optlen) {
+    (void) level;
+    (void) optname;
+    (void) optval;
+    (void) optlen;
+    return NSAPI_ERROR_UNSUPPORTED;
+}
+
+void InternetSocket::sigio(mbed::Callback<void()> func) {
+    SigioDispatcher::instance().replace_callback(sigio_, func);
+}
+
+int32_t InternetSocket::host_local_port() const {
+    struct sockaddr_storage addr;
+    socklen_t addrlen = sizeof(addr);
+    if (fd_ < 0
+        || getsockname(fd_, reinterpret_cast<struct sockaddr *>(&addr),
+                       &addrlen)) {
+        return -1;
+    }
+    return from_sockaddr(reinterpret_cast<struct sockaddr *>(&addr))
+            .get_port();
+}
+
+namespace {
+
+SocketAddress unmap_v4(const SocketAddress &address) {
+    static const uint8_t V4MAPPED_PREFIX[] = { 0, 0, 0, 0, 0,    0,
+                                               0, 0, 0, 0, 0xFF, 0xFF };
+    if (address.get_ip_version() == NSAPI_IPv6
+        && !memcmp(address.get_ip_bytes(), V4MAPPED_PREFIX,
+                   sizeof(V4MAPPED_PREFIX))) {
+        return SocketAddress(
+                reinterpret_cast<const uint8_t *>(address.get_ip_bytes()) + 12,
+                NSAPI_IPv4, address.get_port());
+    }
+    return address;
+}
+
+SocketAddress map_v4(const SocketAddress &address) {
+    if (address.get_ip_version() == NSAPI_IPv4) {
+        uint8_t bytes[NSAPI_IPv6_BYTES] = { 0, 0, 0, 0, 0,    0,
+                                            0, 0, 0, 0, 0xFF, 0xFF };
+        memcpy(&bytes[12], address.get_ip_bytes(), NSAPI_IPv4_BYTES);
+        return SocketAddress(bytes, NSAPI_IPv6, address.get_port());
+    }
+    return address;
+}
+
+} // namespace
+
+int UDPSocket::socket_type() const {
+    return SOCK_DGRAM;
+}
+
+nsapi_error_t UDPSocket::connect(const SocketAddress &address) {
+    (void) address;
+    return NSAPI_ERROR_UNSUPPORTED;
+}
+
+nsapi_size_or_error_t UDPSocket::send(const void *data, nsapi_size_t size) {
+    (void) data;
+    (void) size;
+    return NSAPI_ERROR_UNSUPPORTED;
+}
+
+nsapi_size_or_error_t UDPSocket::recv(void *data, nsapi_size_t size) {
+    return recvfrom(nullptr, data, size);
+}
+
+nsapi_size_or_error_t UDPSocket::sendto(const SocketAddress &address,
+                                        const void *data,
+                                        nsapi_size_t size) {
+    if (fd_ < 0) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    struct sockaddr_storage addr;
+    socklen_t addrlen = to_sockaddr(&addr, map_v4(address));
+    while (true) {
+        ssize_t result =
+                ::sendto(fd_, data, size, 0,
+                         reinterpret_cast<struct sockaddr *>(&addr), addrlen);
+        if (result >= 0) {
+            return (nsapi_size_or_error_t) result;
+        }
+        nsapi_error_t err = errno_to_nsapi_error(errno);
+        if (err != NSAPI_ERROR_WOULD_BLOCK || wait_for(POLLOUT)) {
+            if (err == NSAPI_ERROR_WOULD_BLOCK) {
+                rearm_sigio(POLLOUT);
+            }
+            return err;
+        }
+    }
+}
+
+nsapi_size_or_error_t
+UDPSocket::recvfrom(SocketAddress *address, void *data, nsapi_size_t size) {
+    if (fd_ < 0) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    while (true) {
+        struct sockaddr_storage addr;
+        socklen_t addrlen = sizeof(addr);
+        ssize_t result =
+                ::recvfrom(fd_, data, size, 0,
+                           reinterpret_cast<struct sockaddr *>(&addr),
+                           &addrlen);
+        rearm_sigio(POLLIN);
+        if (result >= 0) {
+            if (address) {
+                *address = unmap_v4(
+                        from_sockaddr(reinterpret_cast<struct sockaddr *>(&addr)));
+            }
+            return (nsapi_size_or_error_t) result;
+        }
+        nsapi_error_t err = errno_to_nsapi_error(errno);
+        if (err != NSAPI_ERROR_WOULD_BLOCK || wait_for(POLLIN)) {
+            return err;
+        }
+    }
+}
+
+Socket *UDPSocket::accept(nsapi_error_t *error) {
+    if (error) {
+        *error = NSAPI_ERROR_UNSUPPORTED;
+    }
+    return nullptr;
+}
+
+nsapi_error_t UDPSocket::listen(int backlog) {
+    (void) backlog;
+    return NSAPI_ERROR_UNSUPPORTED;
+}
+
+int TCPSocket::socket_type() const {
+    return SOCK_STREAM;
+}
+
+nsapi_error_t TCPSocket::finish_connect() {
+    connect_in_progress_ = false;
+    int so_error = 0;
+    socklen_t len = sizeof(so_error);
+    if (::getsockopt(fd_, SOL_SOCKET, SO_ERROR, &so_error, &len)) {
+        return errno_to_nsapi_error(errno);
+    }
+    if (so_error) {
+        return errno_to_nsapi_error(so_error);
+    }
+    rearm_sigio(POLLIN);
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t TCPSocket::connect(const SocketAddress &address) {
+    if (fd_ < 0) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    if (connect_in_progress_) {
+        // Mbed OS semantics: in non-blocking mode, the connection state is
+        // polled by calling connect() again
+        struct pollfd fd = { fd_, POLLOUT, 0 };
+        if (::poll(&fd, 1, timeout_) <= 0) {
+            rearm_sigio(POLLOUT);
+            return timeout_ == 0 ? NSAPI_ERROR_ALREADY
+                                 : NSAPI_ERROR_CONNECTION_TIMEOUT;
+        }
+        nsapi_error_t err = finish_connect();
+        if (!err && timeout_ == 0) {
+            err = NSAPI_ERROR_IS_CONNECTED;
+        }
+        return err;
+    }
+    struct sockaddr_storage addr;
+    socklen_t addrlen = to_sockaddr(&addr, map_v4(address));
+    if (!::connect(fd_, reinterpret_cast<struct sockaddr *>(&addr), addrlen)) {
+        rearm_sigio(POLLIN);
+        return NSAPI_ERROR_OK;
+    }
+    if (errno != EINPROGRESS) {
+        return errno_to_nsapi_error(errno);
+    }
+    connect_in_progress_ = true;
+    if (timeout_ == 0) {
+        rearm_sigio(POLLOUT);
+        return NSAPI_ERROR_IN_PROGRESS;
+    }
+    struct pollfd fd = { fd_, POLLOUT, 0 };
+    if (::poll(&fd, 1, timeout_) <= 0) {
+        connect_in_progress_ = false;
+        return NSAPI_ERROR_CONNECTION_TIMEOUT;
+    }
+    return finish_connect();
+}
+
+nsapi_size_or_error_t TCPSocket::send(const void *data, nsapi_size_t size) {
+    if (fd_ < 0) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    if (size == 0) {
+        // zero-length send is used as a connection probe
+        int so_error = 0;
+        socklen_t len = sizeof(so_error);
+        if (::getsockopt(fd_, SOL_SOCKET, SO_ERROR, &so_error, &len)
+            || so_error) {
+            return NSAPI_ERROR_NO_CONNECTION;
+        }
+        return 0;
+    }
+    while (true) {
+        ssize_t result = ::send(fd_, data, size, MSG_NOSIGNAL);
+        if (result >= 0) {
+            return (nsapi_size_or_error_t) result;
+        }
+        nsapi_error_t err = errno_to_nsapi_error(errno);
+        if (err != NSAPI_ERROR_WOULD_BLOCK || wait_for(POLLOUT)) {
+            if (err == NSAPI_ERROR_WOULD_BLOCK) {
+                rearm_sigio(POLLOUT);
+            }
+            return err;
+        }
+    }
+}
+
+nsapi_size_or_error_t TCPSocket::recv(void *data, nsapi_size_t size) {
+    if (fd_ < 0) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    while (true) {
+        ssize_t result = ::recv(fd_, data, size, 0);
+        rearm_sigio(POLLIN);
+        if (result >= 0) {
+            return (nsapi_size_or_error_t) result;
+        }
+        nsapi_error_t err = errno_to_nsapi_error(errno);
+        if (err != NSAPI_ERROR_WOULD_BLOCK || wait_for(POLLIN)) {
+            return err;
+        }
+    }
+}
+
+nsapi_size_or_error_t TCPSocket::sendto(const SocketAddress &address,
+                                        const void *data,
+                                        nsapi_size_t size) {
+    (void) address;
+    return send(data, size);
+}
+
+nsapi_size_or_error_t
+TCPSocket::recvfrom(SocketAddress *address, void *data, nsapi_size_t size) {
+    (void) address;
+    return recv(data, size);
+}
+
+TCPSocket *TCPSocket::accept(nsapi_error_t *error) {
+    nsapi_error_t err = NSAPI_ERROR_OK;
+    TCPSocket *result = nullptr;
+    while (fd_ >= 0) {
+        int fd = ::accept(fd_, nullptr, nullptr);
+        rearm_sigio(POLLIN);
+        if (fd >= 0) {
+            result = new (nothrow) TCPSocket();
+            if (!result) {
+                ::close(fd);
+                err = NSAPI_ERROR_NO_MEMORY;
+            } else {
+                result->adopt_fd(interface_, fd);
+            }
+            break;
+        }
+        err = errno_to_nsapi_error(errno);
+        if (err != NSAPI_ERROR_WOULD_BLOCK || wait_for(POLLIN)) {
+            break;
+        }
+    }
+    if (fd_ < 0) {
+        err = NSAPI_ERROR_NO_SOCKET;
+    }
+    if (error) {
+        *error = err;
+    }
+    return result;
+}
+
+nsapi_error_t TCPSocket::listen(int backlog) {
+    if (fd_ < 0) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    if (::listen(fd_, backlog)) {
+        return errno_to_nsapi_error(errno);
+    }
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_size_or_error_t nsapi_dns_query_multiple(NetworkStack *stack,
+                                               const char *host,
+                                               SocketAddress *addr,
+                                               nsapi_size_t addr_count,
+                                               const char *interface_name,
+                                               nsapi_version_t version) {
+    (void) stack;
+    (void) interface_name;
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = (version == NSAPI_IPv6) ? AF_INET6 : AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo *result = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &result) || !result) {
+        return NSAPI_ERROR_DNS_FAILURE;
+    }
+    nsapi_size_t count = 0;
+    for (struct addrinfo *ai = result; ai && count < addr_count;
+         ai = ai->ai_next) {
+        addr[count++] = from_sockaddr(ai->ai_addr);
+    }
+    freeaddrinfo(result);
+    return (nsapi_size_or_error_t) count;
+}
+
+nsapi_error_t nsapi_dns_query(NetworkStack *stack,
+                              const char *host,
+                              SocketAddress *addr,
+                              const char *interface_name,
+                              nsapi_version_t version) {
+    nsapi_size_or_error_t result = nsapi_dns_query_multiple(
+            stack, host, addr, 1, interface_name, version);
+    return result < 0 ? result : NSAPI_ERROR_OK;
+}
+
+unsigned long mbed_host_socket_mode_calls() {
+    return MODE_CALLS;
+}
+
+long mbed_host_udp_rx_drops() {
+    // /proc/net/snmp contains pairs of lines: "Udp: <field names...>" followed
+    // by "Udp: <values...>"
+    ifstream snmp("/proc/net/snmp");
+    string names;
+    string values;
+    while (getline(snmp, names)) {
+        if (names.compare(0, 4, "Udp:") == 0 && getline(snmp, values)) {
+            istringstream name_stream(names);
+            istringstream value_stream(values);
+            string name;
+            string value;
+            while (name_stream >> name && value_stream >> value) {
+                if (name == "RcvbufErrors") {
+                    return strtol(value.c_str(), nullptr, 10);
+                }
+            }
+            break;
+        }
+    }
+    return -1;
+}
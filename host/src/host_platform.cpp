@@ -0,0 +1,118 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <mutex>
+
+#include "hal/us_ticker_api.h"
+#include "mbed_host_platform.h"
+
+namespace {
+
+std::recursive_mutex CRITICAL_SECTION_MUTEX;
+
+} // namespace
+
+struct ticker_data_s {
+    int dummy;
+};
+
+extern "C" {
+
+void mbed_assert_internal(const char *expr, const char *file, int line) {
+    fprintf(stderr, "assertion failed: %s, file: %s, line %d\n", expr, file,
+            line);
+    abort();
+}
+
+void error(const char *format, ...) {
+    va_list list;
+    va_start(list, format);
+    vfprintf(stderr, format, list);
+    va_end(list);
+    abort();
+}
+
+void core_util_critical_section_enter(void) {
+    CRITICAL_SECTION_MUTEX.lock();
+}
+
+void core_util_critical_section_exit(void) {
+    CRITICAL_SECTION_MUTEX.unlock();
+}
+
+bool core_util_atomic_cas_u32(volatile uint32_t *ptr,
+                              uint32_t *expected_current_value,
+                              uint32_t desired_value) {
+    return __atomic_compare_exchange_n(ptr, expected_current_value,
+                                       desired_value, false, __ATOMIC_SEQ_CST,
+                                       __ATOMIC_SEQ_CST);
+}
+
+uint32_t core_util_atomic_incr_u32(volatile uint32_t *value_ptr,
+                                   uint32_t delta) {
+    return __atomic_add_fetch(value_ptr, delta, __ATOMIC_SEQ_CST);
+}
+
+uint32_t core_util_atomic_decr_u32(volatile uint32_t *value_ptr,
+                                   uint32_t delta) {
+    return __atomic_sub_fetch(value_ptr, delta, __ATOMIC_SEQ_CST);
+}
+
+uint32_t core_util_atomic_load_u32(const volatile uint32_t *value_ptr) {
+    return __atomic_load_n(value_ptr, __ATOMIC_SEQ_CST);
+}
+
+void core_util_atomic_store_u32(volatile uint32_t *value_ptr,
+                                uint32_t desired_value) {
+    __atomic_store_n(value_ptr, desired_value, __ATOMIC_SEQ_CST);
+}
+
+uint32_t core_util_atomic_fetch_add_u32(volatile uint32_t *value_ptr,
+                                        uint32_t arg) {
+    return __atomic_fetch_add(value_ptr, arg, __ATOMIC_SEQ_CST);
+}
+
+void sleep_manager_lock_deep_sleep(void) {}
+
+void sleep_manager_unlock_deep_sleep(void) {}
+
+int mbedtls_platform_setup(void *ctx) {
+    (void) ctx;
+    return 0;
+}
+
+const ticker_data_t *get_us_ticker_data(void) {
+    static const ticker_data_t US_TICKER = { 0 };
+    return &US_TICKER;
+}
+
+us_timestamp_t ticker_read_us(const ticker_data_t *const ticker) {
+    (void) ticker;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (us_timestamp_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t us_ticker_read(void) {
+    return (uint32_t) ticker_read_us(get_us_ticker_data());
+}
+
+} // extern "C"
@@ -0,0 +1,261 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <thread>
+
+#include "mbed_host_rtos.h"
+
+namespace rtos {
+
+namespace {
+
+thread_local char THREAD_ID_TOKEN;
+
+std::chrono::steady_clock::time_point
+deadline_from_ms(uint32_t millisec, bool *out_forever) {
+    *out_forever = (millisec == osWaitForever);
+    return std::chrono::steady_clock::now()
+           + std::chrono::milliseconds(millisec);
+}
+
+} // namespace
+
+uint64_t Kernel::get_ms_count() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+Mutex::Mutex() : mtx_(), owner_(nullptr), count_(0) {}
+
+Mutex::Mutex(const char *name) : mtx_(), owner_(nullptr), count_(0) {
+    (void) name;
+}
+
+void Mutex::lock() {
+    mtx_.lock();
+    owner_ = ThisThread::get_id();
+    ++count_;
+}
+
+bool Mutex::trylock() {
+    if (!mtx_.try_lock()) {
+        return false;
+    }
+    owner_ = ThisThread::get_id();
+    ++count_;
+    return true;
+}
+
+bool Mutex::trylock_for(Kernel::Clock::duration_u32 rel_time) {
+    if (!mtx_.try_lock_for(rel_time)) {
+        return false;
+    }
+    owner_ = ThisThread::get_id();
+    ++count_;
+    return true;
+}
+
+void Mutex::unlock() {
+    if (--count_ == 0) {
+        owner_ = nullptr;
+    }
+    mtx_.unlock();
+}
+
+osThreadId_t Mutex::get_owner() {
+    return owner_;
+}
+
+Semaphore::Semaphore(int32_t count)
+        : mtx_(), cond_(), count_(count), max_count_(0xFFFF) {}
+
+Semaphore::Semaphore(int32_t count, uint16_t max_count)
+        : mtx_(), cond_(), count_(count), max_count_(max_count) {}
+
+bool Semaphore::acquire_until(
+        const std::chrono::steady_clock::time_point *deadline) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (count_ <= 0) {
+        if (!deadline) {
+            cond_.wait(lock);
+        } else if (cond_.wait_until(lock, *deadline)
+                   == std::cv_status::timeout) {
+            if (count_ <= 0) {
+                return false;
+            }
+        }
+    }
+    --count_;
+    return true;
+}
+
+void Semaphore::acquire() {
+    acquire_until(nullptr);
+}
+
+bool Semaphore::try_acquire() {
+    std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+    return acquire_until(&now);
+}
+
+bool Semaphore::try_acquire_for(Kernel::Clock::duration_u32 rel_time) {
+    if (rel_time.count() == osWaitForever) {
+        return acquire_until(nullptr);
+    }
+    std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + rel_time;
+    return acquire_until(&deadline);
+}
+
+osStatus Semaphore::release() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (count_ >= max_count_) {
+        return osErrorResource;
+    }
+    ++count_;
+    cond_.notify_one();
+    return osOK;
+}
+
+EventFlags::EventFlags() : mtx_(), cond_(), flags_(0) {}
+
+EventFlags::EventFlags(const char *name) : mtx_(), cond_(), flags_(0) {
+    (void) name;
+}
+
+uint32_t EventFlags::set(uint32_t flags) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    flags_ |= flags;
+    cond_.notify_all();
+    return flags_;
+}
+
+uint32_t EventFlags::clear(uint32_t flags) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    uint32_t result = flags_;
+    flags_ &= ~flags;
+    return result;
+}
+
+uint32_t EventFlags::get() const {
+    return const_cast<EventFlags *>(this)->clear(0);
+}
+
+uint32_t
+EventFlags::wait_for_any(uint32_t flags, uint32_t millisec, bool clear) {
+    if (!flags) {
+        flags = 0x7fffffff;
+    }
+    bool forever;
+    std::chrono::steady_clock::time_point deadline =
+            deadline_from_ms(millisec, &forever);
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!(flags_ & flags)) {
+        if (forever) {
+            cond_.wait(lock);
+        } else if (cond_.wait_until(lock, deadline)
+                           == std::cv_status::timeout
+                   && !(flags_ & flags)) {
+            return (uint32_t) osErrorTimeout;
+        }
+    }
+    uint32_t result = flags_;
+    if (clear) {
+        flags_ &= ~flags;
+    }
+    return result;
+}
+
+uint32_t EventFlags::wait_any(uint32_t flags, uint32_t millisec, bool clear) {
+    return wait_for_any(flags, millisec, clear);
+}
+
+uint32_t EventFlags::wait_any_for(uint32_t flags,
+                                  Kernel::Clock::duration_u32 rel_time,
+                                  bool clear) {
+    return wait_for_any(flags, rel_time.count(), clear);
+}
+
+Thread::Thread(osPriority_t priority,
+               uint32_t stack_size,
+               unsigned char *stack_mem,
+               const char *name)
+        : thread_(nullptr), priority_(priority), name_(name) {
+    // host threads use the default system stack size
+    (void) stack_size;
+    (void) stack_mem;
+}
+
+Thread::~Thread() {
+    std::thread *thread = static_cast<std::thread *>(thread_);
+    if (thread) {
+        if (thread->joinable()) {
+            thread->detach();
+        }
+        delete thread;
+    }
+}
+
+osStatus Thread::start(mbed::Callback<void()> task) {
+    if (thread_) {
+        return osErrorResource;
+    }
+    thread_ = new std::thread(task);
+    return osOK;
+}
+
+osStatus Thread::join() {
+    std::thread *thread = static_cast<std::thread *>(thread_);
+    if (!thread || !thread->joinable()) {
+        return osErrorResource;
+    }
+    thread->join();
+    return osOK;
+}
+
+osStatus Thread::set_priority(osPriority_t priority) {
+    // priorities are not enforced on the host
+    priority_ = priority;
+    return osOK;
+}
+
+osPriority_t Thread::get_priority() const {
+    return priority_;
+}
+
+const char *Thread::get_name() const {
+    return name_;
+}
+
+void ThisThread::sleep_for(uint32_t millisec) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(millisec));
+}
+
+void ThisThread::sleep_for(Kernel::Clock::duration_u32 rel_time) {
+    std::this_thread::sleep_for(rel_time);
+}
+
+void ThisThread::yield() {
+    std::this_thread::yield();
+}
+
+osThreadId_t ThisThread::get_id() {
+    return &THREAD_ID_TOKEN;
+}
+
+} // namespace rtos
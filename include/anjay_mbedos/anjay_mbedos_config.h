@@ -0,0 +1,348 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANJAY_MBEDOS_CONFIG_H
+#define ANJAY_MBEDOS_CONFIG_H
+
+/**
+ * @file anjay_mbedos_config.h
+ *
+ * Anjay-mbedos integration layer configuration.
+ *
+ * This file controls optional features of the Mbed OS integration layer itself
+ * (i.e. the code in the <c>src</c> directory), as opposed to
+ * <c>anjay_config.h</c>, <c>avs_commons_config.h</c> and
+ * <c>avs_coap_config.h</c>, which configure the bundled libraries.
+ *
+ * Options that are commented out as <c>#undef</c> directives are disabled. To
+ * enable any of them, please replace it with a regular <c>#define</c>, or
+ * alternatively define the macro through the <c>macros</c> section of
+ * <c>mbed_app.json</c>. Numeric values are only defined here if not already
+ * defined, so that they can be overridden in the same way.
+ */
+
+/**
+ * Enables the binary socket trace facility (see <c>avs_socket_trace.h</c>).
+ *
+ * If enabled, the socket layer stores fixed-size binary records of notable
+ * events (polling, sending, receiving, routing decisions etc.) in a RAM ring
+ * buffer, without any string formatting. The buffer can be dumped at runtime
+ * using <c>AvsSocketTrace::dump()</c> and decoded offline using
+ * <c>tools/socket_trace_decode.py</c>.
+ *
+ * If disabled, all trace points compile to nothing.
+ */
+/* #undef ANJAY_MBEDOS_WITH_SOCKET_TRACE */
+
+/**
+ * Number of records stored in the socket trace ring buffer. Each record takes
+ * 16 bytes of RAM. MUST be a power of two.
+ *
+ * Only meaningful if <c>ANJAY_MBEDOS_WITH_SOCKET_TRACE</c> is enabled.
+ */
+#ifndef ANJAY_MBEDOS_SOCKET_TRACE_BUFFER_SIZE
+#define ANJAY_MBEDOS_SOCKET_TRACE_BUFFER_SIZE 256
+#endif // ANJAY_MBEDOS_SOCKET_TRACE_BUFFER_SIZE
+
+/**
+ * Number of messages that can be queued in <c>AvsAsyncLogSink</c> before new
+ * ones are dropped. MUST be a power of two.
+ */
+#ifndef ANJAY_MBEDOS_LOG_SINK_SLOTS
+#define ANJAY_MBEDOS_LOG_SINK_SLOTS 16
+#endif // ANJAY_MBEDOS_LOG_SINK_SLOTS
+
+/**
+ * Maximum length of a single message queued in <c>AvsAsyncLogSink</c>,
+ * including the terminating nullbyte. Longer messages are truncated. The ring
+ * buffer takes approximately
+ * <c>ANJAY_MBEDOS_LOG_SINK_SLOTS * ANJAY_MBEDOS_LOG_SINK_LINE_LENGTH</c> bytes
+ * of RAM.
+ */
+#ifndef ANJAY_MBEDOS_LOG_SINK_LINE_LENGTH
+#define ANJAY_MBEDOS_LOG_SINK_LINE_LENGTH 256
+#endif // ANJAY_MBEDOS_LOG_SINK_LINE_LENGTH
+
+/**
+ * Enables the mutex profiler (see <c>avs_mutex_profile.h</c>).
+ *
+ * If enabled, every <c>avs_mutex_t</c> (including the ones used internally by
+ * Anjay and avs_commons when <c>ANJAY_WITH_THREAD_SAFETY</c> and
+ * <c>AVS_COMMONS_SCHED_THREAD_SAFE</c> are enabled) records the number of
+ * acquisitions, the number of contended acquisitions, total and maximum time
+ * spent waiting for it, and maximum time it was held. The statistics can be
+ * read at runtime using <c>AvsMutexProfile::dump()</c>.
+ *
+ * If disabled, mutexes are plain wrappers around <c>rtos::Mutex</c>.
+ */
+/* #undef ANJAY_MBEDOS_WITH_MUTEX_PROFILE */
+
+/**
+ * Maximum number of mutexes that can be profiled at the same time. Mutexes
+ * created when all slots are taken work normally, but are not profiled. Each
+ * slot takes 40 bytes of RAM.
+ *
+ * Only meaningful if <c>ANJAY_MBEDOS_WITH_MUTEX_PROFILE</c> is enabled.
+ */
+#ifndef ANJAY_MBEDOS_MUTEX_PROFILE_SLOTS
+#define ANJAY_MBEDOS_MUTEX_PROFILE_SLOTS 16
+#endif // ANJAY_MBEDOS_MUTEX_PROFILE_SLOTS
+
+/**
+ * Enables <c>AvsDtlsSessionStore</c> (see <c>avs_dtls_session_store.h</c>), a
+ * cache of DTLS sessions that persists across reboots, so that the first
+ * handshake after a reboot can be an abbreviated one.
+ *
+ * Requires the Mbed OS KVStore global API, i.e. the <c>storage</c> component
+ * with a configured default KVStore (and, in Mbed CLI 2 builds, linking with
+ * <c>mbed-storage-kv-global-api</c>).
+ */
+/* #undef ANJAY_MBEDOS_WITH_DTLS_SESSION_STORE */
+
+/**
+ * KVStore path prefix under which DTLS sessions are stored, including the
+ * partition name.
+ */
+#ifndef ANJAY_MBEDOS_DTLS_SESSION_STORE_PATH
+#define ANJAY_MBEDOS_DTLS_SESSION_STORE_PATH "/kv/"
+#endif // ANJAY_MBEDOS_DTLS_SESSION_STORE_PATH
+
+/**
+ * Maximum number of DTLS sessions kept in the persistent store. When saving a
+ * session for a new peer would exceed it, the oldest session is evicted.
+ */
+#ifndef ANJAY_MBEDOS_DTLS_SESSION_STORE_MAX_ENTRIES
+#define ANJAY_MBEDOS_DTLS_SESSION_STORE_MAX_ENTRIES 4
+#endif // ANJAY_MBEDOS_DTLS_SESSION_STORE_MAX_ENTRIES
+
+/**
+ * Maximum age, in seconds, of a persisted DTLS session that will still be
+ * loaded. Servers typically forget sessions after some time anyway, and
+ * attempting to resume those only costs an additional round trip.
+ */
+#ifndef ANJAY_MBEDOS_DTLS_SESSION_STORE_MAX_AGE_S
+#define ANJAY_MBEDOS_DTLS_SESSION_STORE_MAX_AGE_S 86400
+#endif // ANJAY_MBEDOS_DTLS_SESSION_STORE_MAX_AGE_S
+
+/**
+ * Number of certificate files whose contents are cached in RAM (in DER form)
+ * after being loaded by <c>mbedtls_x509_crt_parse_file()</c> or
+ * <c>mbedtls_x509_crt_parse_path()</c>; see <c>avs_x509_cache.h</c>. The least
+ * recently used file is evicted when the cache is full. MUST be at least 1.
+ */
+#ifndef ANJAY_MBEDOS_X509_CACHE_SIZE
+#define ANJAY_MBEDOS_X509_CACHE_SIZE 4
+#endif // ANJAY_MBEDOS_X509_CACHE_SIZE
+
+/**
+ * Maximum number of network interfaces that can be registered at the same time
+ * using <c>AvsSocketGlobal::add_interface()</c>, in addition to the default one
+ * passed to the <c>AvsSocketGlobal</c> constructor.
+ */
+#ifndef ANJAY_MBEDOS_MAX_NAMED_INTERFACES
+#define ANJAY_MBEDOS_MAX_NAMED_INTERFACES 2
+#endif // ANJAY_MBEDOS_MAX_NAMED_INTERFACES
+
+/**
+ * Number of datagrams that <c>AvsUdpRxThread</c> can hand off to each UDP
+ * router before they are picked up by the threads reading from its sockets.
+ * Datagrams received while the ring is full are dropped. MUST be a power of
+ * two.
+ */
+#ifndef ANJAY_MBEDOS_UDP_RX_RING_SIZE
+#define ANJAY_MBEDOS_UDP_RX_RING_SIZE 8
+#endif // ANJAY_MBEDOS_UDP_RX_RING_SIZE
+
+/**
+ * Number of UDP routers (i.e. local UDP ports in use) that fit in the router
+ * table before it has to be moved to the heap. The table is scanned on every
+ * bind, so it is kept contiguous.
+ *
+ * Ignored if <c>ANJAY_MBEDOS_WITH_STATIC_ALLOCATION</c> is enabled, in which
+ * case <c>ANJAY_MBEDOS_STATIC_MAX_UDP_ROUTERS</c> is used.
+ */
+#ifndef ANJAY_MBEDOS_UDP_ROUTERS_INLINE
+#define ANJAY_MBEDOS_UDP_ROUTERS_INLINE 4
+#endif // ANJAY_MBEDOS_UDP_ROUTERS_INLINE
+
+/**
+ * Number of sockets that can be registered in a single UDP router before its
+ * socket table has to be moved to the heap. The table is scanned for every
+ * received datagram, so it is kept contiguous. Each entry takes one pointer
+ * in every router.
+ *
+ * Ignored if <c>ANJAY_MBEDOS_WITH_STATIC_ALLOCATION</c> is enabled, in which
+ * case <c>ANJAY_MBEDOS_STATIC_MAX_SOCKETS</c> is used.
+ */
+#ifndef ANJAY_MBEDOS_UDP_ROUTER_SOCKETS_INLINE
+#define ANJAY_MBEDOS_UDP_ROUTER_SOCKETS_INLINE 4
+#endif // ANJAY_MBEDOS_UDP_ROUTER_SOCKETS_INLINE
+
+/**
+ * Number of destinations for which path MTU estimates are kept, see
+ * <c>AvsSocketGlobal::set_pmtu_discovery()</c>. The least recently used entry
+ * is evicted when a new destination is contacted.
+ */
+#ifndef ANJAY_MBEDOS_PMTU_CACHE_SIZE
+#define ANJAY_MBEDOS_PMTU_CACHE_SIZE 8
+#endif // ANJAY_MBEDOS_PMTU_CACHE_SIZE
+
+/**
+ * Largest IP packet size probed by path MTU discovery, typically the MTU of
+ * the local link.
+ */
+#ifndef ANJAY_MBEDOS_PMTU_MAX
+#define ANJAY_MBEDOS_PMTU_MAX 1500
+#endif // ANJAY_MBEDOS_PMTU_MAX
+
+/**
+ * Enables <c>AvsFwUpdateBlockDevice</c>, a Firmware Update object backend that
+ * writes the downloaded image to a slot of an Mbed OS <c>BlockDevice</c>
+ * (see <c>avs_fw_update_block_device.h</c>).
+ *
+ * Requires <c>ANJAY_WITH_MODULE_FW_UPDATE</c> and the Mbed OS block device
+ * component (<c>mbed-storage-blockdevice</c> in Mbed CLI 2 builds).
+ */
+/* #undef ANJAY_MBEDOS_WITH_FW_UPDATE_BLOCK_DEVICE */
+
+/**
+ * Size of each of the two buffers in which <c>AvsFwUpdateBlockDevice</c>
+ * collects incoming data before it is programmed. MUST be a multiple of the
+ * program size of the block device.
+ *
+ * Only meaningful if <c>ANJAY_MBEDOS_WITH_FW_UPDATE_BLOCK_DEVICE</c> is
+ * enabled.
+ */
+#ifndef ANJAY_MBEDOS_FW_UPDATE_BUFFER_SIZE
+#define ANJAY_MBEDOS_FW_UPDATE_BUFFER_SIZE 1024
+#endif // ANJAY_MBEDOS_FW_UPDATE_BUFFER_SIZE
+
+/**
+ * Enables the static allocation mode (see <c>avs_static_pool.h</c>).
+ *
+ * If enabled, the network layer does not use the heap at runtime: sockets, UDP
+ * routers, mbed TCP sockets, received datagrams, DNS resolution results and
+ * all staging buffers are allocated from statically sized pools, with the
+ * capacities configured by the <c>ANJAY_MBEDOS_STATIC_*</c> options below.
+ * Running out of a pool is reported as <c>AVS_ENOMEM</c>, just like a failed
+ * heap allocation.
+ *
+ * In this mode, <c>AvsSocketGlobal::set_shared_recv_buffers()</c> is called
+ * with <c>ANJAY_MBEDOS_STATIC_RECV_BUFFERS</c> when <c>AvsSocketGlobal</c> is
+ * created, and the <c>recv_buffer_size</c> passed to it MUST NOT exceed
+ * <c>ANJAY_MBEDOS_STATIC_RECV_BUFFER_SIZE</c>.
+ *
+ * The total amount of reserved RAM can be listed after building the firmware
+ * using <c>tools/static_ram_report.py</c>.
+ */
+/* #undef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION */
+
+/**
+ * Maximum number of avs_net sockets (UDP and TCP, not counting the DTLS/TLS
+ * layer) that may exist at the same time.
+ *
+ * Only meaningful if <c>ANJAY_MBEDOS_WITH_STATIC_ALLOCATION</c> is enabled.
+ */
+#ifndef ANJAY_MBEDOS_STATIC_MAX_SOCKETS
+#define ANJAY_MBEDOS_STATIC_MAX_SOCKETS 4
+#endif // ANJAY_MBEDOS_STATIC_MAX_SOCKETS
+
+/**
+ * Maximum number of UDP routers, i.e. mbed UDP sockets, one per local port in
+ * use, that may exist at the same time.
+ *
+ * Only meaningful if <c>ANJAY_MBEDOS_WITH_STATIC_ALLOCATION</c> is enabled.
+ */
+#ifndef ANJAY_MBEDOS_STATIC_MAX_UDP_ROUTERS
+#define ANJAY_MBEDOS_STATIC_MAX_UDP_ROUTERS 2
+#endif // ANJAY_MBEDOS_STATIC_MAX_UDP_ROUTERS
+
+/**
+ * Maximum number of mbed TCP sockets that may exist at the same time. Sockets
+ * returned by <c>TCPSocket::accept()</c> on mbed OS 5.10 and newer are
+ * allocated by mbed OS itself and are not counted.
+ *
+ * Only meaningful if <c>ANJAY_MBEDOS_WITH_STATIC_ALLOCATION</c> is enabled.
+ */
+#ifndef ANJAY_MBEDOS_STATIC_MAX_TCP_SOCKETS
+#define ANJAY_MBEDOS_STATIC_MAX_TCP_SOCKETS 1
+#endif // ANJAY_MBEDOS_STATIC_MAX_TCP_SOCKETS
+
+/**
+ * Size of each statically allocated datagram buffer; an upper limit for the
+ * <c>recv_buffer_size</c> passed to <c>AvsSocketGlobal</c>, and for the length
+ * of datagrams sent using <c>AvsSocketGlobal::send_vectored()</c>.
+ *
+ * Only meaningful if <c>ANJAY_MBEDOS_WITH_STATIC_ALLOCATION</c> is enabled.
+ */
+#ifndef ANJAY_MBEDOS_STATIC_RECV_BUFFER_SIZE
+#define ANJAY_MBEDOS_STATIC_RECV_BUFFER_SIZE 1280
+#endif // ANJAY_MBEDOS_STATIC_RECV_BUFFER_SIZE
+
+/**
+ * Number of receive buffers shared by all UDP routers, see
+ * <c>AvsSocketGlobal::set_shared_recv_buffers()</c>. MUST be at least 1.
+ *
+ * Only meaningful if <c>ANJAY_MBEDOS_WITH_STATIC_ALLOCATION</c> is enabled.
+ */
+#ifndef ANJAY_MBEDOS_STATIC_RECV_BUFFERS
+#define ANJAY_MBEDOS_STATIC_RECV_BUFFERS 1
+#endif // ANJAY_MBEDOS_STATIC_RECV_BUFFERS
+
+/**
+ * Maximum number of received datagrams waiting in the receive queues of all
+ * UDP sockets (and in the handoff rings of <c>AvsUdpRxThread</c>) together.
+ * Datagrams received while all of them are in use are dropped. Each one takes
+ * slightly more than <c>ANJAY_MBEDOS_STATIC_RECV_BUFFER_SIZE</c> bytes of RAM.
+ *
+ * Only meaningful if <c>ANJAY_MBEDOS_WITH_STATIC_ALLOCATION</c> is enabled.
+ */
+#ifndef ANJAY_MBEDOS_STATIC_MAX_QUEUED_DATAGRAMS
+#define ANJAY_MBEDOS_STATIC_MAX_QUEUED_DATAGRAMS 4
+#endif // ANJAY_MBEDOS_STATIC_MAX_QUEUED_DATAGRAMS
+
+/**
+ * Maximum number of address resolution results (<c>avs_net_addrinfo_t</c>
+ * objects) that may exist at the same time.
+ *
+ * Only meaningful if <c>ANJAY_MBEDOS_WITH_STATIC_ALLOCATION</c> is enabled.
+ */
+#ifndef ANJAY_MBEDOS_STATIC_MAX_ADDRINFOS
+#define ANJAY_MBEDOS_STATIC_MAX_ADDRINFOS 2
+#endif // ANJAY_MBEDOS_STATIC_MAX_ADDRINFOS
+
+/**
+ * Maximum number of addresses returned by a single DNS query; an upper limit
+ * for the <c>max_dns_results</c> passed to <c>AvsSocketGlobal</c>.
+ *
+ * Only meaningful if <c>ANJAY_MBEDOS_WITH_STATIC_ALLOCATION</c> is enabled.
+ */
+#ifndef ANJAY_MBEDOS_STATIC_MAX_DNS_RESULTS
+#define ANJAY_MBEDOS_STATIC_MAX_DNS_RESULTS 4
+#endif // ANJAY_MBEDOS_STATIC_MAX_DNS_RESULTS
+
+/**
+ * Maximum number of <c>AvsServeLoop</c> instances that may exist at the same
+ * time. Each of them can poll up to <c>ANJAY_MBEDOS_STATIC_MAX_SOCKETS</c>
+ * sockets.
+ *
+ * Only meaningful if <c>ANJAY_MBEDOS_WITH_STATIC_ALLOCATION</c> is enabled.
+ */
+#ifndef ANJAY_MBEDOS_STATIC_MAX_SERVE_LOOPS
+#define ANJAY_MBEDOS_STATIC_MAX_SERVE_LOOPS 1
+#endif // ANJAY_MBEDOS_STATIC_MAX_SERVE_LOOPS
+
+#endif /* ANJAY_MBEDOS_CONFIG_H */
@@ -78,7 +78,9 @@ int avs_condvar_wait(avs_condvar_t *condvar,
         waiter.next = condvar->first_waiter;
         condvar->first_waiter = &waiter;
     }
-    mutex->mbed_mtx.unlock();
+    // not using mutex->mbed_mtx directly, so that the mutex profiler sees the
+    // time spent waiting as released
+    avs_mutex_unlock(mutex);
 #if MBED_MAJOR_VERSION >= 6
     bool timed_out =
             !waiter.sem.try_acquire_for(std::chrono::milliseconds(wait_ms));
@@ -90,7 +92,7 @@ int avs_condvar_wait(avs_condvar_t *condvar,
     bool timed_out = (waiter.sem.wait(wait_ms) <= 0);
 #endif // MBED_MAJOR_VERSION > 5 || (MBED_MAJOR_VERSION == 5 &&
        // MBED_MINOR_VERSION >= 13)
-    mutex->mbed_mtx.lock();
+    avs_mutex_lock(mutex);
     {
         ScopedLock<Mutex> lock(condvar->waiters_mtx);
         avs_condvar::Waiter **waiter_node_ptr = &condvar->first_waiter;
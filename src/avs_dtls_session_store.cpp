@@ -0,0 +1,281 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
+#ifdef ANJAY_MBEDOS_WITH_DTLS_SESSION_STORE
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <kvstore_global_api.h>
+#include <mbed_error.h>
+
+#include <avsystem/commons/avs_log.h>
+#include <avsystem/commons/avs_memory.h>
+#include <avsystem/commons/avs_time.h>
+
+#include "avs_dtls_session_store.h"
+#include "avs_mbed_hacks.h"
+
+namespace {
+
+// "ADSS" when stored in little endian
+const uint32_t RECORD_MAGIC = 0x53534441;
+const uint16_t RECORD_VERSION = 1;
+
+struct RecordHeader {
+    int64_t saved_at_s;
+    uint32_t magic;
+    uint32_t session_size;
+    uint16_t version;
+    uint16_t peer_size;
+};
+// followed by peer name (without terminating nullbyte) and session data
+
+const char KEY_PREFIX[] = "anjay_dtls_";
+
+// KEY_PREFIX followed by 8 hex digits of the peer name hash
+#define KEY_NAME_SIZE (sizeof(KEY_PREFIX) + 8)
+#define FULL_KEY_SIZE \
+    (sizeof(ANJAY_MBEDOS_DTLS_SESSION_STORE_PATH) - 1 + KEY_NAME_SIZE)
+
+void make_full_key(char *out, const char *key_name) {
+    snprintf(out, FULL_KEY_SIZE, "%s%s", ANJAY_MBEDOS_DTLS_SESSION_STORE_PATH,
+             key_name);
+}
+
+void make_peer_key(char *out, const char *peer) {
+    // FNV-1a; collisions are harmless, as the full peer name is stored in
+    // the record and verified when loading it
+    uint32_t hash = 2166136261u;
+    for (const char *c = peer; *c; ++c) {
+        hash = (hash ^ (uint8_t) *c) * 16777619u;
+    }
+    char key_name[KEY_NAME_SIZE];
+    snprintf(key_name, sizeof(key_name), "%s%08" PRIx32, KEY_PREFIX, hash);
+    make_full_key(out, key_name);
+}
+
+int64_t now_s() {
+    int64_t result = 0;
+    avs_time_real_to_scalar(&result, AVS_TIME_S, avs_time_real_now());
+    return result;
+}
+
+bool record_expired(const RecordHeader &header, int64_t now) {
+    return header.saved_at_s > now
+           || now - header.saved_at_s
+                      > (int64_t) ANJAY_MBEDOS_DTLS_SESSION_STORE_MAX_AGE_S;
+}
+
+int read_header(const char *full_key, RecordHeader *out) {
+    size_t actual_size = 0;
+    if (kv_get(full_key, out, sizeof(*out), &actual_size) != MBED_SUCCESS
+        || actual_size != sizeof(*out) || out->magic != RECORD_MAGIC
+        || out->version != RECORD_VERSION) {
+        return -1;
+    }
+    return 0;
+}
+
+struct RecordSummary {
+    size_t count;
+    bool has_oldest;
+    int64_t oldest_saved_at_s;
+    char oldest_key[FULL_KEY_SIZE];
+    bool has_invalid;
+    char invalid_key[FULL_KEY_SIZE];
+};
+
+// Scans all stored records. Modifying the store while iterating over it is
+// not allowed, so this only gathers information for the caller to act upon.
+int summarize_records(RecordSummary *out) {
+    memset(out, 0, sizeof(*out));
+    char prefix[FULL_KEY_SIZE];
+    make_full_key(prefix, KEY_PREFIX);
+    kv_iterator_t it;
+    if (kv_iterator_open(&it, prefix) != MBED_SUCCESS) {
+        return -1;
+    }
+    const int64_t now = now_s();
+    char key_name[KV_MAX_KEY_LENGTH];
+    while (kv_iterator_next(it, key_name, sizeof(key_name)) == MBED_SUCCESS) {
+        char full_key[FULL_KEY_SIZE];
+        if (strlen(key_name) != KEY_NAME_SIZE - 1) {
+            continue;
+        }
+        make_full_key(full_key, key_name);
+        RecordHeader header;
+        if (read_header(full_key, &header) || record_expired(header, now)) {
+            out->has_invalid = true;
+            memcpy(out->invalid_key, full_key, sizeof(full_key));
+            continue;
+        }
+        ++out->count;
+        if (!out->has_oldest || header.saved_at_s < out->oldest_saved_at_s) {
+            out->has_oldest = true;
+            out->oldest_saved_at_s = header.saved_at_s;
+            memcpy(out->oldest_key, full_key, sizeof(full_key));
+        }
+    }
+    kv_iterator_close(it);
+    return 0;
+}
+
+} // namespace
+
+avs_error_t AvsDtlsSessionStore::save(const char *peer,
+                                      const void *session,
+                                      size_t session_size) {
+    const size_t peer_size = strlen(peer);
+    if (peer_size > UINT16_MAX) {
+        return avs_errno(AVS_EINVAL);
+    }
+    char full_key[FULL_KEY_SIZE];
+    make_peer_key(full_key, peer);
+
+    kv_info_t info;
+    if (kv_get_info(full_key, &info) != MBED_SUCCESS) {
+        // new entry - make room for it
+        RecordSummary summary;
+        while (!summarize_records(&summary)
+               && summary.count >= ANJAY_MBEDOS_DTLS_SESSION_STORE_MAX_ENTRIES
+               && summary.has_oldest) {
+            avs_log(mbed_dtls_store, DEBUG, "evicting DTLS session %s",
+                    summary.oldest_key);
+            if (kv_remove(summary.oldest_key) != MBED_SUCCESS) {
+                break;
+            }
+        }
+    }
+
+    const size_t record_size = sizeof(RecordHeader) + peer_size + session_size;
+    uint8_t *record = (uint8_t *) avs_malloc(record_size);
+    if (!record) {
+        return avs_errno(AVS_ENOMEM);
+    }
+    RecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.saved_at_s = now_s();
+    header.magic = RECORD_MAGIC;
+    header.session_size = (uint32_t) session_size;
+    header.version = RECORD_VERSION;
+    header.peer_size = (uint16_t) peer_size;
+    memcpy(record, &header, sizeof(header));
+    memcpy(record + sizeof(header), peer, peer_size);
+    memcpy(record + sizeof(header) + peer_size, session, session_size);
+
+    // the record contains the master secret of the session, so it must not
+    // end up in flash in plain text
+    int result = kv_set(full_key, record, record_size,
+                        KV_REQUIRE_CONFIDENTIALITY_FLAG
+                                | KV_REQUIRE_REPLAY_PROTECTION_FLAG);
+    if (result == MBED_ERROR_INVALID_ARGUMENT) {
+        // SecureStore without a rollback protection store
+        result = kv_set(full_key, record, record_size,
+                        KV_REQUIRE_CONFIDENTIALITY_FLAG);
+    }
+    avs_free(record);
+    if (result == MBED_ERROR_INVALID_ARGUMENT) {
+        avs_log(mbed_dtls_store, ERROR,
+                "could not store DTLS session for %s: the default KVStore "
+                "does not support confidentiality (SecureStore is required)",
+                peer);
+        return avs_errno(AVS_ENOTSUP);
+    } else if (result != MBED_SUCCESS) {
+        avs_log(mbed_dtls_store, WARNING,
+                "could not store DTLS session for %s: %d", peer, result);
+        return avs_errno(AVS_EIO);
+    }
+    return AVS_OK;
+}
+
+avs_error_t
+AvsDtlsSessionStore::load(const char *peer, void *buffer, size_t buffer_size) {
+    memset(buffer, 0, buffer_size);
+    const size_t peer_size = strlen(peer);
+    char full_key[FULL_KEY_SIZE];
+    make_peer_key(full_key, peer);
+
+    kv_info_t info;
+    if (kv_get_info(full_key, &info) != MBED_SUCCESS) {
+        return avs_errno(AVS_ENOENT);
+    }
+    if (info.size < sizeof(RecordHeader) + peer_size
+        || info.size > sizeof(RecordHeader) + peer_size + buffer_size) {
+        // either corrupted, stored for another peer or does not fit; in any
+        // case, we cannot use it
+        return avs_errno(AVS_ENOENT);
+    }
+    uint8_t *record = (uint8_t *) avs_malloc(info.size);
+    if (!record) {
+        return avs_errno(AVS_ENOMEM);
+    }
+    avs_error_t err = avs_errno(AVS_ENOENT);
+    size_t actual_size = 0;
+    RecordHeader header;
+    if (kv_get(full_key, record, info.size, &actual_size) == MBED_SUCCESS
+        && actual_size == info.size) {
+        memcpy(&header, record, sizeof(header));
+        if (header.magic == RECORD_MAGIC && header.version == RECORD_VERSION
+            && header.peer_size == peer_size
+            && header.session_size == info.size - sizeof(header) - peer_size
+            && !memcmp(record + sizeof(header), peer, peer_size)) {
+            if (record_expired(header, now_s())) {
+                avs_log(mbed_dtls_store, DEBUG, "DTLS session for %s expired",
+                        peer);
+                kv_remove(full_key);
+            } else {
+                memcpy(buffer, record + sizeof(header) + peer_size,
+                       header.session_size);
+                err = AVS_OK;
+            }
+        }
+    }
+    avs_free(record);
+    return err;
+}
+
+avs_error_t AvsDtlsSessionStore::remove(const char *peer) {
+    char full_key[FULL_KEY_SIZE];
+    make_peer_key(full_key, peer);
+    int result = kv_remove(full_key);
+    if (result == MBED_ERROR_ITEM_NOT_FOUND) {
+        return avs_errno(AVS_ENOENT);
+    } else if (result != MBED_SUCCESS) {
+        return avs_errno(AVS_EIO);
+    }
+    return AVS_OK;
+}
+
+size_t AvsDtlsSessionStore::evict_expired() {
+    size_t result = 0;
+    RecordSummary summary;
+    while (!summarize_records(&summary) && summary.has_invalid) {
+        avs_log(mbed_dtls_store, DEBUG, "evicting DTLS session %s",
+                summary.invalid_key);
+        if (kv_remove(summary.invalid_key) != MBED_SUCCESS) {
+            break;
+        }
+        ++result;
+    }
+    return result;
+}
+
+#endif // ANJAY_MBEDOS_WITH_DTLS_SESSION_STORE
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef AVS_DTLS_SESSION_STORE_H
+#define AVS_DTLS_SESSION_STORE_H
+
+#include <stddef.h>
+
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
+#include <avsystem/commons/avs_errno.h>
+
+#ifdef ANJAY_MBEDOS_WITH_DTLS_SESSION_STORE
+
+/**
+ * Persistent cache of DTLS sessions, stored in the Mbed OS global KVStore.
+ *
+ * The data stored is the contents of a session resumption buffer
+ * (<c>avs_net_ssl_configuration_t::session_resumption_buffer</c>) as filled
+ * by avs_commons after a successful handshake. Loading it back into the
+ * buffer before creating the socket after a reboot allows the client to
+ * resume the session (abbreviated handshake) instead of negotiating a new one.
+ *
+ * NOTE: This class is only a building block. Nothing in this library calls
+ * save() or load(), and Anjay does not expose the session resumption buffers
+ * of its server connections, so sessions are NOT resumed across reboots
+ * automatically. The application has to call these methods around its own
+ * use of avs_net DTLS sockets.
+ *
+ * The stored data includes the session's master secret, which is enough to
+ * decrypt and forge traffic of the session. Records are therefore stored with
+ * <c>KV_REQUIRE_CONFIDENTIALITY_FLAG</c> and, if the KVStore supports it,
+ * <c>KV_REQUIRE_REPLAY_PROTECTION_FLAG</c>. This requires the default KVStore
+ * to be a SecureStore (e.g. <c>"storage.storage_type": "TDB_EXTERNAL"</c> or
+ * <c>"FILESYSTEM"</c>); with a plain TDBStore, save() fails with
+ * <c>AVS_ENOTSUP</c>.
+ *
+ * Sessions are identified by an arbitrary peer name, e.g. "host:port". Each
+ * of them is stored under a separate key with a common prefix (see
+ * <c>ANJAY_MBEDOS_DTLS_SESSION_STORE_PATH</c>). At most
+ * <c>ANJAY_MBEDOS_DTLS_SESSION_STORE_MAX_ENTRIES</c> sessions are kept - the
+ * oldest one is evicted when saving a new one. Sessions older than
+ * <c>ANJAY_MBEDOS_DTLS_SESSION_STORE_MAX_AGE_S</c> are never loaded.
+ *
+ * NOTE: Ages are calculated using the real-time clock, so it needs to be set
+ * (e.g. using <c>set_time()</c>) before calling any of the methods. Records
+ * with timestamps from the future are treated as expired.
+ *
+ * All methods are thread safe, as long as the KVStore API is.
+ */
+class AvsDtlsSessionStore {
+public:
+    /**
+     * Stores the session, replacing the previous one for the same @p peer.
+     *
+     * @returns AVS_OK for success, <c>AVS_ENOTSUP</c> if the default KVStore
+     *          cannot store data confidentially, or another error if the
+     *          session could not be stored.
+     */
+    static avs_error_t
+    save(const char *peer, const void *session, size_t session_size);
+
+    /**
+     * Loads the session stored for @p peer into @p buffer. The remainder of
+     * the buffer is zeroed. If no valid session is stored, an error is
+     * returned and the buffer is zeroed entirely, which means "no session" to
+     * avs_commons.
+     */
+    static avs_error_t load(const char *peer, void *buffer, size_t buffer_size);
+
+    /**
+     * Removes the session stored for @p peer, e.g. after the server rejected
+     * it.
+     */
+    static avs_error_t remove(const char *peer);
+
+    /**
+     * Removes all expired sessions. Intended to be called once at startup.
+     *
+     * @returns Number of sessions removed.
+     */
+    static size_t evict_expired();
+};
+
+#endif // ANJAY_MBEDOS_WITH_DTLS_SESSION_STORE
+
+#endif /* AVS_DTLS_SESSION_STORE_H */
@@ -0,0 +1,451 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
+#ifdef ANJAY_MBEDOS_WITH_FW_UPDATE_BLOCK_DEVICE
+
+#include <string.h>
+
+#include <mbed.h>
+
+#include <mbedtls/version.h>
+
+#include <avsystem/commons/avs_log.h>
+
+#include "avs_fw_update_block_device.h"
+#include "avs_mbed_hacks.h"
+
+using namespace mbed;
+using namespace rtos;
+using namespace avs_mbed_hacks;
+
+namespace {
+
+const uint32_t BUFFER_SIZE = ANJAY_MBEDOS_FW_UPDATE_BUFFER_SIZE;
+
+// the same flag is used in both directions, each on its own EventFlags
+const uint32_t WAKEUP_FLAG = 1;
+
+// "AFR" and a version number; bump when changing the state layout
+const uint32_t RESUME_STATE_FORMAT = 0x52464101;
+
+const size_t DIGEST_SIZE = 32;
+
+int hash_start(mbedtls_sha256_context *ctx) {
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+    return mbedtls_sha256_starts(ctx, 0);
+#elif MBEDTLS_VERSION_NUMBER >= 0x02070000
+    return mbedtls_sha256_starts_ret(ctx, 0);
+#else  // MBEDTLS_VERSION_NUMBER
+    mbedtls_sha256_starts(ctx, 0);
+    return 0;
+#endif // MBEDTLS_VERSION_NUMBER
+}
+
+int hash_update(mbedtls_sha256_context *ctx, const uint8_t *data, size_t size) {
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+    return mbedtls_sha256_update(ctx, data, size);
+#elif MBEDTLS_VERSION_NUMBER >= 0x02070000
+    return mbedtls_sha256_update_ret(ctx, data, size);
+#else  // MBEDTLS_VERSION_NUMBER
+    mbedtls_sha256_update(ctx, data, size);
+    return 0;
+#endif // MBEDTLS_VERSION_NUMBER
+}
+
+int hash_finish(mbedtls_sha256_context *ctx, uint8_t *digest) {
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+    return mbedtls_sha256_finish(ctx, digest);
+#elif MBEDTLS_VERSION_NUMBER >= 0x02070000
+    return mbedtls_sha256_finish_ret(ctx, digest);
+#else  // MBEDTLS_VERSION_NUMBER
+    mbedtls_sha256_finish(ctx, digest);
+    return 0;
+#endif // MBEDTLS_VERSION_NUMBER
+}
+
+} // namespace
+
+AvsFwUpdateBlockDevice::AvsFwUpdateBlockDevice(BlockDevice *device,
+                                               bd_addr_t slot_address,
+                                               bd_size_t slot_size,
+                                               osPriority priority,
+                                               uint32_t stack_size)
+        : device_(device),
+          slot_address_(slot_address),
+          slot_size_((uint32_t) slot_size),
+          open_(false),
+          filling_(0),
+          fill_length_(0),
+          write_offset_(0),
+          image_size_(0),
+          image_done_(false),
+          digest_expected_(false),
+          restart_(0),
+          stopping_(0),
+          erase_limit_(0),
+          error_(0),
+          programming_(0),
+          erased_until_(0),
+          resume_mutex_(),
+          work_(),
+          done_(),
+          thread_(priority, stack_size) {
+    for (size_t i = 0; i < 2; ++i) {
+        buffers_[i].offset = 0;
+        buffers_[i].length = 0;
+        buffers_[i].image_length = 0;
+        buffers_[i].queued = 0;
+    }
+    mbedtls_sha256_init(&hash_);
+    memset(&resume_state_, 0, sizeof(resume_state_));
+    thread_.start(callback(this, &AvsFwUpdateBlockDevice::run));
+}
+
+AvsFwUpdateBlockDevice::~AvsFwUpdateBlockDevice() {
+    atomic_store_u32(&stopping_, 1);
+    work_.set(WAKEUP_FLAG);
+    thread_.join();
+    mbedtls_sha256_free(&hash_);
+}
+
+void AvsFwUpdateBlockDevice::init_handlers(
+        anjay_fw_update_handlers_t *handlers) {
+    handlers->stream_open = stream_open;
+    handlers->stream_write = stream_write;
+    handlers->stream_finish = stream_finish;
+    handlers->reset = stream_reset;
+}
+
+bool AvsFwUpdateBlockDevice::layout_valid() const {
+    if (BUFFER_SIZE % device_->get_program_size()
+        || !device_->is_valid_erase(slot_address_, slot_size_)) {
+        avs_log(mbed_fw, ERROR,
+                "firmware slot or buffer size not aligned to the device");
+        return false;
+    }
+    return true;
+}
+
+void AvsFwUpdateBlockDevice::start(uint32_t offset,
+                                   const mbedtls_sha256_context *hash) {
+    // the worker might be erasing ahead for the previous image; wait until
+    // it has left its loop and acknowledged the restart, so that no stale
+    // error is left behind and nothing below races with it
+    atomic_store_u32(&restart_, 1);
+    work_.set(WAKEUP_FLAG);
+    while (atomic_load_u32(&restart_)) {
+        done_.wait_any(WAKEUP_FLAG);
+    }
+    // the worker is now idle until it is signalled again
+    filling_ = 0;
+    fill_length_ = 0;
+    write_offset_ = offset;
+    erased_until_ = offset;
+    if (hash) {
+        mbedtls_sha256_clone(&hash_, hash);
+    } else if (hash_start(&hash_)) {
+        atomic_store_u32(&error_, (uint32_t) -1);
+    }
+    uint32_t erase_limit = offset + BUFFER_SIZE;
+    atomic_store_u32(&erase_limit_,
+                     erase_limit < slot_size_ ? erase_limit : slot_size_);
+    work_.set(WAKEUP_FLAG);
+    open_ = true;
+}
+
+int AvsFwUpdateBlockDevice::open() {
+    reset();
+    if (!layout_valid()) {
+        return -1;
+    }
+    start(0, nullptr);
+    return 0;
+}
+
+int AvsFwUpdateBlockDevice::resume(const AvsFwUpdateResumeState *state) {
+    reset();
+#ifdef MBEDTLS_SHA256_ALT
+    (void) state;
+    avs_log(mbed_fw, ERROR, "resuming not supported with MBEDTLS_SHA256_ALT");
+    return -1;
+#else  // MBEDTLS_SHA256_ALT
+    if (!layout_valid()) {
+        return -1;
+    }
+    bd_addr_t address = slot_address_ + state->offset;
+    if (state->format != RESUME_STATE_FORMAT
+        || state->slot_address != slot_address_ || !state->offset
+        || state->offset > slot_size_
+        || address % device_->get_erase_size(address)) {
+        avs_log(mbed_fw, ERROR, "invalid firmware resume state");
+        return -1;
+    }
+    {
+        ScopedLock<Mutex> lock(resume_mutex_);
+        resume_state_ = *state;
+    }
+    start(state->offset, &state->hash);
+    return 0;
+#endif // MBEDTLS_SHA256_ALT
+}
+
+int AvsFwUpdateBlockDevice::get_resume_state(AvsFwUpdateResumeState *out) {
+#ifdef MBEDTLS_SHA256_ALT
+    (void) out;
+    return -1;
+#else  // MBEDTLS_SHA256_ALT
+    ScopedLock<Mutex> lock(resume_mutex_);
+    if (!open_ || !resume_state_.offset) {
+        return -1;
+    }
+    *out = resume_state_;
+    return 0;
+#endif // MBEDTLS_SHA256_ALT
+}
+
+void AvsFwUpdateBlockDevice::set_expected_digest(const uint8_t *digest) {
+    digest_expected_ = (digest != nullptr);
+    if (digest) {
+        memcpy(expected_digest_, digest, DIGEST_SIZE);
+    }
+}
+
+int AvsFwUpdateBlockDevice::write(const void *data, size_t length) {
+    if (!open_) {
+        return -1;
+    }
+    const uint8_t *bytes = (const uint8_t *) data;
+    while (length) {
+        if (error()) {
+            return -1;
+        }
+        Buffer *buffer = &buffers_[filling_];
+        if (!fill_length_) {
+            wait_until_programmed(buffer);
+            buffer->offset = write_offset_;
+        }
+        size_t chunk = BUFFER_SIZE - fill_length_;
+        if (chunk > length) {
+            chunk = length;
+        }
+        if (chunk > slot_size_ - write_offset_) {
+            avs_log(mbed_fw, ERROR, "firmware image too large");
+            return ANJAY_FW_UPDATE_ERR_NOT_ENOUGH_SPACE;
+        }
+        memcpy(buffer->data + fill_length_, bytes, chunk);
+        fill_length_ += chunk;
+        write_offset_ += (uint32_t) chunk;
+        bytes += chunk;
+        length -= chunk;
+        if (fill_length_ == BUFFER_SIZE) {
+            buffer->image_length = BUFFER_SIZE;
+            submit(true);
+        }
+    }
+    return error() ? -1 : 0;
+}
+
+int AvsFwUpdateBlockDevice::finish() {
+    if (!open_) {
+        return -1;
+    }
+    if (fill_length_) {
+        size_t program_size = (size_t) device_->get_program_size();
+        size_t padded = (fill_length_ + program_size - 1) / program_size
+                        * program_size;
+        int erase_value = device_->get_erase_value();
+        memset(buffers_[filling_].data + fill_length_,
+               erase_value < 0 ? 0xFF : erase_value, padded - fill_length_);
+        buffers_[filling_].image_length = fill_length_;
+        fill_length_ = padded;
+        submit(false);
+    }
+    wait_until_idle();
+    open_ = false;
+    int result = error();
+    if (!result) {
+        result = device_->sync();
+    }
+    if (!result) {
+        result = hash_finish(&hash_, image_digest_);
+    }
+    if (result) {
+        avs_log(mbed_fw, ERROR, "could not write firmware image: %d", result);
+        return -1;
+    }
+    if (digest_expected_
+        && memcmp(image_digest_, expected_digest_, DIGEST_SIZE)) {
+        avs_log(mbed_fw, ERROR, "firmware image digest mismatch");
+        return ANJAY_FW_UPDATE_ERR_INTEGRITY_FAILURE;
+    }
+    image_size_ = write_offset_;
+    image_done_ = true;
+    return 0;
+}
+
+void AvsFwUpdateBlockDevice::reset() {
+    open_ = false;
+    fill_length_ = 0;
+    image_size_ = 0;
+    image_done_ = false;
+    wait_until_idle();
+    ScopedLock<Mutex> lock(resume_mutex_);
+    resume_state_.offset = 0;
+}
+
+void AvsFwUpdateBlockDevice::submit(bool erase_ahead) {
+    Buffer *buffer = &buffers_[filling_];
+    buffer->length = fill_length_;
+    if (erase_ahead) {
+        // sectors of the next buffer
+        uint32_t next_end = buffer->offset + (uint32_t) buffer->length
+                            + BUFFER_SIZE;
+        atomic_store_u32(&erase_limit_,
+                         next_end < slot_size_ ? next_end : slot_size_);
+    }
+    atomic_store_u32(&buffer->queued, 1);
+    work_.set(WAKEUP_FLAG);
+    filling_ ^= 1;
+    fill_length_ = 0;
+}
+
+void AvsFwUpdateBlockDevice::wait_until_programmed(Buffer *buffer) {
+    while (atomic_load_u32(&buffer->queued)) {
+        done_.wait_any(WAKEUP_FLAG);
+    }
+}
+
+void AvsFwUpdateBlockDevice::wait_until_idle() {
+    wait_until_programmed(&buffers_[0]);
+    wait_until_programmed(&buffers_[1]);
+}
+
+int AvsFwUpdateBlockDevice::error() const {
+    return (int) atomic_load_u32(&error_);
+}
+
+void AvsFwUpdateBlockDevice::run() {
+    while (true) {
+        work_.wait_any(WAKEUP_FLAG);
+        while (!atomic_load_u32(&stopping_) && !atomic_load_u32(&restart_)) {
+            Buffer *buffer = &buffers_[programming_];
+            if (atomic_load_u32(&buffer->queued)) {
+                // buffers are still released after an error, so that the
+                // Anjay thread does not wait forever
+                int result = error();
+                if (!result) {
+                    result = program(buffer);
+                    atomic_store_u32(&error_, (uint32_t) result);
+                }
+                if (!result) {
+                    save_resume_point(buffer->offset
+                                      + (uint32_t) buffer->length);
+                }
+                atomic_store_u32(&buffer->queued, 0);
+                programming_ ^= 1;
+                done_.set(WAKEUP_FLAG);
+            } else if (!error()
+                       && erased_until_ < atomic_load_u32(&erase_limit_)) {
+                atomic_store_u32(&error_, (uint32_t) erase_next());
+            } else {
+                break;
+            }
+        }
+        if (atomic_load_u32(&stopping_)) {
+            return;
+        }
+        if (atomic_load_u32(&restart_)) {
+            // start() does not signal again until the restart is acknowledged,
+            // so any wakeup still pending is stale; dropping it keeps the
+            // worker idle while start() sets up the next image
+            work_.clear(WAKEUP_FLAG);
+            programming_ = 0;
+            atomic_store_u32(&erase_limit_, 0);
+            atomic_store_u32(&error_, 0);
+            atomic_store_u32(&restart_, 0);
+            done_.set(WAKEUP_FLAG);
+        }
+    }
+}
+
+int AvsFwUpdateBlockDevice::erase_next() {
+    bd_addr_t address = slot_address_ + erased_until_;
+    bd_size_t size = device_->get_erase_size(address);
+    int result = device_->erase(address, size);
+    if (!result) {
+        erased_until_ += (uint32_t) size;
+    }
+    return result;
+}
+
+int AvsFwUpdateBlockDevice::program(const Buffer *buffer) {
+    int result = hash_update(&hash_, buffer->data, buffer->image_length);
+    while (!result && erased_until_ < buffer->offset + buffer->length) {
+        result = erase_next();
+    }
+    if (!result) {
+        result = device_->program(buffer->data, slot_address_ + buffer->offset,
+                                  buffer->length);
+    }
+    return result;
+}
+
+void AvsFwUpdateBlockDevice::save_resume_point(uint32_t offset) {
+#ifndef MBEDTLS_SHA256_ALT
+    // Resuming in the middle of an erase unit would require programming the
+    // rest of it, which might already have been partially programmed before
+    // the interruption, so only the ends of erase units are saved. The end of
+    // the image itself does not matter, as there is nothing left to resume.
+    bd_addr_t address = slot_address_ + offset;
+    if (offset < slot_size_ && address % device_->get_erase_size(address)) {
+        return;
+    }
+    ScopedLock<Mutex> lock(resume_mutex_);
+    resume_state_.format = RESUME_STATE_FORMAT;
+    resume_state_.offset = offset;
+    resume_state_.slot_address = slot_address_;
+    mbedtls_sha256_clone(&resume_state_.hash, &hash_);
+#else  // MBEDTLS_SHA256_ALT
+    (void) offset;
+#endif // MBEDTLS_SHA256_ALT
+}
+
+int AvsFwUpdateBlockDevice::stream_open(void *writer,
+                                        const char *package_uri,
+                                        const struct anjay_etag *package_etag) {
+    (void) package_uri;
+    (void) package_etag;
+    return ((AvsFwUpdateBlockDevice *) writer)->open();
+}
+
+int AvsFwUpdateBlockDevice::stream_write(void *writer,
+                                         const void *data,
+                                         size_t length) {
+    return ((AvsFwUpdateBlockDevice *) writer)->write(data, length);
+}
+
+int AvsFwUpdateBlockDevice::stream_finish(void *writer) {
+    return ((AvsFwUpdateBlockDevice *) writer)->finish();
+}
+
+void AvsFwUpdateBlockDevice::stream_reset(void *writer) {
+    ((AvsFwUpdateBlockDevice *) writer)->reset();
+}
+
+#endif // ANJAY_MBEDOS_WITH_FW_UPDATE_BLOCK_DEVICE
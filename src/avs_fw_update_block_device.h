@@ -0,0 +1,269 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef AVS_FW_UPDATE_BLOCK_DEVICE_H
+#define AVS_FW_UPDATE_BLOCK_DEVICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
+#ifdef ANJAY_MBEDOS_WITH_FW_UPDATE_BLOCK_DEVICE
+
+#include <BlockDevice.h>
+#include <EventFlags.h>
+#include <Mutex.h>
+#include <Thread.h>
+
+#include <mbedtls/sha256.h>
+
+#include <anjay/fw_update.h>
+
+#ifndef ANJAY_WITH_MODULE_FW_UPDATE
+#error "AvsFwUpdateBlockDevice requires ANJAY_WITH_MODULE_FW_UPDATE"
+#endif // ANJAY_WITH_MODULE_FW_UPDATE
+
+/**
+ * State of an interrupted download, see
+ * AvsFwUpdateBlockDevice::get_resume_state(). It is meant to be stored as an
+ * opaque blob of sizeof(AvsFwUpdateResumeState) bytes, e.g. in KVStore, and is
+ * only valid for the same firmware build that saved it.
+ */
+struct AvsFwUpdateResumeState {
+    uint32_t format;
+    // number of image bytes already in the slot
+    uint32_t offset;
+    bd_addr_t slot_address;
+    mbedtls_sha256_context hash;
+};
+
+/**
+ * Firmware Update object backend that streams the downloaded image into a
+ * slot of a BlockDevice, e.g. the secondary slot of a bootloader.
+ *
+ * Incoming data is collected in one of two buffers of
+ * ANJAY_MBEDOS_FW_UPDATE_BUFFER_SIZE bytes each. A full buffer is handed over
+ * to a worker thread, which programs it while the Anjay thread keeps
+ * receiving into the other one, so the Anjay thread only waits for the device
+ * if it delivers data faster than the device can take it. The worker erases
+ * each sector before programming it and, when idle, erases the sectors that
+ * the next buffer will be written to, so that erasing overlaps with network
+ * reception as well.
+ *
+ * The worker also computes the SHA-256 digest of the image as each buffer is
+ * programmed, so the digest is available as soon as finish() returns, without
+ * reading the image back. The hash state, together with the write position,
+ * can be saved and used to resume the download after a reboot.
+ *
+ * The slot MUST be aligned to erase units of the device on both ends. The
+ * device MUST be initialized by the application. Images are padded with the
+ * erase value of the device (or 0xFF) up to its program size.
+ *
+ * Only the stream handlers are provided; applying the image depends on the
+ * bootloader, so the application supplies perform_upgrade() and the other
+ * handlers it needs, and passes the writer as the user pointer:
+ *
+ * @code
+ * static AvsFwUpdateBlockDevice fw_writer(&block_device, 0, SLOT_SIZE);
+ *
+ * anjay_fw_update_handlers_t handlers;
+ * memset(&handlers, 0, sizeof(handlers));
+ * AvsFwUpdateBlockDevice::init_handlers(&handlers);
+ * handlers.perform_upgrade = perform_upgrade;
+ * anjay_fw_update_install(anjay, &handlers, &fw_writer, NULL);
+ * @endcode
+ *
+ * All methods except the constructor and destructor MUST be called from a
+ * single thread, typically the one that runs Anjay. Both buffers are members
+ * of the object, so it is best placed in static storage.
+ */
+class AvsFwUpdateBlockDevice {
+public:
+    AvsFwUpdateBlockDevice(BlockDevice *device,
+                           bd_addr_t slot_address,
+                           bd_size_t slot_size,
+                           osPriority priority = osPriorityNormal,
+                           uint32_t stack_size = 2048);
+    ~AvsFwUpdateBlockDevice();
+
+    /**
+     * Fills the stream_open, stream_write, stream_finish and reset handlers.
+     * The user pointer passed to anjay_fw_update_install() MUST point to an
+     * AvsFwUpdateBlockDevice object.
+     */
+    static void init_handlers(anjay_fw_update_handlers_t *handlers);
+
+    /**
+     * Starts writing a new image at the beginning of the slot. A previous,
+     * unfinished image is discarded.
+     *
+     * @returns 0 on success, or -1 if the slot or buffer size are not
+     *          compatible with the device.
+     */
+    int open();
+
+    /**
+     * Continues writing an image interrupted e.g. by a reboot, from @p state
+     * saved with get_resume_state(). The download needs to be resumed from
+     * <c>state->offset</c> as well, e.g. by passing it as
+     * <c>anjay_fw_update_initial_state_t::resume_offset</c>; the package ETag
+     * is not a part of the state and needs to be stored separately.
+     *
+     * @returns 0 on success, or -1 if the state is not valid for this slot,
+     *          or resuming is not supported, because Mbed TLS is configured
+     *          with MBEDTLS_SHA256_ALT.
+     */
+    int resume(const AvsFwUpdateResumeState *state);
+
+    /**
+     * Gets the state of the current image at the last point from which it can
+     * be resumed, i.e. the end of the last completely written erase unit of
+     * the slot. It is cheap enough to be called after each write(); the state
+     * only needs to be stored again if its offset has changed.
+     *
+     * @returns 0 on success, or -1 if there is no such point yet, no image is
+     *          being written, or resuming is not supported.
+     */
+    int get_resume_state(AvsFwUpdateResumeState *out);
+
+    /**
+     * Sets the SHA-256 digest that images are expected to have; finish() fails
+     * with ANJAY_FW_UPDATE_ERR_INTEGRITY_FAILURE on a mismatch. NULL disables
+     * the check. The digest is copied.
+     */
+    void set_expected_digest(const uint8_t *digest);
+
+    /**
+     * Appends data to the image. Blocks only if both buffers are waiting to be
+     * programmed.
+     *
+     * @returns 0 on success, ANJAY_FW_UPDATE_ERR_NOT_ENOUGH_SPACE if the image
+     *          does not fit in the slot, or -1 if the image is not open or
+     *          the device reported an error.
+     */
+    int write(const void *data, size_t length);
+
+    /**
+     * Programs the remaining data and waits until the whole image is written.
+     *
+     * @returns 0 on success, ANJAY_FW_UPDATE_ERR_INTEGRITY_FAILURE if an
+     *          expected digest is set and the image does not match it, or -1
+     *          if the image is not open or the device reported an error.
+     */
+    int finish();
+
+    /**
+     * Discards the current image, after waiting for the device operation in
+     * progress, if any. The slot contents are left as they are.
+     */
+    void reset();
+
+    /**
+     * Returns the size of the last image completed with finish(), without
+     * padding, or 0 if there is none.
+     */
+    size_t image_size() const {
+        return image_size_;
+    }
+
+    /**
+     * Returns the SHA-256 digest (32 bytes) of the last image completed with
+     * finish(), or NULL if there is none.
+     */
+    const uint8_t *image_digest() const {
+        return image_done_ ? image_digest_ : NULL;
+    }
+
+private:
+    struct Buffer {
+        // offset of data[0] from the beginning of the slot
+        uint32_t offset;
+        // number of bytes to program and number of image bytes to hash, which
+        // differ in the last buffer because of padding; set when queued
+        size_t length;
+        size_t image_length;
+        // set by the Anjay thread, cleared by the worker when programmed;
+        // accessed atomically, as it hands the buffer over between threads
+        volatile uint32_t queued;
+        uint8_t data[ANJAY_MBEDOS_FW_UPDATE_BUFFER_SIZE];
+    };
+
+    BlockDevice *const device_;
+    const bd_addr_t slot_address_;
+    const uint32_t slot_size_;
+
+    // state of the Anjay thread
+    bool open_;
+    // buffer currently being filled and the number of bytes in it
+    size_t filling_;
+    size_t fill_length_;
+    uint32_t write_offset_;
+    size_t image_size_;
+    bool image_done_;
+    uint8_t image_digest_[32];
+    bool digest_expected_;
+    uint8_t expected_digest_[32];
+
+    Buffer buffers_[2];
+
+    // state shared with the worker, accessed atomically; error_ holds an int
+    volatile uint32_t restart_;
+    volatile uint32_t stopping_;
+    volatile uint32_t erase_limit_;
+    volatile uint32_t error_;
+
+    // state of the worker; erased_until_ and hash_ are also set by the Anjay
+    // thread after the worker has acknowledged a restart, see start()
+    size_t programming_;
+    uint32_t erased_until_;
+    mbedtls_sha256_context hash_;
+
+    // written by the worker, read by get_resume_state()
+    rtos::Mutex resume_mutex_;
+    AvsFwUpdateResumeState resume_state_;
+
+    rtos::EventFlags work_;
+    rtos::EventFlags done_;
+    rtos::Thread thread_;
+
+    AvsFwUpdateBlockDevice(const AvsFwUpdateBlockDevice &);
+    AvsFwUpdateBlockDevice &operator=(const AvsFwUpdateBlockDevice &);
+
+    bool layout_valid() const;
+    void start(uint32_t offset, const mbedtls_sha256_context *hash);
+    void submit(bool erase_ahead);
+    void wait_until_programmed(Buffer *buffer);
+    void wait_until_idle();
+    int error() const;
+
+    void run();
+    int erase_next();
+    int program(const Buffer *buffer);
+    void save_resume_point(uint32_t offset);
+
+    static int stream_open(void *writer,
+                           const char *package_uri,
+                           const struct anjay_etag *package_etag);
+    static int stream_write(void *writer, const void *data, size_t length);
+    static int stream_finish(void *writer);
+    static void stream_reset(void *writer);
+};
+
+#endif // ANJAY_MBEDOS_WITH_FW_UPDATE_BLOCK_DEVICE
+
+#endif /* AVS_FW_UPDATE_BLOCK_DEVICE_H */
@@ -0,0 +1,162 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <mbed_assert.h>
+#include <mbed_critical.h>
+
+#include "avs_log_sink.h"
+#include "avs_mbed_hacks.h"
+
+#if !PREREQ_MBED_OS(5, 6, 0)
+#error "AvsAsyncLogSink requires EventFlags, available since mbed OS 5.6"
+#endif // !PREREQ_MBED_OS(5, 6, 0)
+
+using namespace avs_mbed_hacks;
+using namespace rtos;
+
+namespace {
+
+MBED_STATIC_ASSERT((ANJAY_MBEDOS_LOG_SINK_SLOTS
+                    & (ANJAY_MBEDOS_LOG_SINK_SLOTS - 1))
+                           == 0,
+                   "ANJAY_MBEDOS_LOG_SINK_SLOTS must be a power of two");
+
+const uint32_t SLOT_MASK = ANJAY_MBEDOS_LOG_SINK_SLOTS - 1;
+
+const uint32_t FLAG_WAKEUP = 1;
+
+void default_output(const char *line) {
+    printf("%s\r\n", line);
+}
+
+} // namespace
+
+AvsAsyncLogSink *AvsAsyncLogSink::INSTANCE = nullptr;
+
+AvsAsyncLogSink::AvsAsyncLogSink(OutputFunc *output,
+                                 osPriority priority,
+                                 uint32_t stack_size)
+        : output_(output ? output : default_output),
+          enqueue_pos_(0),
+          dequeue_pos_(0),
+          dropped_(0),
+          dropped_reported_(0),
+          stopping_(false),
+          wakeup_(),
+          thread_(priority, stack_size) {
+    MBED_ASSERT(!INSTANCE);
+    for (uint32_t i = 0; i < ANJAY_MBEDOS_LOG_SINK_SLOTS; ++i) {
+        slots_[i].sequence = i;
+    }
+    INSTANCE = this;
+    thread_.start(mbed::callback(this, &AvsAsyncLogSink::drain_thread));
+}
+
+AvsAsyncLogSink::~AvsAsyncLogSink() {
+    stopping_ = true;
+    wake_up();
+    thread_.join();
+    INSTANCE = nullptr;
+}
+
+void AvsAsyncLogSink::handler(avs_log_level_t level,
+                              const char *module,
+                              const char *message) {
+    (void) level;
+    (void) module;
+    MBED_ASSERT(INSTANCE);
+    INSTANCE->push(message);
+}
+
+uint32_t AvsAsyncLogSink::dropped_messages() {
+    MBED_ASSERT(INSTANCE);
+    return atomic_load_u32(&INSTANCE->dropped_);
+}
+
+void AvsAsyncLogSink::wake_up() {
+    wakeup_.set(FLAG_WAKEUP);
+}
+
+// This is a multi-producer variant of the bounded queue described by Dmitry
+// Vyukov. Each slot has a sequence number that tells whether it is free for
+// the producer that claimed position pos (sequence == pos), or filled and ready
+// for the consumer (sequence == pos + 1). Producers claim positions with CAS,
+// so none of them ever waits for another one.
+void AvsAsyncLogSink::push(const char *message) {
+    uint32_t pos = atomic_load_u32(&enqueue_pos_);
+    Slot *slot;
+    while (true) {
+        slot = &slots_[pos & SLOT_MASK];
+        int32_t diff = (int32_t) (atomic_load_u32(&slot->sequence) - pos);
+        if (diff == 0) {
+            if (core_util_atomic_cas_u32(&enqueue_pos_, &pos, pos + 1)) {
+                break;
+            }
+            // pos has been updated by the failed CAS
+        } else if (diff < 0) {
+            // the slot has not been consumed yet - buffer is full
+            core_util_atomic_incr_u32(&dropped_, 1);
+            return;
+        } else {
+            // another producer claimed this position in the meantime
+            pos = atomic_load_u32(&enqueue_pos_);
+        }
+    }
+
+    size_t length = strlen(message);
+    if (length >= sizeof(slot->message)) {
+        length = sizeof(slot->message) - 1;
+    }
+    memcpy(slot->message, message, length);
+    slot->message[length] = '\0';
+    atomic_store_u32(&slot->sequence, pos + 1);
+    wake_up();
+}
+
+bool AvsAsyncLogSink::drain_one() {
+    Slot *slot = &slots_[dequeue_pos_ & SLOT_MASK];
+    if (atomic_load_u32(&slot->sequence) != dequeue_pos_ + 1) {
+        return false;
+    }
+    output_(slot->message);
+    atomic_store_u32(&slot->sequence,
+                     dequeue_pos_ + ANJAY_MBEDOS_LOG_SINK_SLOTS);
+    ++dequeue_pos_;
+    return true;
+}
+
+void AvsAsyncLogSink::drain_thread() {
+    while (true) {
+        wakeup_.wait_any(FLAG_WAKEUP);
+        while (drain_one())
+            ;
+
+        uint32_t dropped = atomic_load_u32(&dropped_);
+        if (dropped != dropped_reported_) {
+            char line[48];
+            snprintf(line, sizeof(line), "[%lu log messages dropped]",
+                     (unsigned long) (dropped - dropped_reported_));
+            output_(line);
+            dropped_reported_ = dropped;
+        }
+        if (stopping_) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AVS_LOG_SINK_H
+#define AVS_LOG_SINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <EventFlags.h>
+#include <Thread.h>
+
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
+#include <avsystem/commons/avs_log.h>
+
+/**
+ * Asynchronous backend for avs_log.
+ *
+ * AvsAsyncLogSink::handler() only copies the already formatted message into
+ * a lock-free ring buffer and returns immediately, so logging threads never
+ * block on the output device. The messages are written out by a separate,
+ * typically low-priority, thread. If the buffer is full, the message is
+ * dropped and a "[N log messages dropped]" line is printed once the drain
+ * thread catches up.
+ *
+ * Only one instance may exist at a time. The ring buffer is a member of the
+ * object and takes roughly ANJAY_MBEDOS_LOG_SINK_SLOTS *
+ * ANJAY_MBEDOS_LOG_SINK_LINE_LENGTH bytes, which is more than a default
+ * thread stack, so the sink MUST be placed in static storage. Usage:
+ *
+ * @code
+ * static AvsAsyncLogSink log_sink;
+ * avs_log_set_handler(AvsAsyncLogSink::handler);
+ * @endcode
+ *
+ * The handler MUST be uninstalled (or replaced) before the sink is destroyed.
+ *
+ * The ring size and maximum line length are configured with
+ * ANJAY_MBEDOS_LOG_SINK_SLOTS and ANJAY_MBEDOS_LOG_SINK_LINE_LENGTH. Longer
+ * messages are truncated.
+ *
+ * Requires mbed OS 5.6 or newer.
+ */
+class AvsAsyncLogSink {
+public:
+    typedef void OutputFunc(const char *line);
+
+    AvsAsyncLogSink(OutputFunc *output = nullptr,
+                    osPriority priority = osPriorityLow,
+                    uint32_t stack_size = 2048);
+    ~AvsAsyncLogSink();
+
+    static void
+    handler(avs_log_level_t level, const char *module, const char *message);
+
+    /**
+     * Returns the total number of messages dropped because of the ring buffer
+     * being full.
+     */
+    static uint32_t dropped_messages();
+
+private:
+    struct Slot {
+        volatile uint32_t sequence;
+        char message[ANJAY_MBEDOS_LOG_SINK_LINE_LENGTH];
+    };
+
+    static AvsAsyncLogSink *INSTANCE;
+
+    OutputFunc *output_;
+    Slot slots_[ANJAY_MBEDOS_LOG_SINK_SLOTS];
+    volatile uint32_t enqueue_pos_;
+    uint32_t dequeue_pos_;
+    volatile uint32_t dropped_;
+    uint32_t dropped_reported_;
+    volatile bool stopping_;
+    rtos::EventFlags wakeup_;
+    rtos::Thread thread_;
+
+    AvsAsyncLogSink(const AvsAsyncLogSink &);
+    AvsAsyncLogSink &operator=(const AvsAsyncLogSink &);
+
+    void push(const char *message);
+    bool drain_one();
+    void drain_thread();
+    void wake_up();
+};
+
+#endif /* AVS_LOG_SINK_H */
@@ -19,24 +19,31 @@
 #include <memory>
 
 #include <mbed_assert.h>
+#include <mbed_critical.h>
 #include <nsapi_dns.h>
 
+#ifndef TARGET_ANJAY_MBEDOS_HOST
 #include <lwip/api.h>
+#include <lwip/stats.h>
 #include <lwip/tcp.h>
 #include <lwip/udp.h>
+#endif // TARGET_ANJAY_MBEDOS_HOST
 
 #include "avs_mbed_hacks.h"
 #include "avs_socket_impl.h"
 
+#ifndef TARGET_ANJAY_MBEDOS_HOST
 #if PREREQ_MBED_OS(5, 9, 0)
 #include <LWIPStack.h>
 #else // mbed OS <= 5.8
 #include <lwip_stack.h>
 #endif
+#endif // TARGET_ANJAY_MBEDOS_HOST
 
 using namespace avs_mbed_impl;
 using namespace std;
 
+#ifndef TARGET_ANJAY_MBEDOS_HOST
 namespace {
 
 // based on
@@ -65,13 +72,15 @@ struct P_socket {
 template struct PublicCastHelper<P_socket, &InternetSocket::_socket>;
 
 } // namespace
+#endif // TARGET_ANJAY_MBEDOS_HOST
 
 // This file contains various hacks working around things that are broken on
 // mbed OS. We hope to get rid of these once we manage to push necessary changes
 // into mbed OS itself.
 namespace avs_mbed_hacks {
 
-nsapi_size_or_error_t dns_query_multiple(const char *host,
+nsapi_size_or_error_t dns_query_multiple(NetworkInterface &interface,
+                                         const char *host,
                                          SocketAddress *addr,
                                          nsapi_size_t addr_count,
                                          nsapi_version_t version) {
@@ -79,13 +88,11 @@ nsapi_size_or_error_t dns_query_multiple(const char *host,
     // mbed OS >= 5.12 has the old API as well, but it's broken, resulting in
     // infinite recursion, so we use the new API even though we don't need the
     // additional argument.
-    return nsapi_dns_query_multiple(nsapi_create_stack(
-                                            &AvsSocketGlobal::get_interface()),
-                                    host, addr, addr_count, nullptr, version);
+    return nsapi_dns_query_multiple(nsapi_create_stack(&interface), host,
+                                    addr, addr_count, nullptr, version);
 #elif PREREQ_MBED_OS(5, 7, 5)
-    return nsapi_dns_query_multiple(nsapi_create_stack(
-                                            &AvsSocketGlobal::get_interface()),
-                                    host, addr, addr_count, version);
+    return nsapi_dns_query_multiple(nsapi_create_stack(&interface), host,
+                                    addr, addr_count, version);
 #else
     // In mbed OS < 5.7.5, all the overloads of nsapi_dns_query_multiple() are
     // broken, except for the one that operates on C-based types (nsapi_stack_t
@@ -95,8 +102,7 @@ nsapi_size_or_error_t dns_query_multiple(const char *host,
     // However, there is no way to get nsapi_stack_t * from NetworkStack * using
     // public API, so we check if it's lwIP and work only in that case for now
     nsapi_size_or_error_t result;
-    if (nsapi_create_stack(&AvsSocketGlobal::get_interface())
-        == nsapi_create_stack(&lwip_stack)) {
+    if (nsapi_create_stack(&interface) == nsapi_create_stack(&lwip_stack)) {
         // lwIP stack, perform the multiple query
         AvsUniquePtr<nsapi_addr_t> nsapi_addrs(
                 reinterpret_cast<nsapi_addr_t *>(operator new(
@@ -121,9 +127,8 @@ nsapi_size_or_error_t dns_query_multiple(const char *host,
         // unsupported stack, so revert to single-result query
         MBED_ASSERT(addr_count >= 1);
         *addr = SocketAddress();
-        result = nsapi_dns_query(nsapi_create_stack(
-                                         &AvsSocketGlobal::get_interface()),
-                                 host, addr, version);
+        result = nsapi_dns_query(nsapi_create_stack(&interface), host, addr,
+                                 version);
         if (result == 0 && addr->get_ip_version() != NSAPI_UNSPEC) {
             result = 1;
         }
@@ -132,7 +137,14 @@ nsapi_size_or_error_t dns_query_multiple(const char *host,
 #endif
 }
 
-int32_t get_local_port(const InternetSocket *mbed_socket) {
+int32_t get_local_port(NetworkInterface &interface,
+                       const InternetSocket *mbed_socket) {
+#ifdef TARGET_ANJAY_MBEDOS_HOST
+    // the host stand-in for InternetSocket is based on POSIX sockets, so it
+    // can just call getsockname()
+    (void) interface;
+    return mbed_socket->host_local_port();
+#else  // TARGET_ANJAY_MBEDOS_HOST
     // mbed OS does not have any API for retrieving port number after binding
     // a socket to an ephemeral port.
     //
@@ -153,7 +165,7 @@ int32_t get_local_port(const InternetSocket *mbed_socket) {
 #else // mbed OS <= 5.8
     NetworkStack *lwip = nsapi_create_stack(&lwip_stack);
 #endif
-    if (nsapi_create_stack(&AvsSocketGlobal::get_interface()) == lwip) {
+    if (nsapi_create_stack(&interface) == lwip) {
         LwipSocketHack *lwip_socket = reinterpret_cast<LwipSocketHack *>(
                 mbed_socket->*PublicCast<P_socket>::value);
         switch (lwip_socket->conn->type) {
@@ -165,6 +177,7 @@ int32_t get_local_port(const InternetSocket *mbed_socket) {
         }
     }
     return -1;
+#endif // TARGET_ANJAY_MBEDOS_HOST
 }
 
 bool socket_types_match(const AvsSocket *left, const AvsSocket *right) {
@@ -176,4 +189,62 @@ bool socket_types_match(const AvsSocket *left, const AvsSocket *right) {
            == *reinterpret_cast<void *const *>(right);
 }
 
+#if PREREQ_MBED_OS(5, 15, 0)
+uint32_t atomic_load_u32(const volatile uint32_t *ptr) {
+    return core_util_atomic_load_u32(ptr);
+}
+
+void atomic_store_u32(volatile uint32_t *ptr, uint32_t value) {
+    core_util_atomic_store_u32(ptr, value);
+}
+#else  // PREREQ_MBED_OS(5, 15, 0)
+// older mbed OS versions don't have atomic loads and stores, so let's emulate
+// them with operations that imply memory barriers
+uint32_t atomic_load_u32(const volatile uint32_t *ptr) {
+    return core_util_atomic_incr_u32(const_cast<volatile uint32_t *>(ptr), 0);
+}
+
+void atomic_store_u32(volatile uint32_t *ptr, uint32_t value) {
+    uint32_t expected = *ptr;
+    while (!core_util_atomic_cas_u32(ptr, &expected, value))
+        ;
+}
+#endif // PREREQ_MBED_OS(5, 15, 0)
+
+long get_stack_rx_drops(NetworkInterface &interface) {
+#ifdef TARGET_ANJAY_MBEDOS_HOST
+    // the host's sockets all share the system's UDP stack
+    (void) interface;
+    return mbed_host_udp_rx_drops();
+#else // TARGET_ANJAY_MBEDOS_HOST
+#if PREREQ_MBED_OS(5, 9, 0)
+    NetworkStack *lwip = &LWIP::get_instance();
+#else // mbed OS <= 5.8
+    NetworkStack *lwip = nsapi_create_stack(&lwip_stack);
+#endif
+    if (nsapi_create_stack(&interface) != lwip) {
+        return -1;
+    }
+#if LWIP_STATS && (LINK_STATS || UDP_STATS || MEMP_STATS)
+    // lwIP does not count datagrams dropped because of a full netconn
+    // mailbox, but when the application does not keep up, the drops show up
+    // as pbuf pool exhaustion in the driver (MEMP_PBUF_POOL errors) and as
+    // packets dropped on the link layer
+    long drops = 0;
+#if LINK_STATS
+    drops += (long) (lwip_stats.link.drop + lwip_stats.link.memerr);
+#endif // LINK_STATS
+#if UDP_STATS
+    drops += (long) (lwip_stats.udp.drop + lwip_stats.udp.memerr);
+#endif // UDP_STATS
+#if MEMP_STATS
+    drops += (long) lwip_stats.memp[MEMP_PBUF_POOL]->err;
+#endif // MEMP_STATS
+    return drops;
+#else  // LWIP_STATS && (LINK_STATS || UDP_STATS || MEMP_STATS)
+    return -1;
+#endif // LWIP_STATS && (LINK_STATS || UDP_STATS || MEMP_STATS)
+#endif // TARGET_ANJAY_MBEDOS_HOST
+}
+
 } // namespace avs_mbed_hacks
@@ -87,16 +87,26 @@ public:
 
 namespace avs_mbed_hacks {
 
-nsapi_size_or_error_t dns_query_multiple(const char *host,
+nsapi_size_or_error_t dns_query_multiple(NetworkInterface &interface,
+                                         const char *host,
                                          SocketAddress *addr,
                                          nsapi_size_t addr_count,
                                          nsapi_version_t version);
 
-int32_t get_local_port(const InternetSocket *mbed_socket);
+int32_t get_local_port(NetworkInterface &interface,
+                       const InternetSocket *mbed_socket);
 
 bool socket_types_match(const avs_mbed_impl::AvsSocket *left,
                         const avs_mbed_impl::AvsSocket *right);
 
+uint32_t atomic_load_u32(const volatile uint32_t *ptr);
+void atomic_store_u32(volatile uint32_t *ptr, uint32_t value);
+
+// Returns the total number of incoming packets dropped by the network stack
+// serving @p interface, e.g. due to exhaustion of its buffers, or -1 if the
+// stack does not provide such statistics.
+long get_stack_rx_drops(NetworkInterface &interface);
+
 } // namespace avs_mbed_hacks
 
 #if !PREREQ_MBED_OS(5, 8, 0)
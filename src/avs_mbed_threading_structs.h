@@ -24,10 +24,31 @@ extern "C" {
 
 #include "mbed.h"
 
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
 #include "avs_mbed_hacks.h"
 
+#ifdef ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+// Defined in avs_mutex_profile.cpp; see also avs_mutex_profile.h
+struct AvsMutexProfileSlot;
+
+// Returns NULL if there are no free slots
+AvsMutexProfileSlot *avs_mutex_profile_attach(const avs_mutex_t *mutex);
+// Accepts NULL, for mutexes that did not get a slot
+void avs_mutex_profile_detach(AvsMutexProfileSlot *slot);
+// Called with the mutex already locked; wait_start_us is NULL if the mutex
+// was acquired without waiting
+void avs_mutex_profile_acquired(AvsMutexProfileSlot *slot,
+                                const uint32_t *wait_start_us);
+// Called with the mutex still locked
+void avs_mutex_profile_releasing(AvsMutexProfileSlot *slot);
+#endif // ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+
 struct avs_mutex {
     rtos::Mutex mbed_mtx;
+#ifdef ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+    AvsMutexProfileSlot *profile;
+#endif // ANJAY_MBEDOS_WITH_MUTEX_PROFILE
 };
 
 struct avs_condvar {
@@ -19,33 +19,82 @@
 
 #include "avs_mbed_threading_structs.h"
 
+#ifdef ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+#include <hal/us_ticker_api.h>
+#endif // ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+
+namespace {
+
+int lock_mbed_mutex(rtos::Mutex *mtx) {
+#if PREREQ_MBED_OS(6, 0, 0)
+    mtx->lock();
+    return 0;
+#else  // PREREQ_MBED_OS(6, 0, 0)
+    return mtx->lock() == osOK ? 0 : -1;
+#endif // PREREQ_MBED_OS(6, 0, 0)
+}
+
+int unlock_mbed_mutex(rtos::Mutex *mtx) {
+#if PREREQ_MBED_OS(6, 0, 0)
+    mtx->unlock();
+    return 0;
+#else  // PREREQ_MBED_OS(6, 0, 0)
+    return mtx->unlock() == osOK ? 0 : -1;
+#endif // PREREQ_MBED_OS(6, 0, 0)
+}
+
+} // namespace
+
 int avs_mutex_create(avs_mutex_t **out_mutex) {
     AVS_ASSERT(!*out_mutex, "possible attempt to reinitialize a mutex");
 
     *out_mutex = new (std::nothrow) avs_mutex;
+#ifdef ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+    if (*out_mutex) {
+        (*out_mutex)->profile = avs_mutex_profile_attach(*out_mutex);
+    }
+#endif // ANJAY_MBEDOS_WITH_MUTEX_PROFILE
     return *out_mutex ? 0 : -1;
 }
 
 int avs_mutex_lock(avs_mutex_t *mutex) {
-#if PREREQ_MBED_OS(6, 0, 0)
-    mutex->mbed_mtx.lock();
-    return 0;
-#else  // PREREQ_MBED_OS(6, 0, 0)
-    return mutex->mbed_mtx.lock() == osOK ? 0 : -1;
-#endif // PREREQ_MBED_OS(6, 0, 0)
+#ifdef ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+    if (mutex->profile) {
+        // only waits longer than an uncontended trylock() are timed
+        if (mutex->mbed_mtx.trylock()) {
+            avs_mutex_profile_acquired(mutex->profile, nullptr);
+            return 0;
+        }
+        uint32_t wait_start_us = us_ticker_read();
+        int result = lock_mbed_mutex(&mutex->mbed_mtx);
+        if (!result) {
+            avs_mutex_profile_acquired(mutex->profile, &wait_start_us);
+        }
+        return result;
+    }
+#endif // ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+    return lock_mbed_mutex(&mutex->mbed_mtx);
 }
 
 int avs_mutex_try_lock(avs_mutex_t *mutex) {
-    return mutex->mbed_mtx.trylock() ? 0 : -1;
+    if (!mutex->mbed_mtx.trylock()) {
+        return -1;
+    }
+#ifdef ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+    if (mutex->profile) {
+        avs_mutex_profile_acquired(mutex->profile, nullptr);
+    }
+#endif // ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+    return 0;
 }
 
 int avs_mutex_unlock(avs_mutex_t *mutex) {
-#if PREREQ_MBED_OS(6, 0, 0)
-    mutex->mbed_mtx.unlock();
-    return 0;
-#else  // PREREQ_MBED_OS(6, 0, 0)
-    return mutex->mbed_mtx.unlock() == osOK ? 0 : -1;
-#endif // PREREQ_MBED_OS(6, 0, 0)
+#ifdef ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+    if (mutex->profile) {
+        avs_mutex_profile_releasing(mutex->profile);
+    }
+#endif // ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+    return unlock_mbed_mutex(&mutex->mbed_mtx);
 }
 
 void avs_mutex_cleanup(avs_mutex_t **mutex) {
@@ -53,6 +102,9 @@ void avs_mutex_cleanup(avs_mutex_t **mutex) {
         return;
     }
 
+#ifdef ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+    avs_mutex_profile_detach((*mutex)->profile);
+#endif // ANJAY_MBEDOS_WITH_MUTEX_PROFILE
     delete *mutex;
     *mutex = nullptr;
 }
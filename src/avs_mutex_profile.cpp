@@ -0,0 +1,256 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+
+#include <hal/us_ticker_api.h>
+#include <mbed_critical.h>
+
+#include <avsystem/commons/avs_log.h>
+
+#include "avs_mbed_hacks.h"
+#include "avs_mbed_threading_structs.h"
+#include "avs_mutex_profile.h"
+
+#ifdef ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+
+// Slots are free if stats.mutex is NULL. All fields are accessed in critical
+// sections only; these are short enough not to matter next to the cost of
+// locking a mutex.
+struct AvsMutexProfileSlot {
+    AvsMutexStats stats;
+    uint32_t locked_at_us;
+    uint32_t depth;
+};
+
+namespace {
+
+AvsMutexProfileSlot SLOTS[ANJAY_MBEDOS_MUTEX_PROFILE_SLOTS];
+size_t UNPROFILED_COUNT;
+
+// Name set by the innermost AvsMutexProfile::Scope of each thread that has
+// one; entries are free if thread is NULL. Accessed in critical sections only.
+struct ScopeEntry {
+    void *thread;
+    const char *name;
+};
+
+const size_t MAX_SCOPE_THREADS = 4;
+ScopeEntry SCOPES[MAX_SCOPE_THREADS];
+
+ScopeEntry *find_scope(void *thread) {
+    for (size_t i = 0; i < MAX_SCOPE_THREADS; ++i) {
+        if (SCOPES[i].thread == thread) {
+            return &SCOPES[i];
+        }
+    }
+    return nullptr;
+}
+
+void *current_thread() {
+#if PREREQ_MBED_OS(5, 10, 0)
+    return (void *) rtos::ThisThread::get_id();
+#else  // PREREQ_MBED_OS(5, 10, 0)
+    return (void *) osThreadGetId();
+#endif // PREREQ_MBED_OS(5, 10, 0)
+}
+
+void clear_stats(AvsMutexStats *stats) {
+    stats->acquisitions = 0;
+    stats->contended = 0;
+    stats->total_wait_us = 0;
+    stats->max_wait_us = 0;
+    stats->max_hold_us = 0;
+}
+
+void log_entry(const AvsMutexStats *stats, void *) {
+    char name[24];
+    if (stats->name) {
+        snprintf(name, sizeof(name), "%s", stats->name);
+    } else {
+        snprintf(name, sizeof(name), "@%p", stats->mutex);
+    }
+    avs_log(mbed_mutex, INFO, "%-16s %11lu %11lu %11lu %11lu %11lu", name,
+            (unsigned long) stats->acquisitions,
+            (unsigned long) stats->contended,
+            (unsigned long) (stats->total_wait_us / 1000),
+            (unsigned long) stats->max_wait_us,
+            (unsigned long) stats->max_hold_us);
+}
+
+} // namespace
+
+AvsMutexProfileSlot *avs_mutex_profile_attach(const avs_mutex_t *mutex) {
+    void *thread = current_thread();
+    AvsMutexProfileSlot *result = nullptr;
+    core_util_critical_section_enter();
+    ScopeEntry *scope = find_scope(thread);
+    const char *name = scope ? scope->name : nullptr;
+    for (size_t i = 0; i < ANJAY_MBEDOS_MUTEX_PROFILE_SLOTS; ++i) {
+        if (!SLOTS[i].stats.mutex) {
+            result = &SLOTS[i];
+            result->stats.name = name;
+            result->stats.mutex = mutex;
+            clear_stats(&result->stats);
+            result->locked_at_us = 0;
+            result->depth = 0;
+            break;
+        }
+    }
+    if (!result) {
+        ++UNPROFILED_COUNT;
+    }
+    core_util_critical_section_exit();
+    return result;
+}
+
+void avs_mutex_profile_detach(AvsMutexProfileSlot *slot) {
+    core_util_critical_section_enter();
+    if (slot) {
+        slot->stats.mutex = nullptr;
+    } else {
+        --UNPROFILED_COUNT;
+    }
+    core_util_critical_section_exit();
+}
+
+void avs_mutex_profile_acquired(AvsMutexProfileSlot *slot,
+                                const uint32_t *wait_start_us) {
+    uint32_t now_us = us_ticker_read();
+    core_util_critical_section_enter();
+    if (slot->depth++ == 0) {
+        ++slot->stats.acquisitions;
+        slot->locked_at_us = now_us;
+    }
+    if (wait_start_us) {
+        uint32_t wait_us = now_us - *wait_start_us;
+        ++slot->stats.contended;
+        slot->stats.total_wait_us += wait_us;
+        if (wait_us > slot->stats.max_wait_us) {
+            slot->stats.max_wait_us = wait_us;
+        }
+    }
+    core_util_critical_section_exit();
+}
+
+void avs_mutex_profile_releasing(AvsMutexProfileSlot *slot) {
+    uint32_t now_us = us_ticker_read();
+    core_util_critical_section_enter();
+    if (slot->depth && --slot->depth == 0) {
+        uint32_t hold_us = now_us - slot->locked_at_us;
+        if (hold_us > slot->stats.max_hold_us) {
+            slot->stats.max_hold_us = hold_us;
+        }
+    }
+    core_util_critical_section_exit();
+}
+
+AvsMutexProfile::Scope::Scope(const char *name)
+        : previous_name_(nullptr), thread_(current_thread()) {
+    core_util_critical_section_enter();
+    ScopeEntry *scope = find_scope(thread_);
+    if (scope) {
+        previous_name_ = scope->name;
+    } else if ((scope = find_scope(nullptr))) {
+        scope->thread = thread_;
+    } else {
+        // too many threads with scopes at the same time; this one is ignored
+        thread_ = nullptr;
+    }
+    if (scope) {
+        scope->name = name;
+    }
+    core_util_critical_section_exit();
+}
+
+AvsMutexProfile::Scope::~Scope() {
+    if (!thread_) {
+        return;
+    }
+    core_util_critical_section_enter();
+    ScopeEntry *scope = find_scope(thread_);
+    if (scope) {
+        if (previous_name_) {
+            scope->name = previous_name_;
+        } else {
+            scope->thread = nullptr;
+        }
+    }
+    core_util_critical_section_exit();
+}
+
+void AvsMutexProfile::set_name(avs_mutex_t *mutex, const char *name) {
+    core_util_critical_section_enter();
+    if (mutex->profile) {
+        mutex->profile->stats.name = name;
+    }
+    core_util_critical_section_exit();
+}
+
+size_t AvsMutexProfile::dump(EntryFunc *func, void *arg) {
+    for (size_t i = 0; i < ANJAY_MBEDOS_MUTEX_PROFILE_SLOTS; ++i) {
+        core_util_critical_section_enter();
+        AvsMutexStats stats = SLOTS[i].stats;
+        core_util_critical_section_exit();
+        if (stats.mutex) {
+            func(&stats, arg);
+        }
+    }
+    return UNPROFILED_COUNT;
+}
+
+void AvsMutexProfile::log_table() {
+    avs_log(mbed_mutex, INFO, "%-16s %11s %11s %11s %11s %11s", "mutex",
+            "acquired", "contended", "wait_ms", "max_wait_us", "max_hold_us");
+    size_t unprofiled = dump(log_entry, nullptr);
+    if (unprofiled) {
+        avs_log(mbed_mutex, INFO,
+                "%lu mutexes not profiled, increase "
+                "ANJAY_MBEDOS_MUTEX_PROFILE_SLOTS",
+                (unsigned long) unprofiled);
+    }
+}
+
+void AvsMutexProfile::reset() {
+    for (size_t i = 0; i < ANJAY_MBEDOS_MUTEX_PROFILE_SLOTS; ++i) {
+        core_util_critical_section_enter();
+        clear_stats(&SLOTS[i].stats);
+        core_util_critical_section_exit();
+    }
+}
+
+#else // ANJAY_MBEDOS_WITH_MUTEX_PROFILE
+
+// Naming mutexes is a no-op, so that applications do not need to depend on
+// the configuration to do it
+
+AvsMutexProfile::Scope::Scope(const char *)
+        : previous_name_(nullptr), thread_(nullptr) {}
+
+AvsMutexProfile::Scope::~Scope() {}
+
+void AvsMutexProfile::set_name(avs_mutex_t *, const char *) {}
+
+size_t AvsMutexProfile::dump(EntryFunc *, void *) {
+    return 0;
+}
+
+void AvsMutexProfile::log_table() {}
+
+void AvsMutexProfile::reset() {}
+
+#endif // ANJAY_MBEDOS_WITH_MUTEX_PROFILE
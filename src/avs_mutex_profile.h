@@ -0,0 +1,109 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef AVS_MUTEX_PROFILE_H
+#define AVS_MUTEX_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
+extern "C" {
+#include <avsystem/commons/avs_mutex.h>
+} // extern "C"
+
+// Contention and hold time statistics of avs_mutex_t objects, collected if
+// ANJAY_MBEDOS_WITH_MUTEX_PROFILE is enabled; otherwise, all methods do
+// nothing and dump() reports no mutexes. Times are measured with the
+// microsecond ticker, so single waits and holds longer than about 71 minutes
+// are not reported correctly.
+
+struct AvsMutexStats {
+    // name given with AvsMutexProfile::set_name() or AvsMutexProfile::Scope,
+    // or NULL
+    const char *name;
+    // address of the mutex, to tell apart mutexes with the same name
+    const void *mutex;
+    // successful lock and trylock operations, not counting recursive ones
+    uint32_t acquisitions;
+    // lock operations that had to wait, because another thread held the mutex
+    uint32_t contended;
+    // total and maximum time spent in contended lock operations
+    uint64_t total_wait_us;
+    uint32_t max_wait_us;
+    // maximum time between an acquisition and the matching unlock
+    uint32_t max_hold_us;
+};
+
+class AvsMutexProfile {
+public:
+    typedef void EntryFunc(const AvsMutexStats *stats, void *arg);
+
+    /**
+     * Names mutexes created by the current thread during the lifetime of this
+     * object, e.g. the ones created by anjay_new(). Scopes may be nested; the
+     * innermost one of the thread applies. Scope objects MUST be destroyed by
+     * the thread that created them, in reverse order of creation.
+     *
+     * Up to 4 threads may have scopes at the same time; scopes created by
+     * further threads are ignored.
+     *
+     * @p name is not copied and MUST remain valid as long as the mutexes exist.
+     */
+    class Scope {
+        const char *previous_name_;
+        // NULL if the scope is ignored
+        void *thread_;
+
+        Scope(const Scope &);
+        Scope &operator=(const Scope &);
+
+    public:
+        explicit Scope(const char *name);
+        ~Scope();
+    };
+
+    /**
+     * Names an existing mutex. @p name is not copied and MUST remain valid as
+     * long as the mutex exists. Does nothing if the mutex is not profiled.
+     */
+    static void set_name(avs_mutex_t *mutex, const char *name);
+
+    /**
+     * Calls @p func for each mutex that currently exists and is profiled. Each
+     * entry is a consistent snapshot, but the entries are not taken at the
+     * same instant.
+     *
+     * @returns Number of mutexes that exist, but are not profiled, because
+     *          there were no free slots when they were created.
+     */
+    static size_t dump(EntryFunc *func, void *arg);
+
+    /**
+     * Writes the statistics of all profiled mutexes as a table to avs_log, at
+     * the INFO level.
+     */
+    static void log_table();
+
+    /**
+     * Clears statistics of all profiled mutexes. Names are retained.
+     */
+    static void reset();
+};
+
+#endif /* AVS_MUTEX_PROFILE_H */
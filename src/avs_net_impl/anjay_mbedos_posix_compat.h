@@ -44,6 +44,7 @@ int _anjay_mbedos_poll(struct avs_mbedos_pollfd *fds,
                        int timeout_ms);
 
 #define AVS_MBEDOS_POLLIN 1
+#define AVS_MBEDOS_POLLOUT 4
 
 #ifdef __cplusplus
 } // extern "C"
@@ -76,6 +77,11 @@ typedef avs_net_socket_t *sockfd_t;
 #endif // POLLIN
 #define POLLIN AVS_MBEDOS_POLLIN
 
+#ifdef POLLOUT
+#undef POLLOUT
+#endif // POLLOUT
+#define POLLOUT AVS_MBEDOS_POLLOUT
+
 #ifdef poll
 #undef poll
 #endif // poll
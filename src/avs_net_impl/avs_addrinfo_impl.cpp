@@ -23,6 +23,7 @@
 
 #include "avs_mbed_hacks.h"
 #include "avs_socket_impl.h"
+#include "avs_static_pool.h"
 
 using namespace avs_mbed_hacks;
 using namespace avs_mbed_impl;
@@ -30,6 +31,14 @@ using namespace std;
 
 namespace {
 
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+AVS_STATIC_POOL_DEFINE(ADDRINFOS,
+                       offsetof(avs_net_addrinfo_t, results)
+                               + ANJAY_MBEDOS_STATIC_MAX_DNS_RESULTS
+                                         * sizeof(SocketAddress),
+                       ANJAY_MBEDOS_STATIC_MAX_ADDRINFOS);
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+
 static SocketAddress create_v4mapped(const SocketAddress &addr) {
     MBED_ASSERT(addr.get_ip_version() == NSAPI_IPv4);
     uint8_t bytes[16];
@@ -94,7 +103,8 @@ bool address_matches_family(const SocketAddress &addr,
 }
 
 nsapi_error_t
-perform_dns_query(avs_net_addrinfo_t *ctx,
+perform_dns_query(NetworkInterface &interface,
+                  avs_net_addrinfo_t *ctx,
                   size_t ctx_results_allocated_count,
                   avs_net_af_t family,
                   const char *host,
@@ -103,19 +113,19 @@ perform_dns_query(avs_net_addrinfo_t *ctx,
     nsapi_size_or_error_t retval;
     switch (family) {
     case AVS_NET_AF_INET4:
-        retval = dns_query_multiple(host, ctx->results,
+        retval = dns_query_multiple(interface, host, ctx->results,
                                     ctx_results_allocated_count, NSAPI_IPv4);
         break;
     case AVS_NET_AF_INET6:
-        retval = dns_query_multiple(host, ctx->results,
+        retval = dns_query_multiple(interface, host, ctx->results,
                                     ctx_results_allocated_count, NSAPI_IPv6);
         break;
     case AVS_NET_AF_UNSPEC:
-        retval = dns_query_multiple(host, ctx->results,
+        retval = dns_query_multiple(interface, host, ctx->results,
                                     ctx_results_allocated_count, NSAPI_IPv6);
         if (retval >= 0 && (size_t) retval < ctx_results_allocated_count) {
             nsapi_size_or_error_t v4result =
-                    dns_query_multiple(host, &ctx->results[retval],
+                    dns_query_multiple(interface, host, &ctx->results[retval],
                                        ctx_results_allocated_count - retval,
                                        NSAPI_IPv4);
             if (v4result < 0) {
@@ -154,6 +164,23 @@ perform_dns_query(avs_net_addrinfo_t *ctx,
 
 } // namespace
 
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+void *avs_net_addrinfo_struct::operator new(size_t size,
+                                            const nothrow_t &) throw() {
+    MBED_ASSERT(size <= ADDRINFOS.block_size);
+    return ADDRINFOS.allocate();
+}
+
+void avs_net_addrinfo_struct::operator delete(void *ptr) {
+    ADDRINFOS.free(ptr);
+}
+
+void avs_net_addrinfo_struct::operator delete(void *ptr,
+                                              const nothrow_t &) throw() {
+    ADDRINFOS.free(ptr);
+}
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+
 void avs_net_addrinfo_delete(avs_net_addrinfo_t **ctx) {
     if (*ctx) {
         // we need to use operator delete because we want to remain compatible
@@ -163,8 +190,8 @@ void avs_net_addrinfo_delete(avs_net_addrinfo_t **ctx) {
     }
 }
 
-avs_net_addrinfo_t *avs_net_addrinfo_resolve_ex(
-        avs_net_socket_type_t socket_type,
+avs_net_addrinfo_t *avs_mbed_impl::resolve_addrinfo(
+        NetworkInterface &interface,
         avs_net_af_t family,
         const char *host,
         const char *port_str,
@@ -208,9 +235,14 @@ avs_net_addrinfo_t *avs_net_addrinfo_resolve_ex(
     size_t alloc_bytes =
             offsetof(avs_net_addrinfo_t, results)
             + number_of_entries_to_allocate * sizeof(SocketAddress);
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    AvsUniquePtr<avs_net_addrinfo_t> ctx(reinterpret_cast<avs_net_addrinfo_t *>(
+            avs_net_addrinfo_t::operator new(alloc_bytes, nothrow)));
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
     AvsUniquePtr<avs_net_addrinfo_t> ctx(
             reinterpret_cast<avs_net_addrinfo_t *>(operator new(alloc_bytes,
                                                                 nothrow)));
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
     void *ctx_ptr = ctx.get();
     if (!ctx_ptr) {
         LOG(ERROR, "Out of memory");
@@ -227,13 +259,25 @@ avs_net_addrinfo_t *avs_net_addrinfo_resolve_ex(
         // host was a literal IP address
         ctx->count = 1;
         ctx->results[0] = literal_addr;
-    } else if (perform_dns_query(ctx.get(), number_of_entries_to_allocate,
-                                 family, host, port, preferred_endpoint)) {
+    } else if (perform_dns_query(interface, ctx.get(),
+                                 number_of_entries_to_allocate, family, host,
+                                 port, preferred_endpoint)) {
         return nullptr;
     }
     return ctx.release();
 }
 
+avs_net_addrinfo_t *avs_net_addrinfo_resolve_ex(
+        avs_net_socket_type_t socket_type,
+        avs_net_af_t family,
+        const char *host,
+        const char *port_str,
+        int flags,
+        const avs_net_resolved_endpoint_t *preferred_endpoint) {
+    return resolve_addrinfo(AvsSocketGlobal::get_interface(), family, host,
+                            port_str, flags, preferred_endpoint);
+}
+
 int avs_net_addrinfo_next(avs_net_addrinfo_t *ctx,
                           avs_net_resolved_endpoint_t *out) {
     if (ctx->current_index >= ctx->count) {
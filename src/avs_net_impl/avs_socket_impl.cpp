@@ -19,6 +19,7 @@
 #include <Semaphore.h>
 #include <mbed.h>
 #include <mbed_assert.h>
+#include <mbed_critical.h>
 #include <mbed_error.h>
 
 #include <avsystem/commons/avs_commons_config.h>
@@ -26,8 +27,13 @@
 #include <avsystem/commons/avs_list_cxx.hpp>
 #include <avsystem/commons/avs_socket_v_table.h>
 
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
 #include "avs_mbed_hacks.h"
+#include "avs_pmtu_cache.h"
 #include "avs_socket_impl.h"
+#include "avs_socket_trace.h"
+#include "avs_static_pool.h"
 
 #include "anjay_mbedos_posix_compat.h"
 
@@ -48,8 +54,54 @@ AVS_STATIC_ASSERT(sizeof(SocketAddress)
                           <= AVS_NET_SOCKET_RAW_RESOLVED_ENDPOINT_MAX_SIZE,
                   endpoint_size_supported);
 
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+#define NET_SOCKET_SIZE(Type) \
+    (offsetof(avs_net_socket_t, impl_placeholder) + sizeof(Type))
+
+AVS_STATIC_POOL_DEFINE(NET_SOCKETS,
+                       NET_SOCKET_SIZE(AvsTcpSocket)
+                                       > NET_SOCKET_SIZE(AvsUdpSocket)
+                               ? NET_SOCKET_SIZE(AvsTcpSocket)
+                               : NET_SOCKET_SIZE(AvsUdpSocket),
+                       ANJAY_MBEDOS_STATIC_MAX_SOCKETS);
+
+// used by AvsSocketGlobal::send_vectored() for sockets that only accept
+// contiguous buffers
+uint64_t SEND_GATHER_POOL_STORAGE[(ANJAY_MBEDOS_STATIC_RECV_BUFFER_SIZE
+                                   + sizeof(uint64_t) - 1)
+                                  / sizeof(uint64_t)];
+Mutex SEND_GATHER_MUTEX;
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+
+avs_net_socket_t *allocate_net_socket(size_t size) {
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    MBED_ASSERT(size <= NET_SOCKETS.block_size);
+    void *net_socket = NET_SOCKETS.allocate();
+    if (net_socket) {
+        memset(net_socket, 0, size);
+    }
+    return reinterpret_cast<avs_net_socket_t *>(net_socket);
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    return reinterpret_cast<avs_net_socket_t *>(calloc(1, size));
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+}
+
+void free_net_socket(avs_net_socket_t *net_socket) {
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    NET_SOCKETS.free(net_socket);
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    free(net_socket);
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+}
+
 #if PREREQ_MBED_OS(5, 6, 0)
 EventFlags AVS_SOCKET_POLL_FLAG;
+
+// set by sigio callbacks of all sockets
+#define POLL_FLAG_SOCKET 1u
+// set by AvsSocketGlobal::interrupt_poll(); not cleared by reset_poll_flag(),
+// so that an interrupt requested just before a poll starts is not lost
+#define POLL_FLAG_INTERRUPT 2u
 #else // mbed OS < 5.6 does not have EventFlags
 Semaphore AVS_SOCKET_POLL_SEM;
 #endif
@@ -118,7 +170,7 @@ avs_error_t shutdown_net(avs_net_socket_t *net_socket) {
 
 avs_error_t cleanup_net(avs_net_socket_t **net_socket) {
     get_impl(*net_socket)->~AvsSocket();
-    free(*net_socket);
+    free_net_socket(*net_socket);
     *net_socket = nullptr;
     return AVS_OK;
 }
@@ -208,8 +260,7 @@ avs_error_t create_net_socket(avs_net_socket_t **socket,
     default:
         error("Invalid socket type\r\n");
     }
-    avs_net_socket_t *net_socket =
-            reinterpret_cast<avs_net_socket_t *>(calloc(1, size));
+    avs_net_socket_t *net_socket = allocate_net_socket(size);
     if (!net_socket) {
         return avs_errno(AVS_ENOMEM);
     }
@@ -256,31 +307,42 @@ int get_other_family(avs_net_af_t *out, avs_net_af_t in) {
     }
 }
 
-struct PollSocketEntry {
-    Socket *mbed_socket;
-    avs::List<avs_net_socket_t *> avs_sockets;
+// Only called again if no socket was ready the previous time, so the sockets
+// are simply checked in place, without building any auxiliary lists.
+static int
+poll_nonblocking(avs::List<avs_net_socket_t *> &out,
+                 const avs::ListView<avs_net_socket_t *const> &avs_sockets) {
+    for (avs::ListIterator<avs_net_socket_t *const> it = avs_sockets.begin();
+         it != avs_sockets.end(); ++it) {
+        if (reinterpret_cast<const AvsSocket *>(avs_net_socket_get_system(*it))
+                    ->ready_to_receive()
+            && out.push_back(*it) == out.end()) {
+            // out of memory
+            return -1;
+        }
+    }
+    return 0;
+}
+
+struct NamedInterface {
+    avs_net_socket_interface_name_t name;
+    NetworkInterface *interface;
 };
 
-static int poll_nonblocking(avs::List<avs_net_socket_t *> &out,
-                            avs::List<PollSocketEntry> &entries) {
-    for (avs::ListIterator<PollSocketEntry> it = entries.begin();
-         it != entries.end(); ++it) {
-        avs::ListIterator<avs_net_socket_t *> avs_it = it->avs_sockets.begin();
-        while (avs_it != it->avs_sockets.end()) {
-            if (reinterpret_cast<const AvsSocket *>(
-                        avs_net_socket_get_system(*avs_it))
-                        ->ready_to_receive()) {
-                if (out.push_back(*avs_it) == out.end()) {
-                    // out of memory
-                    return -1;
-                }
-                avs_it = it->avs_sockets.erase(avs_it);
-            } else {
-                ++avs_it;
-            }
+NamedInterface NAMED_INTERFACES[ANJAY_MBEDOS_MAX_NAMED_INTERFACES];
+
+// see AvsSendVectoredStats
+volatile uint32_t SEND_VECTORED_COPIED_BYTES = 0;
+volatile uint32_t SEND_VECTORED_TEMPORARY_BUFFER_BYTES = 0;
+
+NamedInterface *find_named_interface(const char *name) {
+    for (size_t i = 0; i < ANJAY_MBEDOS_MAX_NAMED_INTERFACES; ++i) {
+        if (NAMED_INTERFACES[i].interface
+            && strcmp(NAMED_INTERFACES[i].name, name) == 0) {
+            return &NAMED_INTERFACES[i];
         }
     }
-    return 0;
+    return nullptr;
 }
 
 } // namespace
@@ -296,14 +358,32 @@ AvsSocketGlobal::AvsSocketGlobal(NetworkInterface *interface,
                                  avs_net_af_t preferred_family) {
     MBED_ASSERT(!INTERFACE);
     MBED_ASSERT(preferred_family != AVS_NET_AF_UNSPEC);
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    if (max_dns_results > ANJAY_MBEDOS_STATIC_MAX_DNS_RESULTS
+        || recv_buffer_size > ANJAY_MBEDOS_STATIC_RECV_BUFFER_SIZE) {
+        error("AvsSocketGlobal parameters exceed static capacities\r\n");
+    }
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
     INTERFACE = interface;
     MAX_DNS_RESULTS = max_dns_results;
     RECV_BUFFER_SIZE = recv_buffer_size;
     PREFERRED_FAMILY = preferred_family;
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    // routers never allocate buffers of their own in this mode; this fails
+    // e.g. if a UDP socket created with a previous instance is still bound
+    if (avs_is_err(set_shared_recv_buffers(ANJAY_MBEDOS_STATIC_RECV_BUFFERS))) {
+        error("could not set up static UDP receive buffers\r\n");
+    }
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
 }
 
 AvsSocketGlobal::~AvsSocketGlobal() {
+#ifndef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    set_shared_recv_buffers(0);
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
     INTERFACE = nullptr;
+    memset(NAMED_INTERFACES, 0, sizeof(NAMED_INTERFACES));
+    AvsPmtuCache::flush();
 }
 
 NetworkInterface &AvsSocketGlobal::get_interface() {
@@ -311,6 +391,40 @@ NetworkInterface &AvsSocketGlobal::get_interface() {
     return *INTERFACE;
 }
 
+avs_error_t AvsSocketGlobal::add_interface(const char *name,
+                                           NetworkInterface *interface) {
+    if (!name || !*name || strlen(name) >= sizeof(NamedInterface().name)
+        || !interface) {
+        return avs_errno(AVS_EINVAL);
+    }
+    if (find_named_interface(name)) {
+        return avs_errno(AVS_EEXIST);
+    }
+    for (size_t i = 0; i < ANJAY_MBEDOS_MAX_NAMED_INTERFACES; ++i) {
+        if (!NAMED_INTERFACES[i].interface) {
+            strcpy(NAMED_INTERFACES[i].name, name);
+            NAMED_INTERFACES[i].interface = interface;
+            return AVS_OK;
+        }
+    }
+    return avs_errno(AVS_ENOMEM);
+}
+
+void AvsSocketGlobal::remove_interface(const char *name) {
+    NamedInterface *entry = find_named_interface(name);
+    if (entry) {
+        memset(entry, 0, sizeof(*entry));
+    }
+}
+
+NetworkInterface *AvsSocketGlobal::find_interface(const char *name) {
+    if (!name || !*name) {
+        return INTERFACE;
+    }
+    NamedInterface *entry = find_named_interface(name);
+    return entry ? entry->interface : nullptr;
+}
+
 uint8_t AvsSocketGlobal::max_dns_result() {
     MBED_ASSERT(INTERFACE);
     return MAX_DNS_RESULTS;
@@ -326,51 +440,119 @@ avs_net_af_t AvsSocketGlobal::preferred_family() {
     return PREFERRED_FAMILY;
 }
 
+avs_error_t AvsSocketGlobal::set_dtls_connection_id(avs_net_socket_t *socket,
+                                                    const void *cid,
+                                                    size_t cid_size) {
+    // for DTLS sockets, this returns the underlying UDP socket
+    AvsSocket *impl = reinterpret_cast<AvsSocket *>(
+            const_cast<void *>(avs_net_socket_get_system(socket)));
+    if (!impl) {
+        return avs_errno(AVS_EBADF);
+    }
+    return impl->set_dtls_connection_id(cid, cid_size);
+}
+
+avs_error_t AvsSocketGlobal::set_pmtu_discovery(avs_net_socket_t *socket,
+                                                bool enabled) {
+    // for DTLS sockets, this returns the underlying UDP socket
+    AvsSocket *impl = reinterpret_cast<AvsSocket *>(
+            const_cast<void *>(avs_net_socket_get_system(socket)));
+    if (!impl) {
+        return avs_errno(AVS_EBADF);
+    }
+    return impl->set_pmtu_discovery(enabled);
+}
+
+avs_error_t AvsSocketGlobal::set_nonblocking_connect(avs_net_socket_t *socket,
+                                                     bool enabled) {
+    if (socket->operations != &NET_VTABLE) {
+        return avs_errno(AVS_ENOTSUP);
+    }
+    return get_impl(socket)->set_nonblocking_connect(enabled);
+}
+
+avs_error_t AvsSocketGlobal::finish_connect(avs_net_socket_t *socket) {
+    if (socket->operations != &NET_VTABLE) {
+        return avs_errno(AVS_ENOTSUP);
+    }
+    return get_impl(socket)->finish_connect();
+}
+
+avs_error_t AvsSocketGlobal::send_vectored(avs_net_socket_t *socket,
+                                           const AvsIoVec *iov,
+                                           size_t iov_count) {
+    if (socket->operations == &NET_VTABLE) {
+        return get_impl(socket)->send_vectored(iov, iov_count);
+    }
+    // decorated sockets (e.g. DTLS) only accept contiguous buffers
+    if (iov_count == 1) {
+        return avs_net_socket_send(socket, iov[0].base, iov[0].length);
+    }
+    size_t length = iov_total_length(iov, iov_count);
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    if (length > sizeof(SEND_GATHER_POOL_STORAGE)) {
+        return avs_errno(AVS_EMSGSIZE);
+    }
+    ScopedLock<Mutex> lock(SEND_GATHER_MUTEX);
+    void *buffer = SEND_GATHER_POOL_STORAGE;
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    void *buffer = malloc(length ? length : 1);
+    if (!buffer) {
+        return avs_errno(AVS_ENOMEM);
+    }
+    count_temporary_gather_buffer(length);
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    iov_gather(buffer, iov, iov_count);
+    avs_error_t err = avs_net_socket_send(socket, buffer, length);
+#ifndef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    free(buffer);
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    return err;
+}
+
+void AvsSocketGlobal::get_send_vectored_stats(AvsSendVectoredStats *out) {
+    out->copied_bytes = atomic_load_u32(&SEND_VECTORED_COPIED_BYTES);
+    out->temporary_buffer_bytes =
+            atomic_load_u32(&SEND_VECTORED_TEMPORARY_BUFFER_BYTES);
+}
+
+void AvsSocketGlobal::reset_send_vectored_stats() {
+    atomic_store_u32(&SEND_VECTORED_COPIED_BYTES, 0);
+    atomic_store_u32(&SEND_VECTORED_TEMPORARY_BUFFER_BYTES, 0);
+}
+
+void AvsSocketGlobal::interrupt_poll() {
+    avs_mbed_impl::interrupt_poll();
+}
+
 int AvsSocketGlobal::poll(
         avs::List<avs_net_socket_t *> &out,
         const avs::ListView<avs_net_socket_t *const> &avs_sockets,
         uint32_t timeout_ms) {
     out.clear();
-    avs::List<PollSocketEntry> entries;
-    avs::ListIterator<PollSocketEntry> it;
-
-    for (avs::ListIterator<avs_net_socket_t *const> avs_it =
-                 avs_sockets.begin();
-         avs_it != avs_sockets.end(); ++avs_it) {
-        Socket *mbed_socket = reinterpret_cast<const AvsSocket *>(
-                                      avs_net_socket_get_system(*avs_it))
-                                      ->mbed_socket();
-        it = entries.begin();
-        while (it != entries.end()
-               && (uintptr_t) it->mbed_socket < (uintptr_t) mbed_socket) {
-            ++it;
-        }
-        if (it == entries.end() || it->mbed_socket != mbed_socket) {
-            it = entries.allocate(it);
-            if (it == entries.end()) {
-                // out of memory
-                return -1;
-            }
-            (new (&*it) PollSocketEntry())->mbed_socket = mbed_socket;
-        }
-        if (it->avs_sockets.push_back(*avs_it) == it->avs_sockets.end()) {
-            // out of memory
-            return -1;
-        }
+#ifdef ANJAY_MBEDOS_WITH_SOCKET_TRACE
+    size_t num_sockets = 0;
+    for (avs::ListIterator<avs_net_socket_t *const> it = avs_sockets.begin();
+         it != avs_sockets.end(); ++it) {
+        ++num_sockets;
     }
+    AVS_SOCKET_TRACE(POLL_BEGIN, nullptr, num_sockets, timeout_ms);
+#endif // ANJAY_MBEDOS_WITH_SOCKET_TRACE
 
     reset_poll_flag();
 
     // any of the sockets might actually have data already buffered
-    if (poll_nonblocking(out, entries)) {
+    if (poll_nonblocking(out, avs_sockets)) {
         return -1;
-    } else if (!out.empty()) {
-        return 0;
+    } else if (out.empty()) {
+        // if not, then wait for some event
+        wait_on_poll_flag_or_interrupt(timeout_ms);
+        if (poll_nonblocking(out, avs_sockets)) {
+            return -1;
+        }
     }
-
-    // if not, then wait for some event
-    wait_on_poll_flag(timeout_ms);
-    return poll_nonblocking(out, entries);
+    AVS_SOCKET_TRACE(POLL_END, nullptr, out.size(), 0);
+    return 0;
 }
 
 namespace avs_mbed_impl {
@@ -458,15 +640,45 @@ void store_resolved_endpoint(avs_net_resolved_endpoint_t *out,
     memcpy(&out->data, &address, sizeof(SocketAddress));
 }
 
+size_t iov_total_length(const AvsIoVec *iov, size_t iov_count) {
+    size_t length = 0;
+    for (size_t i = 0; i < iov_count; ++i) {
+        length += iov[i].length;
+    }
+    return length;
+}
+
+void iov_gather(void *out, const AvsIoVec *iov, size_t iov_count) {
+    uint8_t *ptr = reinterpret_cast<uint8_t *>(out);
+    size_t copied = 0;
+    for (size_t i = 0; i < iov_count; ++i) {
+        if (iov[i].length) {
+            memcpy(ptr, iov[i].base, iov[i].length);
+            ptr += iov[i].length;
+            copied += iov[i].length;
+        }
+    }
+    core_util_atomic_incr_u32(&SEND_VECTORED_COPIED_BYTES, (uint32_t) copied);
+}
+
+void count_temporary_gather_buffer(size_t size) {
+    core_util_atomic_incr_u32(&SEND_VECTORED_TEMPORARY_BUFFER_BYTES,
+                              (uint32_t) size);
+}
+
 bool addresses_equal(const SocketAddress &left, const SocketAddress &right) {
     // operator ==() on SocketAddress objects is insane.
     // IT DOES NOT COMPARE PORTS, FOR HECK'S SAKE. BLOODY HELL.
     return left == right && left.get_port() == right.get_port();
 }
 
+bool is_in_progress(avs_error_t err) {
+    return err.category == AVS_ERRNO_CATEGORY && err.code == AVS_EINPROGRESS;
+}
+
 void reset_poll_flag() {
 #if PREREQ_MBED_OS(5, 6, 0)
-    AVS_SOCKET_POLL_FLAG.clear();
+    AVS_SOCKET_POLL_FLAG.clear(POLL_FLAG_SOCKET);
 #else
     // reset the semaphore taking all the tokens
     while (AVS_SOCKET_POLL_SEM.wait(0) > 0)
@@ -476,15 +688,34 @@ void reset_poll_flag() {
 
 void trigger_poll_flag() {
 #if PREREQ_MBED_OS(5, 6, 0)
-    AVS_SOCKET_POLL_FLAG.set(1);
+    AVS_SOCKET_POLL_FLAG.set(POLL_FLAG_SOCKET);
 #else
     AVS_SOCKET_POLL_SEM.release();
 #endif
 }
 
+void interrupt_poll() {
+#if PREREQ_MBED_OS(5, 6, 0)
+    AVS_SOCKET_POLL_FLAG.set(POLL_FLAG_INTERRUPT);
+#else
+    // NOTE: This might get lost if it happens between the start of a poll
+    // and reset_poll_flag()
+    AVS_SOCKET_POLL_SEM.release();
+#endif
+}
+
 void wait_on_poll_flag(uint32_t timeout_ms) {
 #if PREREQ_MBED_OS(5, 6, 0)
-    AVS_SOCKET_POLL_FLAG.wait_any(1, timeout_ms);
+    AVS_SOCKET_POLL_FLAG.wait_any(POLL_FLAG_SOCKET, timeout_ms);
+#else
+    AVS_SOCKET_POLL_SEM.wait(timeout_ms);
+#endif
+}
+
+void wait_on_poll_flag_or_interrupt(uint32_t timeout_ms) {
+#if PREREQ_MBED_OS(5, 6, 0)
+    AVS_SOCKET_POLL_FLAG.wait_any(POLL_FLAG_SOCKET | POLL_FLAG_INTERRUPT,
+                                  timeout_ms);
 #else
     AVS_SOCKET_POLL_SEM.wait(timeout_ms);
 #endif
@@ -578,11 +809,10 @@ AvsSocket::resolve_addrinfo(const char *host,
         return result;
     }
 
-    // avs_net_socket_type_t is ignored in avs_net_addrinfo_resolve_ex() anyway
-    // also, it's safe to use AvsUniquePtr because avs_net_addrinfo_delete()
-    // just calls operator delete
-    result.reset(avs_net_addrinfo_resolve_ex(
-            avs_net_socket_type_t(), family, host, port, resolve_flags,
+    // it's safe to use AvsUniquePtr because avs_net_addrinfo_delete() just
+    // calls operator delete
+    result.reset(avs_mbed_impl::resolve_addrinfo(
+            network_interface(), family, host, port, resolve_flags,
             use_preferred_endpoint ? configuration_.preferred_endpoint
                                    : nullptr));
     return result;
@@ -603,9 +833,12 @@ void AvsSocket::update_remote_endpoint(const char *hostname,
 
 avs_error_t
 AvsSocket::initialize(const avs_net_socket_configuration_t *configuration) {
-    if (*configuration->interface_name) {
-        LOG(ERROR, "Configuring interface name is not supported");
-        return avs_errno(AVS_EINVAL);
+    NetworkInterface *interface =
+            AvsSocketGlobal::find_interface(configuration->interface_name);
+    if (!interface) {
+        LOG(ERROR, "unknown network interface: %s",
+            configuration->interface_name);
+        return avs_errno(AVS_ENODEV);
     }
     if (configuration->dscp >= 64) {
         LOG(ERROR, "bad DSCP value <%x>", (unsigned) configuration->dscp);
@@ -617,6 +850,7 @@ AvsSocket::initialize(const avs_net_socket_configuration_t *configuration) {
         return avs_errno(AVS_EINVAL);
     }
     configuration_ = *configuration;
+    interface_ = interface;
     return AVS_OK;
 }
 
@@ -646,6 +880,8 @@ avs_error_t AvsSocket::bind(const char *localaddr, const char *port_str) {
                        .move();
         err = try_bind(info.get());
     }
+    AVS_SOCKET_TRACE(BIND, this, AvsSocketTrace::error_arg(err),
+                     local_address_.get_port());
     return err;
 }
 
@@ -664,7 +900,8 @@ avs_error_t AvsSocket::connect(const char *host, const char *port) {
     SocketAddress address;
     if (info.get()) {
         while (!next_socket_address(info.get(), &address)) {
-            if (avs_is_ok((err = try_connect(address)))) {
+            if (avs_is_ok((err = try_connect(address)))
+                || is_in_progress(err)) {
                 goto success;
             }
         }
@@ -672,37 +909,49 @@ avs_error_t AvsSocket::connect(const char *host, const char *port) {
     info = resolve_addrinfo(host, port, true, PREFERRED_FAMILY_BLOCKED).move();
     if (info.get()) {
         while (!next_socket_address(info.get(), &address)) {
-            if (avs_is_ok((err = try_connect(address)))) {
+            if (avs_is_ok((err = try_connect(address)))
+                || is_in_progress(err)) {
                 goto success;
             }
         }
     }
     LOG(ERROR, "cannot establish connection to [%s]:%s", host, port);
     assert(avs_is_err(err));
+    AVS_SOCKET_TRACE(CONNECT, this, AvsSocketTrace::error_arg(err), 0);
     return err;
 success:
-    state_ = AVS_NET_SOCKET_STATE_CONNECTED;
+    AVS_SOCKET_TRACE(CONNECT, this, AvsSocketTrace::error_arg(err),
+                     address.get_port());
     if (configuration_.preferred_endpoint) {
         store_resolved_endpoint(configuration_.preferred_endpoint, address);
     }
     update_remote_endpoint(host, address);
+    if (avs_is_err(err)) {
+        // in progress; finished by finish_connect()
+        return err;
+    }
+    state_ = AVS_NET_SOCKET_STATE_CONNECTED;
+    update_local_address();
+    return AVS_OK;
+}
+
+void AvsSocket::update_local_address() {
     if (local_address_.get_ip_version() == NSAPI_UNSPEC) {
 #if PREREQ_MBED_OS(5, 15, 0)
         SocketAddress address;
-        AvsSocketGlobal::get_interface().get_ip_address(&address);
+        network_interface().get_ip_address(&address);
         local_address_.set_ip_address(address.get_ip_address());
 #else  // PREREQ_MBED_OS(5, 15, 0)
-        local_address_.set_ip_address(
-                AvsSocketGlobal::get_interface().get_ip_address());
+        local_address_.set_ip_address(network_interface().get_ip_address());
 #endif // PREREQ_MBED_OS(5, 15, 0)
     }
     if (local_address_.get_port() == 0) {
-        int32_t local_port = get_local_port(mbed_socket());
+        int32_t local_port =
+                get_local_port(network_interface(), mbed_socket());
         if (local_port > 0) {
             local_address_.set_port(local_port);
         }
     }
-    return AVS_OK;
 }
 
 avs_error_t AvsSocket::get_opt(avs_net_socket_opt_key_t option_key,
@@ -791,11 +1040,18 @@ void _avs_net_cleanup_global_compat_state(void) {}
 static int c_poll_nonblocking(struct avs_mbedos_pollfd *fds, size_t nfds) {
     int result = 0;
     for (size_t i = 0; i < nfds; ++i) {
+        const AvsSocket *socket = reinterpret_cast<const AvsSocket *>(
+                avs_net_socket_get_system(fds[i].fd));
+        short revents = 0;
         if ((fds[i].events & AVS_MBEDOS_POLLIN)
-            && reinterpret_cast<const AvsSocket *>(
-                       avs_net_socket_get_system(fds[i].fd))
-                       ->ready_to_receive()) {
-            fds[i].revents |= AVS_MBEDOS_POLLIN;
+            && socket->ready_to_receive()) {
+            revents |= AVS_MBEDOS_POLLIN;
+        }
+        if ((fds[i].events & AVS_MBEDOS_POLLOUT) && socket->ready_to_send()) {
+            revents |= AVS_MBEDOS_POLLOUT;
+        }
+        fds[i].revents = revents;
+        if (revents) {
             ++result;
         }
     }
@@ -805,14 +1061,17 @@ static int c_poll_nonblocking(struct avs_mbedos_pollfd *fds, size_t nfds) {
 int _anjay_mbedos_poll(struct avs_mbedos_pollfd *fds,
                        size_t nfds,
                        int timeout_ms) {
+    AVS_SOCKET_TRACE(POLL_BEGIN, nullptr, nfds, timeout_ms);
     reset_poll_flag();
     // any of the sockets might actually have data already buffered
     int result = c_poll_nonblocking(fds, nfds);
     if (result == 0) {
         // if not, then wait for some event
-        wait_on_poll_flag(timeout_ms >= 0 ? timeout_ms : UINT32_MAX);
+        wait_on_poll_flag_or_interrupt(timeout_ms >= 0 ? timeout_ms
+                                                       : UINT32_MAX);
         result = c_poll_nonblocking(fds, nfds);
     }
+    AVS_SOCKET_TRACE(POLL_END, nullptr, result, 0);
     return result;
 }
 
@@ -18,6 +18,9 @@
 #define AVS_SOCKET_IMPL_H
 
 #include <inttypes.h>
+#include <limits.h>
+
+#include <new>
 
 #include <Socket.h>
 
@@ -36,6 +39,13 @@
 
 #define NET_LISTEN_BACKLOG 1024
 
+// value of AvsTcpSocket::socket_timeout_ when the mode of the mbed socket is
+// not known; not a valid argument to set_timeout()
+#define SOCKET_TIMEOUT_UNKNOWN INT_MIN
+
+// maximum length of a DTLS Connection ID, see RFC 9146
+#define NET_DTLS_CID_MAX_SIZE 32
+
 #define LOG(...) avs_log(mbed_sock, __VA_ARGS__)
 
 struct avs_net_addrinfo_struct {
@@ -43,6 +53,14 @@ struct avs_net_addrinfo_struct {
     uint8_t count;
     uint8_t current_index;
     SocketAddress results[1]; // actually a VLA
+
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    // allocated from a static pool, with room for
+    // ANJAY_MBEDOS_STATIC_MAX_DNS_RESULTS results
+    static void *operator new(size_t size, const std::nothrow_t &) throw();
+    static void operator delete(void *ptr);
+    static void operator delete(void *ptr, const std::nothrow_t &) throw();
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
 };
 
 namespace avs_mbed_impl {
@@ -56,14 +74,38 @@ int next_socket_address(avs_net_addrinfo_t *addrinfo, SocketAddress *out);
 void store_resolved_endpoint(avs_net_resolved_endpoint_t *out,
                              const SocketAddress &address);
 
+size_t iov_total_length(const AvsIoVec *iov, size_t iov_count);
+
+// also accounts the copy in AvsSendVectoredStats
+void iov_gather(void *out, const AvsIoVec *iov, size_t iov_count);
+
+// accounts a gather buffer allocated for a single send in
+// AvsSendVectoredStats
+void count_temporary_gather_buffer(size_t size);
+
 bool addresses_equal(const SocketAddress &left, const SocketAddress &right);
 
+bool is_in_progress(avs_error_t err);
+
+// avs_net_addrinfo_resolve_ex() that performs DNS queries on a given interface
+avs_net_addrinfo_t *
+resolve_addrinfo(NetworkInterface &interface,
+                 avs_net_af_t family,
+                 const char *host,
+                 const char *port_str,
+                 int flags,
+                 const avs_net_resolved_endpoint_t *preferred_endpoint);
+
 void reset_poll_flag();
 
 void trigger_poll_flag();
 
+void interrupt_poll();
+
 void wait_on_poll_flag(uint32_t timeout_ms);
 
+void wait_on_poll_flag_or_interrupt(uint32_t timeout_ms);
+
 void wait_on_poll_flag(const avs_time_monotonic_t &deadline);
 
 // This is only an argument type for resolve_addrinfo() and
@@ -87,6 +129,8 @@ protected:
     SocketAddress local_address_;
     avs_net_socket_configuration_t configuration_;
     avs_time_duration_t recv_timeout_;
+    // interface selected by configuration_.interface_name
+    NetworkInterface *interface_;
 
     int get_family_for_name_resolution(
             avs_net_af_t *out,
@@ -97,8 +141,12 @@ protected:
                      bool use_preferred_endpoint,
                      preferred_family_mode_t preferred_family_mode,
                      int resolve_flags = 0) const;
-    void update_remote_endpoint(const char *hostname, SocketAddress address);
+    virtual void update_remote_endpoint(const char *hostname,
+                                        SocketAddress address);
     avs_net_af_t socket_family() const;
+    void update_local_address();
+    // May return AVS_EINPROGRESS if the socket is in non-blocking connect
+    // mode, in which case connect() does not try any further addresses.
     virtual avs_error_t try_connect(const SocketAddress &address) = 0;
     virtual avs_error_t try_bind(const SocketAddress &localaddr) = 0;
 
@@ -108,12 +156,17 @@ public:
               remote_hostname_(),
               remote_address_(),
               configuration_(),
-              recv_timeout_(AVS_NET_SOCKET_DEFAULT_RECV_TIMEOUT) {}
+              recv_timeout_(AVS_NET_SOCKET_DEFAULT_RECV_TIMEOUT),
+              interface_(nullptr) {}
 
     virtual ~AvsSocket() {}
 
     avs_error_t initialize(const avs_net_socket_configuration_t *configuration);
 
+    NetworkInterface &network_interface() const {
+        return interface_ ? *interface_ : AvsSocketGlobal::get_interface();
+    }
+
     avs_error_t receive(size_t *out_size, void *buffer, size_t buffer_length) {
         return receive_from(out_size, buffer, buffer_length, nullptr, 0,
                             nullptr, 0);
@@ -183,9 +236,17 @@ public:
     }
 
     virtual bool ready_to_receive() const = 0;
+
+    // Returns true if send() would not fail with AVS_EINPROGRESS.
+    virtual bool ready_to_send() const {
+        return state_ != AVS_NET_SOCKET_STATE_CLOSED;
+    }
+
     virtual InternetSocket *mbed_socket() const = 0;
     virtual avs_error_t connect(const char *host, const char *port);
     virtual avs_error_t send(const void *buffer, size_t length) = 0;
+    virtual avs_error_t send_vectored(const AvsIoVec *iov,
+                                      size_t iov_count) = 0;
     virtual avs_error_t send_to(const void *buffer,
                                 size_t length,
                                 const char *host,
@@ -211,24 +272,78 @@ public:
                                 avs_net_socket_opt_value_t *out_option_value);
     virtual avs_error_t set_opt(avs_net_socket_opt_key_t option_key,
                                 avs_net_socket_opt_value_t option_value);
+
+    virtual avs_error_t set_dtls_connection_id(const void *cid,
+                                               size_t cid_size) {
+        (void) cid;
+        (void) cid_size;
+        return avs_errno(AVS_ENOTSUP);
+    }
+
+    virtual avs_error_t set_pmtu_discovery(bool enabled) {
+        (void) enabled;
+        return avs_errno(AVS_ENOTSUP);
+    }
+
+    virtual avs_error_t set_nonblocking_connect(bool enabled) {
+        (void) enabled;
+        return avs_errno(AVS_ENOTSUP);
+    }
+
+    virtual avs_error_t finish_connect() {
+        return state_ == AVS_NET_SOCKET_STATE_CONNECTED
+                       ? AVS_OK
+                       : avs_errno(AVS_ENOTCONN);
+    }
 };
 
 class AvsTcpSocket : public AvsSocket {
     AvsUniquePtr<InternetSocket> socket_; // TCPSocket or TCPServer
+    // last timeout set on socket_ (0 means non-blocking, -1 means blocking),
+    // or SOCKET_TIMEOUT_UNKNOWN
+    mutable int socket_timeout_;
     uint8_t buffered_byte_;
     bool has_buffered_byte_;
+    bool nonblocking_connect_;
+    // set while a non-blocking connection attempt to remote_address_ is in
+    // progress or its result has not been collected by finish_connect() yet;
+    // socket_ is then a TCPSocket, and state_ is still CLOSED
+    bool connecting_;
+    // result of that attempt, AVS_EINPROGRESS until it is known
+    avs_error_t connect_result_;
+    // connection accepted by ready_to_receive() on a listening socket, to be
+    // returned by the next accept() without blocking, if pending_accepted_ is
+    // set; otherwise, on mbed OS < 5.10, the opened socket that the next
+    // accept attempt will accept into
+    AvsUniquePtr<InternetSocket> pending_accept_;
+    SocketAddress pending_accept_address_;
+    bool pending_accepted_;
 
     avs_error_t configure_socket();
+    void set_socket_timeout(int timeout_ms) const;
     nsapi_size_or_error_t recv_with_buffer_hack(void *data, nsapi_size_t size);
+    avs_error_t update_connect_result();
+    bool poll_accept();
 
 protected:
     virtual avs_error_t try_connect(const SocketAddress &address);
     virtual avs_error_t try_bind(const SocketAddress &localaddr);
 
 public:
-    AvsTcpSocket() : socket_(), buffered_byte_(), has_buffered_byte_(false) {}
+    AvsTcpSocket()
+            : socket_(),
+              socket_timeout_(SOCKET_TIMEOUT_UNKNOWN),
+              buffered_byte_(),
+              has_buffered_byte_(false),
+              nonblocking_connect_(false),
+              connecting_(false),
+              connect_result_(AVS_OK),
+              pending_accept_(),
+              pending_accept_address_(),
+              pending_accepted_(false) {}
 
     virtual bool ready_to_receive() const;
+    virtual bool ready_to_send() const;
 
     virtual InternetSocket *mbed_socket() const {
         return socket_.get();
@@ -236,6 +351,7 @@ public:
 
     virtual avs_error_t connect(const char *host, const char *port);
     virtual avs_error_t send(const void *buffer, size_t length);
+    virtual avs_error_t send_vectored(const AvsIoVec *iov, size_t iov_count);
 
     virtual avs_error_t send_to(const void *buffer,
                                 size_t length,
@@ -257,31 +373,97 @@ public:
                                      size_t port_str_size);
     virtual avs_error_t accept(AvsSocket *new_socket);
     virtual void close();
+    virtual avs_error_t set_nonblocking_connect(bool enabled);
+    virtual avs_error_t finish_connect();
 };
 
 class AvsUdpRouter;
 class AvsUdpRouterHandle;
 
 struct AvsUdpReceivedMessage {
+    AvsUdpReceivedMessage *next;
     SocketAddress peer;
     size_t data_size;
     uint8_t data[1]; // actually a FAM
 };
 
+// FIFO of received datagrams, linked through AvsUdpReceivedMessage::next, so
+// that queueing a datagram does not allocate anything besides the message
+// itself. The queue does not own the messages; they are freed by whoever pops
+// them.
+class AvsUdpReceiveQueue {
+    AvsUdpReceivedMessage *head_;
+    AvsUdpReceivedMessage **tail_;
+
+    AvsUdpReceiveQueue(const AvsUdpReceiveQueue &);
+    AvsUdpReceiveQueue &operator=(const AvsUdpReceiveQueue &);
+
+public:
+    AvsUdpReceiveQueue() : head_(nullptr), tail_(&head_) {}
+
+    bool empty() const {
+        return !head_;
+    }
+
+    AvsUdpReceivedMessage *front() const {
+        return head_;
+    }
+
+    size_t size() const {
+        size_t result = 0;
+        for (const AvsUdpReceivedMessage *msg = head_; msg; msg = msg->next) {
+            ++result;
+        }
+        return result;
+    }
+
+    void push_back(AvsUdpReceivedMessage *msg) {
+        msg->next = nullptr;
+        *tail_ = msg;
+        tail_ = &msg->next;
+    }
+
+    AvsUdpReceivedMessage *pop_front() {
+        AvsUdpReceivedMessage *msg = head_;
+        if (msg && !(head_ = msg->next)) {
+            tail_ = &head_;
+        }
+        return msg;
+    }
+};
+
 class AvsUdpSocket : public AvsSocket {
     friend class AvsUdpRouter;
-    avs::List<AvsUdpReceivedMessage> recvd_msgs_;
-
-    void get_router(AvsUdpRouterHandle &out) const;
-    avs_error_t ensure_router(AvsUdpRouterHandle &out);
+    // router this socket is registered in, maintained by the router itself;
+    // holds a reference to the router while non-null
+    AvsUdpRouter *router_;
+    AvsUdpReceiveQueue recvd_msgs_;
+    uint8_t dtls_cid_[NET_DTLS_CID_MAX_SIZE];
+    uint8_t dtls_cid_size_;
+    bool pmtu_discovery_;
+
+    avs_error_t ensure_router();
+    avs_error_t get_connected_address(SocketAddress *out);
     avs_error_t get_udp_overhead(int *out);
     int get_fallback_inner_mtu() const;
+    void pmtu_on_sent(const SocketAddress &address,
+                      size_t length,
+                      avs_error_t err);
 
 protected:
+    virtual void update_remote_endpoint(const char *hostname,
+                                        SocketAddress address);
     virtual avs_error_t try_connect(const SocketAddress &address);
     virtual avs_error_t try_bind(const SocketAddress &localaddr);
 
 public:
+    AvsUdpSocket()
+            : router_(nullptr),
+              recvd_msgs_(),
+              dtls_cid_(),
+              dtls_cid_size_(0),
+              pmtu_discovery_(false) {}
+
     virtual ~AvsUdpSocket() {
         close();
     }
@@ -289,6 +471,7 @@ public:
     virtual bool ready_to_receive() const;
     virtual InternetSocket *mbed_socket() const;
     virtual avs_error_t send(const void *buffer, size_t length);
+    virtual avs_error_t send_vectored(const AvsIoVec *iov, size_t iov_count);
     virtual avs_error_t send_to(const void *buffer,
                                 size_t length,
                                 const char *host,
@@ -304,6 +487,9 @@ public:
     virtual void close();
     virtual avs_error_t get_opt(avs_net_socket_opt_key_t option_key,
                                 avs_net_socket_opt_value_t *out_option_value);
+    virtual avs_error_t set_dtls_connection_id(const void *cid,
+                                               size_t cid_size);
+    virtual avs_error_t set_pmtu_discovery(bool enabled);
 };
 
 } // namespace avs_mbed_impl
@@ -19,11 +19,14 @@
 
 #include "avs_mbed_hacks.h"
 #include "avs_socket_impl.h"
+#include "avs_socket_trace.h"
+#include "avs_static_pool.h"
 
 #if !PREREQ_MBED_OS(5, 10, 0)
 #include <TCPServer.h>
 #endif // !PREREQ_MBED_OS(5, 10, 0)
 #include <TCPSocket.h>
+#include <mbed_critical.h>
 
 using namespace avs_mbed_hacks;
 using namespace avs_mbed_impl;
@@ -32,10 +35,118 @@ using namespace std;
 
 namespace avs_mbed_impl {
 
+namespace {
+
+volatile uint32_t SOCKET_MODE_CHANGES_APPLIED = 0;
+volatile uint32_t SOCKET_MODE_CHANGES_SKIPPED = 0;
+
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+#if PREREQ_MBED_OS(5, 10, 0)
+AVS_STATIC_POOL_DEFINE(TCP_SOCKETS,
+                       sizeof(TCPSocket),
+                       ANJAY_MBEDOS_STATIC_MAX_TCP_SOCKETS);
+#else  // mbed OS < 5.10
+AVS_STATIC_POOL_DEFINE(TCP_SOCKETS,
+                       sizeof(TCPSocket) > sizeof(TCPServer)
+                               ? sizeof(TCPSocket)
+                               : sizeof(TCPServer),
+                       ANJAY_MBEDOS_STATIC_MAX_TCP_SOCKETS);
+#endif // PREREQ_MBED_OS(5, 10, 0)
+
+// mbed socket allocated from TCP_SOCKETS. mbed sockets are only ever deleted
+// through a pointer to InternetSocket, which has a virtual destructor, so the
+// operator delete of the actual class is always used.
+template <typename Base>
+class PooledSocket : public Base {
+public:
+    static void *operator new(size_t size, const nothrow_t &) throw() {
+        MBED_ASSERT(size <= TCP_SOCKETS.block_size);
+        return TCP_SOCKETS.allocate();
+    }
+
+    static void operator delete(void *ptr) {
+        TCP_SOCKETS.free(ptr);
+    }
+
+    static void operator delete(void *ptr, const nothrow_t &) throw() {
+        TCP_SOCKETS.free(ptr);
+    }
+};
+
+typedef PooledSocket<TCPSocket> NewTcpSocket;
+#if !PREREQ_MBED_OS(5, 10, 0)
+typedef PooledSocket<TCPServer> NewTcpServer;
+#endif // !PREREQ_MBED_OS(5, 10, 0)
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+typedef TCPSocket NewTcpSocket;
+#if !PREREQ_MBED_OS(5, 10, 0)
+typedef TCPServer NewTcpServer;
+#endif // !PREREQ_MBED_OS(5, 10, 0)
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+
+// Accepts a connection on a listening socket, according to its current
+// blocking mode and timeout, and stores it in @p socket, which MUST be NULL on
+// mbed OS >= 5.10.
+//
+// On mbed OS < 5.10, TCPServer::accept() needs an opened TCPSocket to accept
+// into. If @p socket is NULL, it is opened first, and it is left open if no
+// connection could be accepted, so that non-blocking attempts (i.e. polls) do
+// not allocate, open and close a new socket each time. *out_addr is only
+// filled on these versions.
+nsapi_error_t accept_connection(AvsUniquePtr<InternetSocket> &socket,
+                                InternetSocket *listener,
+                                NetworkInterface &interface,
+                                SocketAddress *out_addr) {
+    nsapi_error_t err;
+#if PREREQ_MBED_OS(5, 10, 0)
+    (void) interface;
+    (void) out_addr;
+    MBED_ASSERT(!socket.get());
+    socket.reset(static_cast<TCPSocket *>(listener)->accept(&err));
+    if (!err && !socket.get()) {
+        err = NSAPI_ERROR_NO_MEMORY;
+    }
+#else  // mbed OS < 5.10
+    if (!socket.get()) {
+        AvsUniquePtr<TCPSocket> new_socket(new (nothrow) NewTcpSocket());
+        if (!new_socket.get()) {
+            return NSAPI_ERROR_NO_MEMORY;
+        }
+        if ((err = new_socket->open(&interface))) {
+            return err;
+        }
+        socket.reset(new_socket.release());
+    }
+    err = static_cast<TCPServer *>(listener)->accept(
+            static_cast<TCPSocket *>(socket.get()), out_addr);
+#endif // PREREQ_MBED_OS(5, 10, 0)
+    if (!err) {
+        socket->sigio(callback(trigger_poll_flag));
+    }
+    return err;
+}
+
+} // namespace
+
+// With offloaded network stacks (e.g. AT command based cellular modems),
+// changing the blocking mode or timeout of a socket may involve more than
+// setting a field, and it is done on every send, receive and poll, so it is
+// only done if the mode actually changes.
+void AvsTcpSocket::set_socket_timeout(int timeout_ms) const {
+    MBED_ASSERT(socket_.get());
+    if (timeout_ms == socket_timeout_) {
+        core_util_atomic_incr_u32(&SOCKET_MODE_CHANGES_SKIPPED, 1);
+        return;
+    }
+    socket_->set_timeout(timeout_ms);
+    socket_timeout_ = timeout_ms;
+    core_util_atomic_incr_u32(&SOCKET_MODE_CHANGES_APPLIED, 1);
+}
+
 avs_error_t AvsTcpSocket::configure_socket() {
     // configuration not really supported...
-    if (configuration_.interface_name[0] || configuration_.priority
-        || configuration_.dscp || configuration_.transparent) {
+    if (configuration_.priority || configuration_.dscp
+        || configuration_.transparent) {
         return avs_errno(AVS_EINVAL);
     }
     return AVS_OK;
@@ -98,12 +209,12 @@ avs_error_t AvsTcpSocket::try_connect(const SocketAddress &address) {
         return avs_errno(AVS_EISCONN);
     }
     MBED_ASSERT(!socket_.get());
-    AvsUniquePtr<TCPSocket> new_socket(new (nothrow) TCPSocket());
+    AvsUniquePtr<TCPSocket> new_socket(new (nothrow) NewTcpSocket());
     if (!new_socket.get()) {
         LOG(ERROR, "cannot create socket");
         return avs_errno(AVS_ENOMEM);
     }
-    nsapi_error_t nserr = new_socket->open(&AvsSocketGlobal::get_interface());
+    nsapi_error_t nserr = new_socket->open(&network_interface());
     if (nserr) {
         LOG(ERROR, "cannot open socket");
         return avs_errno(nsapi_error_to_errno(nserr));
@@ -114,9 +225,18 @@ avs_error_t AvsTcpSocket::try_connect(const SocketAddress &address) {
         return err;
     }
     new_socket->sigio(callback(trigger_poll_flag));
-    new_socket->set_timeout(NET_CONNECT_TIMEOUT_MS);
+    const int timeout_ms = nonblocking_connect_ ? 0 : NET_CONNECT_TIMEOUT_MS;
+    new_socket->set_timeout(timeout_ms);
     nserr = new_socket->connect(address);
-    if (nserr) {
+    if (nserr == NSAPI_ERROR_IN_PROGRESS && nonblocking_connect_) {
+        // sigio will trigger the poll flag once the attempt is finished
+        socket_ = new_socket.move();
+        socket_timeout_ = timeout_ms;
+        connecting_ = true;
+        connect_result_ = avs_errno(AVS_EINPROGRESS);
+        return connect_result_;
+    }
+    if (nserr && nserr != NSAPI_ERROR_IS_CONNECTED) {
         return avs_errno(nsapi_error_to_errno(nserr));
     }
 
@@ -127,10 +247,66 @@ avs_error_t AvsTcpSocket::try_connect(const SocketAddress &address) {
     }
 
     socket_ = new_socket.move();
+    socket_timeout_ = timeout_ms;
+    return AVS_OK;
+}
+
+avs_error_t AvsTcpSocket::update_connect_result() {
+    MBED_ASSERT(connecting_);
+    if (!is_in_progress(connect_result_)) {
+        return connect_result_;
+    }
+    TCPSocket *tcp_socket = static_cast<TCPSocket *>(socket_.get());
+    // Mbed OS reports the progress of a non-blocking connection attempt when
+    // connect() is called again with the same address
+    nsapi_error_t nserr = tcp_socket->connect(remote_address_);
+    if (nserr == NSAPI_ERROR_IN_PROGRESS || nserr == NSAPI_ERROR_ALREADY
+        || nserr == NSAPI_ERROR_WOULD_BLOCK) {
+        return connect_result_;
+    }
+    if (nserr == NSAPI_ERROR_IS_CONNECTED) {
+        nserr = NSAPI_ERROR_OK;
+    }
+    if (!nserr) {
+        // check if connection is really usable
+        nserr = tcp_socket->send(nullptr, 0);
+    }
+    connect_result_ =
+            nserr ? avs_errno(nsapi_error_to_errno(nserr)) : AVS_OK;
+    return connect_result_;
+}
+
+avs_error_t AvsTcpSocket::finish_connect() {
+    if (!connecting_) {
+        return AvsSocket::finish_connect();
+    }
+    avs_error_t err = update_connect_result();
+    if (is_in_progress(err)) {
+        return err;
+    }
+    connecting_ = false;
+    AVS_SOCKET_TRACE(CONNECT, this, AvsSocketTrace::error_arg(err),
+                     remote_address_.get_port());
+    if (avs_is_err(err)) {
+        LOG(ERROR, "cannot establish connection to [%s]:%" PRIu16,
+            remote_address_.get_ip_address(), remote_address_.get_port());
+        close();
+        return err;
+    }
+    state_ = AVS_NET_SOCKET_STATE_CONNECTED;
+    update_local_address();
+    return AVS_OK;
+}
+
+avs_error_t AvsTcpSocket::set_nonblocking_connect(bool enabled) {
+    nonblocking_connect_ = enabled;
     return AVS_OK;
 }
 
 avs_error_t AvsTcpSocket::connect(const char *host, const char *port) {
+    if (connecting_) {
+        return avs_errno(AVS_EALREADY);
+    }
     if (socket_.get()) {
         LOG(ERROR, "socket is already connected or bound");
         return avs_errno(AVS_EISCONN);
@@ -138,34 +314,66 @@ avs_error_t AvsTcpSocket::connect(const char *host, const char *port) {
     return AvsSocket::connect(host, port);
 }
 
+bool AvsTcpSocket::poll_accept() {
+    if (pending_accepted_) {
+        return true;
+    }
+    set_socket_timeout(0);
+    nsapi_error_t err =
+            accept_connection(pending_accept_, socket_.get(),
+                              network_interface(), &pending_accept_address_);
+    pending_accepted_ = !err;
+    AVS_SOCKET_TRACE(READY, this, pending_accepted_, err);
+    return pending_accepted_;
+}
+
 bool AvsTcpSocket::ready_to_receive() const {
+    if (state_ == AVS_NET_SOCKET_STATE_BOUND) {
+        // listening socket; ready if there is a connection to accept
+        return const_cast<AvsTcpSocket *>(this)->poll_accept();
+    }
     if (state_ == AVS_NET_SOCKET_STATE_ACCEPTED
         || state_ == AVS_NET_SOCKET_STATE_CONNECTED) {
-        MBED_ASSERT(socket_.get());
-        socket_->set_blocking(false);
+        set_socket_timeout(0);
         nsapi_size_or_error_t result =
                 const_cast<AvsTcpSocket *>(this)->recv_with_buffer_hack(nullptr,
                                                                         0);
-        LOG(DEBUG, "result == %d", (int) result);
+        AVS_SOCKET_TRACE(READY, this, result == NSAPI_ERROR_OK, result);
         return result == NSAPI_ERROR_OK;
     }
-    // TODO: support TCPServer
     return false;
 }
 
+bool AvsTcpSocket::ready_to_send() const {
+    if (connecting_) {
+        // a failed attempt counts as well, so that the error can be collected
+        // using finish_connect(), as with POSIX sockets
+        return !is_in_progress(
+                const_cast<AvsTcpSocket *>(this)->update_connect_result());
+    }
+    return state_ == AVS_NET_SOCKET_STATE_ACCEPTED
+           || state_ == AVS_NET_SOCKET_STATE_CONNECTED;
+}
+
 avs_error_t AvsTcpSocket::send(const void *buffer, size_t buffer_length) {
+    if (connecting_) {
+        avs_error_t err = finish_connect();
+        if (avs_is_err(err)) {
+            return err;
+        }
+    }
     if (state_ != AVS_NET_SOCKET_STATE_ACCEPTED
         && state_ != AVS_NET_SOCKET_STATE_CONNECTED) {
         LOG(ERROR, "attempted send() on a socket not created");
         return avs_errno(AVS_EBADF);
     }
-    MBED_ASSERT(socket_.get());
-    socket_->set_timeout(NET_SEND_TIMEOUT_MS);
+    set_socket_timeout(NET_SEND_TIMEOUT_MS);
 
     // only a client socket can be in ACCEPTED or CONNECTED state,
     // so socket_ must be a TCPSocket
     nsapi_size_or_error_t result = static_cast<TCPSocket *>(socket_.get())
                                            ->send(buffer, buffer_length);
+    AVS_SOCKET_TRACE(SEND, this, buffer_length, result < 0 ? result : 0);
     if (result < 0) {
         return avs_errno(nsapi_error_to_errno(result));
     } else if ((size_t) result < buffer_length) {
@@ -178,6 +386,21 @@ avs_error_t AvsTcpSocket::send(const void *buffer, size_t buffer_length) {
     }
 }
 
+avs_error_t AvsTcpSocket::send_vectored(const AvsIoVec *iov,
+                                        size_t iov_count) {
+    // TCP is a byte stream, so the buffers can be passed to the network stack
+    // one by one, without assembling them first
+    for (size_t i = 0; i < iov_count; ++i) {
+        if (iov[i].length) {
+            avs_error_t err = send(iov[i].base, iov[i].length);
+            if (avs_is_err(err)) {
+                return err;
+            }
+        }
+    }
+    return AVS_OK;
+}
+
 avs_error_t AvsTcpSocket::receive_from(size_t *out_size,
                                        void *buffer,
                                        size_t buffer_length,
@@ -185,6 +408,12 @@ avs_error_t AvsTcpSocket::receive_from(size_t *out_size,
                                        size_t host_size,
                                        char *port_str,
                                        size_t port_str_size) {
+    if (connecting_) {
+        avs_error_t err = finish_connect();
+        if (avs_is_err(err)) {
+            return err;
+        }
+    }
     if (state_ != AVS_NET_SOCKET_STATE_ACCEPTED
         && state_ != AVS_NET_SOCKET_STATE_CONNECTED) {
         LOG(ERROR, "attempted receive_from() on a socket not created");
@@ -205,8 +434,7 @@ avs_error_t AvsTcpSocket::receive_from(size_t *out_size,
     }
     avs_time_monotonic_t deadline =
             avs_time_monotonic_add(avs_time_monotonic_now(), recv_timeout_);
-    static_cast<TCPSocket *>(socket_.get())
-            ->set_blocking(!avs_time_monotonic_valid(deadline));
+    set_socket_timeout(avs_time_monotonic_valid(deadline) ? 0 : -1);
     reset_poll_flag();
     nsapi_size_or_error_t result = recv_with_buffer_hack(buffer, buffer_length);
     while (result == NSAPI_ERROR_WOULD_BLOCK
@@ -215,6 +443,8 @@ avs_error_t AvsTcpSocket::receive_from(size_t *out_size,
         result = recv_with_buffer_hack(buffer, buffer_length);
         reset_poll_flag();
     }
+    AVS_SOCKET_TRACE(RECV, this, result < 0 ? 0 : result,
+                     result < 0 ? result : 0);
     if (result < 0) {
         return avs_errno(nsapi_error_to_errno(result));
     } else {
@@ -235,15 +465,15 @@ avs_error_t AvsTcpSocket::try_bind(const SocketAddress &localaddr) {
     }
 
 #if PREREQ_MBED_OS(5, 10, 0)
-    AvsUniquePtr<TCPSocket> socket(new (nothrow) TCPSocket());
+    AvsUniquePtr<TCPSocket> socket(new (nothrow) NewTcpSocket());
 #else // mbed OS < 5.10
-    AvsUniquePtr<TCPServer> socket(new (nothrow) TCPServer());
+    AvsUniquePtr<TCPServer> socket(new (nothrow) NewTcpServer());
 #endif
     if (!socket.get()) {
         LOG(ERROR, "cannot create TCPServer");
         return avs_errno(AVS_ENOMEM);
     }
-    nsapi_error_t nserr = socket->open(&AvsSocketGlobal::get_interface());
+    nsapi_error_t nserr = socket->open(&network_interface());
     if (nserr) {
         LOG(ERROR, "cannot open socket");
         return avs_errno(nsapi_error_to_errno(nserr));
@@ -269,10 +499,11 @@ avs_error_t AvsTcpSocket::try_bind(const SocketAddress &localaddr) {
         return avs_errno(nsapi_error_to_errno(nserr));
     }
     socket_ = socket.move();
+    socket_timeout_ = SOCKET_TIMEOUT_UNKNOWN;
     state_ = AVS_NET_SOCKET_STATE_BOUND;
     local_address_ = localaddr;
     if (local_address_.get_port() == 0) {
-        int32_t port = get_local_port(socket_.get());
+        int32_t port = get_local_port(network_interface(), socket_.get());
         if (port < 0) {
             LOG(ERROR, "socket was bound to an invalid port");
             return avs_errno(AVS_EINVAL);
@@ -301,37 +532,36 @@ avs_error_t AvsTcpSocket::accept(AvsSocket *new_socket_) {
     MBED_ASSERT(socket_.get());
 
     SocketAddress addr;
-    socket_->set_timeout(NET_ACCEPT_TIMEOUT_MS);
-    nsapi_error_t err = 0;
-#if PREREQ_MBED_OS(5, 10, 0)
-    AvsUniquePtr<TCPSocket> new_mbed_socket(
-            static_cast<TCPSocket *>(socket_.get())->accept(&err));
-#else // mbed OS < 5.10
-    AvsUniquePtr<TCPSocket> new_mbed_socket(new (nothrow) TCPSocket());
-    if (new_mbed_socket.get()) {
-        err = new_mbed_socket->open(&AvsSocketGlobal::get_interface());
-        if (!err) {
-            err = static_cast<TCPServer *>(socket_.get())
-                          ->accept(new_mbed_socket.get(), &addr);
-        }
-    }
-#endif
-    if (!new_mbed_socket.get()) {
-        return avs_errno(AVS_ENOMEM);
+    nsapi_error_t err = NSAPI_ERROR_OK;
+    if (pending_accepted_) {
+        // already accepted when polling, so that this does not block
+        addr = pending_accept_address_;
+    } else {
+        set_socket_timeout(NET_ACCEPT_TIMEOUT_MS);
+        err = accept_connection(pending_accept_, socket_.get(),
+                                network_interface(), &addr);
     }
+    AVS_SOCKET_TRACE(ACCEPT, this, err, addr.get_port());
     if (err) {
         return avs_errno(nsapi_error_to_errno(err));
     }
-    new_mbed_socket->sigio(callback(trigger_poll_flag));
-    new_socket->socket_ = new_mbed_socket.move();
+    pending_accepted_ = false;
+    new_socket->socket_ = pending_accept_.move();
+    new_socket->socket_timeout_ = SOCKET_TIMEOUT_UNKNOWN;
     new_socket->state_ = AVS_NET_SOCKET_STATE_ACCEPTED;
     new_socket->update_remote_endpoint(addr.get_ip_address(), addr);
     new_socket->local_address_ = local_address_;
+    new_socket->interface_ = interface_;
     return AVS_OK;
 }
 
 void AvsTcpSocket::close() {
+    AVS_SOCKET_TRACE(CLOSE, this, 0, 0);
+    pending_accept_.reset();
+    pending_accepted_ = false;
     socket_.reset();
+    socket_timeout_ = SOCKET_TIMEOUT_UNKNOWN;
+    connecting_ = false;
     state_ = AVS_NET_SOCKET_STATE_CLOSED;
     local_address_ = SocketAddress();
     // avs_commons' contract requires that the remote port is not reset when
@@ -341,3 +571,13 @@ void AvsTcpSocket::close() {
 }
 
 } // namespace avs_mbed_impl
+
+void AvsSocketGlobal::get_socket_mode_stats(AvsSocketModeStats *out) {
+    out->applied = atomic_load_u32(&SOCKET_MODE_CHANGES_APPLIED);
+    out->skipped = atomic_load_u32(&SOCKET_MODE_CHANGES_SKIPPED);
+}
+
+void AvsSocketGlobal::reset_socket_mode_stats() {
+    atomic_store_u32(&SOCKET_MODE_CHANGES_APPLIED, 0);
+    atomic_store_u32(&SOCKET_MODE_CHANGES_SKIPPED, 0);
+}
@@ -17,49 +17,572 @@
 #include <algorithm>
 
 #include <UDPSocket.h>
+#include <mbed_critical.h>
 #include <mbed_error.h>
 
 #include <avsystem/commons/avs_commons_config.h>
 #include <avsystem/commons/avs_errno.h>
-#include <avsystem/commons/avs_list_cxx.hpp>
+#include <avsystem/commons/avs_memory.h>
 
 #include "avs_mbed_hacks.h"
+#include "avs_mbed_threading_structs.h"
+#include "avs_pmtu_cache.h"
+#include "avs_small_vector.h"
 #include "avs_socket_impl.h"
+#include "avs_socket_trace.h"
+#include "avs_static_pool.h"
+
+#if PREREQ_MBED_OS(5, 6, 0)
+#include "avs_udp_rx_thread.h"
+#else  // mbed OS < 5.6 does not have EventFlags, so there is no RX thread
+class AvsUdpRxThread {
+public:
+    static AvsUdpRxThread *const INSTANCE;
+
+    size_t buffer_size_;
+    uint8_t *buffer_;
+
+    void wake_up() {}
+};
+
+AvsUdpRxThread *const AvsUdpRxThread::INSTANCE = nullptr;
+#endif // PREREQ_MBED_OS(5, 6, 0)
 
 using namespace avs_mbed_hacks;
 using namespace avs_mbed_impl;
 using namespace mbed;
+using namespace rtos;
 using namespace std;
 
 namespace avs_mbed_impl {
 
+namespace {
+
+MBED_STATIC_ASSERT((ANJAY_MBEDOS_UDP_RX_RING_SIZE
+                    & (ANJAY_MBEDOS_UDP_RX_RING_SIZE - 1))
+                           == 0,
+                   "ANJAY_MBEDOS_UDP_RX_RING_SIZE must be a power of two");
+
+const uint32_t RX_RING_MASK = ANJAY_MBEDOS_UDP_RX_RING_SIZE - 1;
+
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+const size_t ROUTERS_INLINE = ANJAY_MBEDOS_STATIC_MAX_UDP_ROUTERS;
+const size_t ROUTER_SOCKETS_INLINE = ANJAY_MBEDOS_STATIC_MAX_SOCKETS;
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+const size_t ROUTERS_INLINE = ANJAY_MBEDOS_UDP_ROUTERS_INLINE;
+const size_t ROUTER_SOCKETS_INLINE = ANJAY_MBEDOS_UDP_ROUTER_SOCKETS_INLINE;
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+
+// Entry of the router table. The local port never changes once the router is
+// in the table, so it is stored inline, and lookups only dereference routers
+// bound to the right port.
+struct RouterTableEntry {
+    uint16_t port;
+    AvsUdpRouter *router;
+};
+
+typedef AvsSmallVector<RouterTableEntry, ROUTERS_INLINE> RouterTable;
+typedef AvsSmallVector<AvsUdpSocket *, ROUTER_SOCKETS_INLINE> SocketTable;
+
+// DTLS 1.2 record with a Connection ID (RFC 9146, section 4):
+// content type (1 byte) = tls12_cid (25), version (2 bytes) = {254, 253},
+// epoch (2 bytes), sequence number (6 bytes), connection ID (variable),
+// length (2 bytes)
+const uint8_t DTLS_CONTENT_TYPE_TLS12_CID = 25;
+const size_t DTLS_CID_OFFSET = 11;
+
+bool dtls_record_has_cid(const uint8_t *data,
+                         size_t size,
+                         const uint8_t *cid,
+                         size_t cid_size) {
+    if (!cid_size || size < DTLS_CID_OFFSET + cid_size + 2
+        || data[0] != DTLS_CONTENT_TYPE_TLS12_CID || data[1] != 254
+        || data[2] != 253
+        || memcmp(&data[DTLS_CID_OFFSET], cid, cid_size) != 0) {
+        return false;
+    }
+    size_t length = ((size_t) data[DTLS_CID_OFFSET + cid_size] << 8)
+                    | data[DTLS_CID_OFFSET + cid_size + 1];
+    return DTLS_CID_OFFSET + cid_size + 2 + length <= size;
+}
+
+// Signalled by sigio of a single router's backend socket. Unlike the global
+// poll flag, it is only waited on by the thread that currently reads from that
+// socket, so its wakeups cannot be consumed by threads waiting for unrelated
+// sockets.
+class SigioEvent {
+#if PREREQ_MBED_OS(5, 6, 0)
+    EventFlags flags_;
+#else  // mbed OS < 5.6 does not have EventFlags
+    Semaphore sem_;
+#endif // PREREQ_MBED_OS(5, 6, 0)
+
+    SigioEvent(const SigioEvent &);
+    SigioEvent &operator=(const SigioEvent &);
+
+public:
+#if PREREQ_MBED_OS(5, 6, 0)
+    SigioEvent() : flags_() {}
+#else  // PREREQ_MBED_OS(5, 6, 0)
+    SigioEvent() : sem_(0) {}
+#endif // PREREQ_MBED_OS(5, 6, 0)
+
+    void reset() {
+#if PREREQ_MBED_OS(5, 6, 0)
+        flags_.clear(1);
+#else  // PREREQ_MBED_OS(5, 6, 0)
+        while (sem_.wait(0) > 0)
+            ;
+#endif // PREREQ_MBED_OS(5, 6, 0)
+    }
+
+    void trigger() {
+#if PREREQ_MBED_OS(5, 6, 0)
+        flags_.set(1);
+#else  // PREREQ_MBED_OS(5, 6, 0)
+        sem_.release();
+#endif // PREREQ_MBED_OS(5, 6, 0)
+    }
+
+    void wait(const avs_time_monotonic_t &deadline) {
+        uint32_t timeout_ms = osWaitForever;
+        int64_t remaining_ms;
+        if (!avs_time_duration_to_scalar(
+                    &remaining_ms, AVS_TIME_MS,
+                    avs_time_monotonic_diff(deadline,
+                                            avs_time_monotonic_now()))) {
+            if (remaining_ms <= 0) {
+                return;
+            }
+            timeout_ms = (uint32_t) min(remaining_ms,
+                                        (int64_t) osWaitForever - 1);
+        }
+#if PREREQ_MBED_OS(5, 6, 0)
+        flags_.wait_any(1, timeout_ms);
+#else  // PREREQ_MBED_OS(5, 6, 0)
+        sem_.wait(timeout_ms);
+#endif // PREREQ_MBED_OS(5, 6, 0)
+    }
+};
+
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+AVS_STATIC_POOL_DEFINE(RECEIVED_MESSAGES,
+                       offsetof(AvsUdpReceivedMessage, data)
+                               + ANJAY_MBEDOS_STATIC_RECV_BUFFER_SIZE,
+                       ANJAY_MBEDOS_STATIC_MAX_QUEUED_DATAGRAMS);
+
+// the RX thread buffer; only one AvsUdpRxThread may exist at a time
+uint8_t RX_THREAD_BUFFER_POOL_STORAGE[ANJAY_MBEDOS_STATIC_RECV_BUFFER_SIZE];
+
+// routers never have buffers of their own in this mode
+MBED_STATIC_ASSERT(ANJAY_MBEDOS_STATIC_RECV_BUFFERS >= 1,
+                   "ANJAY_MBEDOS_STATIC_RECV_BUFFERS must be at least 1");
+
+// see SharedBufferPool
+uint8_t SHARED_BUFFERS_POOL_STORAGE[ANJAY_MBEDOS_STATIC_RECV_BUFFERS]
+                                   [ANJAY_MBEDOS_STATIC_RECV_BUFFER_SIZE];
+uint8_t *SHARED_BUFFERS_FREE_LIST_POOL_STORAGE
+        [ANJAY_MBEDOS_STATIC_RECV_BUFFERS];
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+
+// Received datagrams are stored as standalone AvsUdpReceivedMessage objects,
+// linked directly into the receive queues of sockets. Those handed off by the
+// RX thread are allocated by it, and queued as they are once the router
+// dispatches them.
+AvsUdpReceivedMessage *new_received_message(const SocketAddress &peer,
+                                            const uint8_t *data,
+                                            size_t size) {
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    MBED_ASSERT(offsetof(AvsUdpReceivedMessage, data) + size
+                <= RECEIVED_MESSAGES.block_size);
+    AvsUdpReceivedMessage *msg = reinterpret_cast<AvsUdpReceivedMessage *>(
+            RECEIVED_MESSAGES.allocate());
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    AvsUdpReceivedMessage *msg = reinterpret_cast<AvsUdpReceivedMessage *>(
+            avs_malloc(offsetof(AvsUdpReceivedMessage, data) + size));
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    if (msg) {
+        msg->next = nullptr;
+        new (&msg->peer) SocketAddress(peer);
+        msg->data_size = size;
+        memcpy(msg->data, data, size);
+    }
+    return msg;
+}
+
+void delete_received_message(AvsUdpReceivedMessage *msg) {
+    if (msg) {
+        msg->peer.~SocketAddress();
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+        RECEIVED_MESSAGES.free(msg);
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+        avs_free(msg);
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    }
+}
+
+// Buffers owned by individual routers are never allocated in the static
+// allocation mode; SHARED_BUFFERS is always used instead.
+uint8_t *new_buffer(size_t size) {
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    (void) size;
+    return nullptr;
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    return new (nothrow) uint8_t[size];
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+}
+
+void delete_buffer(uint8_t *buffer) {
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    MBED_ASSERT(!buffer);
+    (void) buffer;
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    delete[] buffer;
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+}
+
+// Receive buffers shared by all routers that are not drained by the RX thread,
+// see AvsSocketGlobal::set_shared_recv_buffers(). A buffer is only borrowed
+// for the duration of a single non-blocking recvfrom() or sendto() and of
+// copying the datagram, so a handful of them is enough for any number of
+// routers. The pool is only reconfigured while no routers exist. In the static
+// allocation mode, it is carved out of SHARED_BUFFERS_POOL_STORAGE instead of
+// the heap.
+class SharedBufferPool {
+    avs_mutex mutex_;
+    avs_condvar released_;
+    uint8_t *storage_;
+    uint8_t **free_;
+    size_t count_;
+    size_t free_count_;
+    size_t buffer_size_;
+
+    SharedBufferPool(const SharedBufferPool &);
+    SharedBufferPool &operator=(const SharedBufferPool &);
+
+    bool wait_until_available_locked(const avs_time_monotonic_t &deadline) {
+        while (!free_count_) {
+            if (!avs_time_monotonic_before(avs_time_monotonic_now(), deadline)
+                || avs_condvar_wait(&released_, &mutex_, deadline)
+                           == AVS_CONDVAR_TIMEOUT) {
+                break;
+            }
+        }
+        return free_count_ > 0;
+    }
+
+public:
+    SharedBufferPool()
+            : mutex_(),
+              released_(),
+              storage_(nullptr),
+              free_(nullptr),
+              count_(0),
+              free_count_(0),
+              buffer_size_(0) {}
+
+    bool enabled() const {
+        return count_ > 0;
+    }
+
+    size_t footprint() const {
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+        return sizeof(SHARED_BUFFERS_POOL_STORAGE)
+               + sizeof(SHARED_BUFFERS_FREE_LIST_POOL_STORAGE);
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+        return count_ * (buffer_size_ + sizeof(*free_));
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    }
+
+    avs_error_t reset(size_t count, size_t buffer_size) {
+        MBED_ASSERT(free_count_ == count_);
+        uint8_t *storage = nullptr;
+        uint8_t **free_list = nullptr;
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+        if (count > ANJAY_MBEDOS_STATIC_RECV_BUFFERS
+            || buffer_size > ANJAY_MBEDOS_STATIC_RECV_BUFFER_SIZE) {
+            return avs_errno(AVS_ENOMEM);
+        }
+        if (count) {
+            storage = &SHARED_BUFFERS_POOL_STORAGE[0][0];
+            free_list = SHARED_BUFFERS_FREE_LIST_POOL_STORAGE;
+        }
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+        if (count
+            && (!(storage = new (nothrow) uint8_t[count * buffer_size])
+                || !(free_list = new (nothrow) uint8_t *[count]))) {
+            delete[] storage;
+            return avs_errno(AVS_ENOMEM);
+        }
+        delete[] storage_;
+        delete[] free_;
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+        storage_ = storage;
+        free_ = free_list;
+        count_ = count;
+        free_count_ = count;
+        buffer_size_ = buffer_size;
+        for (size_t i = 0; i < count; ++i) {
+            free_[i] = &storage_[i * buffer_size];
+        }
+        return AVS_OK;
+    }
+
+    // Returns NULL if no buffer is available right now.
+    uint8_t *try_acquire() {
+        return acquire(avs_time_monotonic_now());
+    }
+
+    // Waits until a buffer is available, or returns NULL if none is by
+    // @p deadline.
+    uint8_t *acquire(const avs_time_monotonic_t &deadline) {
+        MBED_ASSERT(enabled());
+        avs_mutex_lock(&mutex_);
+        uint8_t *buffer = nullptr;
+        if (wait_until_available_locked(deadline)) {
+            buffer = free_[--free_count_];
+        }
+        avs_mutex_unlock(&mutex_);
+        return buffer;
+    }
+
+    // Waits until a buffer is available, without taking it, or until
+    // @p deadline passes.
+    void wait_until_available(const avs_time_monotonic_t &deadline) {
+        avs_mutex_lock(&mutex_);
+        wait_until_available_locked(deadline);
+        avs_mutex_unlock(&mutex_);
+    }
+
+    void release(uint8_t *buffer) {
+        avs_mutex_lock(&mutex_);
+        MBED_ASSERT(free_count_ < count_);
+        free_[free_count_++] = buffer;
+        avs_condvar_notify_all(&released_);
+        avs_mutex_unlock(&mutex_);
+    }
+};
+
+SharedBufferPool SHARED_BUFFERS;
+
+} // namespace
+
 // mbed OS' UDP sockets only have sendto() and recvfrom() APIs. We want to be
 // able to use connect() and use multiple logical sockets for connections to
 // different endpoints, so we need this router to multiplex mbed sockets.
+//
+// Routers are keyed by network interface and local address, so each interface
+// effectively has its own router table.
+//
+// The router table and the socket tables of routers are contiguous vectors,
+// which only allocate memory if they outgrow their inline storage, so that
+// looking up a router or a socket does not chase a pointer per entry.
+//
+// Locking: ROUTERS_MUTEX protects the ROUTERS table and the reference counts
+// of all routers. Each router's own mutex_ protects its socket table, and the
+// receive queues, remote addresses and DTLS Connection IDs of the sockets
+// registered in it, so that sockets bound to different ports never contend.
+// ROUTERS_MUTEX may be held while locking a router, never the other way round.
+//
+// A router is referenced by every AvsUdpRouterHandle pointing to it and by
+// every socket registered in it, and is deleted when the last reference is
+// released.
+//
+// backend_ is always non-blocking. If AvsUdpRxThread existed when the router
+// was created, datagrams are read from backend_ only by that thread, which
+// passes them through rx_ring_; otherwise they are read directly by the
+// threads waiting in receive(), into recv_buffer_ or a buffer borrowed from
+// SHARED_BUFFERS. Sending is serialized separately by tx_mutex_, so it never
+// waits for receiving threads.
 class AvsUdpRouter {
-    friend class avs_mbed_impl::AvsUdpRouterHandle;
-    static avs::List<AvsUdpRouterHandle> ROUTERS;
+    friend class ::AvsUdpRxThread;
+
+    static Mutex ROUTERS_MUTEX;
+    static RouterTable ROUTERS;
+    // high water marks of routers that have already been deleted
+    static size_t RETIRED_QUEUE_HIGH_WATER;
+    // datagrams dropped by the RX thread because of a full ring or lack of
+    // memory, since the last reset
+    static volatile uint32_t RX_HANDOFF_DROPS;
 
+    NetworkInterface *const interface_;
+    SocketAddress local_address_;
+    // protected by ROUTERS_MUTEX
+    size_t refcount_;
+    AvsUdpRxThread *const rx_thread_;
+
+    avs_mutex mutex_;
+    // notified whenever a datagram is queued, or when receiving_ is cleared
+    avs_condvar queue_changed_;
+    SigioEvent sigio_event_;
+    // set while a thread reads from backend_ or rx_ring_, and uses
+    // recv_buffer_
+    bool receiving_;
+    size_t queue_high_water_;
     UDPSocket backend_;
     size_t recv_buffer_size_;
+    // only allocated if neither rx_thread_ nor SHARED_BUFFERS is used
     uint8_t *recv_buffer_;
-    avs::List<AvsUdpSocket *> sockets_;
+    SocketTable sockets_;
+
+    // Single-producer, single-consumer ring. The producer is the RX thread,
+    // and only it writes rx_ring_head_. Consumers only access it with mutex_
+    // locked, and only they write rx_ring_tail_.
+    AvsUdpReceivedMessage *rx_ring_[ANJAY_MBEDOS_UDP_RX_RING_SIZE];
+    volatile uint32_t rx_ring_head_;
+    volatile uint32_t rx_ring_tail_;
 
-    AvsUdpRouter(SocketAddress &inout_addr)
-            : backend_(),
+    Mutex tx_mutex_;
+    SigioEvent tx_event_;
+    // used by send_vectored_to() if SHARED_BUFFERS is not, allocated on first
+    // use
+    uint8_t *tx_buffer_;
+
+    AvsUdpRouter(NetworkInterface &interface, AvsUdpRxThread *rx_thread)
+            : interface_(&interface),
+              local_address_(),
+              refcount_(0),
+              rx_thread_(rx_thread),
+              mutex_(),
+              queue_changed_(),
+              sigio_event_(),
+              receiving_(false),
+              queue_high_water_(0),
+              backend_(),
               recv_buffer_size_(AvsSocketGlobal::recv_buffer_size()),
-              recv_buffer_(new (nothrow) uint8_t[recv_buffer_size_]) {}
+              recv_buffer_(rx_thread || SHARED_BUFFERS.enabled()
+                                   ? nullptr
+                                   : new_buffer(recv_buffer_size_)),
+              sockets_(),
+              rx_ring_(),
+              rx_ring_head_(0),
+              rx_ring_tail_(0),
+              tx_mutex_(),
+              tx_event_(),
+              tx_buffer_(nullptr) {}
 
     AvsUdpRouter(const AvsUdpRouter &);
     AvsUdpRouter &operator=(const AvsUdpRouter &);
 
+    void on_sigio() {
+        if (rx_thread_) {
+            rx_thread_->wake_up();
+        } else {
+            sigio_event_.trigger();
+            trigger_poll_flag();
+        }
+        tx_event_.trigger();
+    }
+
+    // called by the RX thread only
+    bool rx_ring_push(AvsUdpReceivedMessage *msg) {
+        uint32_t head = rx_ring_head_;
+        if (head - atomic_load_u32(&rx_ring_tail_)
+                >= ANJAY_MBEDOS_UDP_RX_RING_SIZE) {
+            return false;
+        }
+        rx_ring_[head & RX_RING_MASK] = msg;
+        atomic_store_u32(&rx_ring_head_, head + 1);
+        return true;
+    }
+
+    // MUST be called with mutex_ locked, or from the destructor
+    AvsUdpReceivedMessage *rx_ring_pop() {
+        uint32_t tail = rx_ring_tail_;
+        if (atomic_load_u32(&rx_ring_head_) == tail) {
+            return nullptr;
+        }
+        AvsUdpReceivedMessage *msg = rx_ring_[tail & RX_RING_MASK];
+        atomic_store_u32(&rx_ring_tail_, tail + 1);
+        return msg;
+    }
+
+    // Called by the RX thread with ROUTERS_MUTEX locked, which guarantees
+    // that the router is not deleted in the meantime.
+    void rx_thread_drain(uint8_t *buffer, size_t buffer_size) {
+        bool handed_off = false;
+        while (true) {
+            SocketAddress peer;
+            nsapi_size_or_error_t result =
+                    backend_.recvfrom(&peer, buffer, buffer_size);
+            if (result < 0) {
+                break;
+            }
+            AvsUdpReceivedMessage *msg =
+                    new_received_message(peer, buffer, result);
+            if (!msg || !rx_ring_push(msg)) {
+                AVS_SOCKET_TRACE(ROUTER_DROP, this, result, peer.get_port());
+                delete_received_message(msg);
+                core_util_atomic_incr_u32(&RX_HANDOFF_DROPS, 1);
+                continue;
+            }
+            handed_off = true;
+        }
+        if (handed_off) {
+            sigio_event_.trigger();
+            // the sockets might be awaited by AvsSocketGlobal::poll() or the
+            // Anjay event loop, rather than in receive()
+            trigger_poll_flag();
+        }
+    }
+
+    static void rx_thread_drain_all(uint8_t *buffer, size_t buffer_size) {
+        ScopedLock<Mutex> lock(ROUTERS_MUTEX);
+        for (RouterTable::iterator it = ROUTERS.begin(); it != ROUTERS.end();
+             ++it) {
+            if (it->router->rx_thread_) {
+                it->router->rx_thread_drain(buffer, buffer_size);
+            }
+        }
+    }
+
+    // Reads the next datagram, either from backend_ or from rx_ring_. On
+    // success, *out_data points to the datagram, stored either in a receive
+    // buffer or in *out_handoff, and MUST be released by the caller using
+    // release_datagram(). Returns NSAPI_ERROR_NO_MEMORY without waiting if all
+    // SHARED_BUFFERS are in use. MUST be called with mutex_ locked and
+    // receiving_ set.
+    nsapi_size_or_error_t next_datagram(SocketAddress *out_peer,
+                                        const uint8_t **out_data,
+                                        AvsUdpReceivedMessage **out_handoff) {
+        if (!rx_thread_) {
+            uint8_t *buffer =
+                    recv_buffer_ ? recv_buffer_ : SHARED_BUFFERS.try_acquire();
+            if (!buffer) {
+                return NSAPI_ERROR_NO_MEMORY;
+            }
+            *out_data = buffer;
+            *out_handoff = nullptr;
+            nsapi_size_or_error_t result =
+                    backend_.recvfrom(out_peer, buffer, recv_buffer_size_);
+            if (result < 0) {
+                release_datagram(buffer, nullptr);
+            }
+            return result;
+        }
+        if (!(*out_handoff = rx_ring_pop())) {
+            return NSAPI_ERROR_WOULD_BLOCK;
+        }
+        *out_peer = (*out_handoff)->peer;
+        *out_data = (*out_handoff)->data;
+        return (nsapi_size_or_error_t) (*out_handoff)->data_size;
+    }
+
+    void release_datagram(const uint8_t *data, AvsUdpReceivedMessage *handoff) {
+        if (handoff) {
+            delete_received_message(handoff);
+        } else if (data != recv_buffer_) {
+            SHARED_BUFFERS.release(const_cast<uint8_t *>(data));
+        }
+    }
+
     bool socket_registered(AvsUdpSocket *socket) const {
         return find(sockets_.begin(), sockets_.end(), socket) != sockets_.end();
     }
 
     AvsUdpSocket *find_socket_by_peer(const SocketAddress &peer) {
-        avs::ListIterator<AvsUdpSocket *> it;
-        for (it = sockets_.begin(); it != sockets_.end(); ++it) {
+        for (SocketTable::iterator it = sockets_.begin(); it != sockets_.end();
+             ++it) {
             if (addresses_equal((*it)->remote_address_, peer)) {
                 return *it;
             }
@@ -71,33 +594,218 @@ class AvsUdpRouter {
         return find_socket_by_peer(SocketAddress());
     }
 
+    AvsUdpSocket *find_socket_by_dtls_cid(const uint8_t *datagram,
+                                          size_t datagram_size) {
+        for (SocketTable::iterator it = sockets_.begin(); it != sockets_.end();
+             ++it) {
+            if ((*it)->remote_address_.get_ip_version() != NSAPI_UNSPEC
+                && dtls_record_has_cid(datagram, datagram_size,
+                                       (*it)->dtls_cid_,
+                                       (*it)->dtls_cid_size_)) {
+                return *it;
+            }
+        }
+        return nullptr;
+    }
+
+    void update_queue_high_water(const AvsUdpReceiveQueue &recvd_msgs) {
+        queue_high_water_ = max(queue_high_water_, recvd_msgs.size());
+    }
+
+    // Finds the socket that a datagram from @p peer shall be queued for, or
+    // returns NULL if it shall be dropped. MUST be called with mutex_ locked.
+    AvsUdpSocket *route_datagram(const SocketAddress &peer,
+                                 const uint8_t *data,
+                                 size_t size) {
+        AvsUdpSocket *socket = find_socket_by_peer(peer);
+        // the remote address is deliberately not updated here: the record
+        // has not been authenticated yet, and this layer cannot tell whether
+        // the DTLS layer will accept it
+        if (!socket && (socket = find_socket_by_dtls_cid(data, size))) {
+            LOG(DEBUG,
+                "datagram from [%s]:%" PRIu16 " routed by DTLS Connection ID",
+                peer.get_ip_address(), peer.get_port());
+            AVS_SOCKET_TRACE(ROUTER_CID_MATCH, socket, size, peer.get_port());
+        }
+        if (!socket) {
+            socket = find_unconnected_socket();
+        }
+        if (!socket) {
+            AVS_SOCKET_TRACE(ROUTER_DROP, this, size, peer.get_port());
+        }
+        return socket;
+    }
+
+    // Reads datagrams until one is queued for any of the sockets, or the
+    // deadline passes. MUST be called with mutex_ locked and receiving_ set;
+    // the mutex is temporarily unlocked while waiting for data.
+    avs_error_t try_recv(const AvsUdpSocket *requester,
+                         const avs_time_monotonic_t &deadline) {
+        while (true) {
+            SocketAddress peer;
+            const uint8_t *data;
+            AvsUdpReceivedMessage *handoff;
+            nsapi_size_or_error_t result;
+            while (true) {
+                sigio_event_.reset();
+                result = next_datagram(&peer, &data, &handoff);
+                const bool no_buffer = (result == NSAPI_ERROR_NO_MEMORY);
+                if (no_buffer) {
+                    // the datagram, if any, stays in the network stack
+                    result = NSAPI_ERROR_WOULD_BLOCK;
+                }
+                if (result != NSAPI_ERROR_WOULD_BLOCK
+                    || !avs_time_monotonic_before(avs_time_monotonic_now(),
+                                                  deadline)) {
+                    break;
+                }
+                avs_mutex_unlock(&mutex_);
+                if (no_buffer) {
+                    SHARED_BUFFERS.wait_until_available(deadline);
+                } else {
+                    sigio_event_.wait(deadline);
+                }
+                avs_mutex_lock(&mutex_);
+            }
+            if (result < 0) {
+                return avs_errno(nsapi_error_to_errno(result));
+            }
+            AvsUdpSocket *socket = route_datagram(peer, data, result);
+            if (!socket) {
+                release_datagram(data, handoff);
+                if (avs_time_monotonic_before(avs_time_monotonic_now(),
+                                              deadline)) {
+                    continue;
+                } else {
+                    return avs_errno(AVS_ETIMEDOUT);
+                }
+            }
+            // datagrams handed off by the RX thread are queued as they are
+            AvsUdpReceivedMessage *msg =
+                    handoff ? handoff
+                            : new_received_message(peer, data, result);
+            if (!handoff) {
+                release_datagram(data, nullptr);
+            }
+            if (!msg) {
+                AVS_SOCKET_TRACE(ROUTER_DROP, this, result, peer.get_port());
+                return avs_errno(AVS_ENOMEM);
+            }
+            AVS_SOCKET_TRACE(ROUTER_RECV, socket, result, peer.get_port());
+            socket->recvd_msgs_.push_back(msg);
+            update_queue_high_water(socket->recvd_msgs_);
+            if (socket != requester) {
+                // the datagram might be awaited by AvsSocketGlobal::poll() or
+                // the Anjay event loop in another thread, which might have
+                // already checked this socket before we received it
+                trigger_poll_flag();
+            }
+            return avs_errno(AVS_NO_ERROR);
+        }
+    }
+
+    static avs_time_monotonic_t send_deadline() {
+        return avs_time_monotonic_add(
+                avs_time_monotonic_now(),
+                avs_time_duration_from_scalar(NET_SEND_TIMEOUT_MS,
+                                              AVS_TIME_MS));
+    }
+
+    avs_error_t send_result(nsapi_size_or_error_t result, size_t length) {
+        AVS_SOCKET_TRACE(SEND, this, length, result < 0 ? result : 0);
+        if (result < 0) {
+            return avs_errno(nsapi_error_to_errno(result));
+        } else if ((size_t) result < length) {
+            LOG(ERROR, "sending fail (%lu/%lu)", (unsigned long) result,
+                (unsigned long) length);
+            return avs_errno(AVS_EIO);
+        }
+        return AVS_OK;
+    }
+
+    // Sends a datagram gathered into a buffer borrowed from SHARED_BUFFERS.
+    // The buffer is returned to the pool before waiting for the network stack
+    // to accept more data, and the datagram is gathered again for each
+    // attempt, so that receiving threads never wait for a blocked sender.
+    avs_error_t send_vectored_shared(const AvsIoVec *iov,
+                                     size_t iov_count,
+                                     size_t length,
+                                     const SocketAddress &dest) {
+        ScopedLock<Mutex> lock(tx_mutex_);
+        avs_time_monotonic_t deadline = send_deadline();
+        nsapi_size_or_error_t result;
+        while (true) {
+            uint8_t *buffer = SHARED_BUFFERS.acquire(deadline);
+            if (!buffer) {
+                result = NSAPI_ERROR_WOULD_BLOCK;
+                break;
+            }
+            iov_gather(buffer, iov, iov_count);
+            tx_event_.reset();
+            result = backend_.sendto(dest, buffer, length);
+            SHARED_BUFFERS.release(buffer);
+            if (result != NSAPI_ERROR_WOULD_BLOCK
+                || !avs_time_monotonic_before(avs_time_monotonic_now(),
+                                              deadline)) {
+                break;
+            }
+            tx_event_.wait(deadline);
+        }
+        return send_result(result, length);
+    }
+
 public:
     ~AvsUdpRouter() {
-        delete[] recv_buffer_;
+        // detaches on_sigio() before the members it uses are destroyed
+        backend_.close();
+        AvsUdpReceivedMessage *msg;
+        while ((msg = rx_ring_pop())) {
+            delete_received_message(msg);
+        }
+        delete_buffer(recv_buffer_);
+        delete_buffer(tx_buffer_);
     }
 
-    static void get(AvsUdpRouterHandle &out, const SocketAddress &local_addr);
-    static void get(AvsUdpRouterHandle &out, const AvsUdpSocket *socket);
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    static void *operator new(size_t size, const nothrow_t &) throw();
+    static void operator delete(void *ptr);
+    static void operator delete(void *ptr, const nothrow_t &) throw();
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+
+    static void get(AvsUdpRouterHandle &out,
+                    const NetworkInterface &interface,
+                    const SocketAddress &local_addr);
     static avs_error_t get_or_create(AvsUdpRouterHandle &out,
+                                     NetworkInterface &interface,
                                      SocketAddress local_addr);
+    static void release(AvsUdpRouter *router);
+    static void get_stats(AvsUdpRouterStats *out);
+    static void reset_stats();
+    static avs_error_t set_shared_buffers(size_t count);
+
+    void lock() {
+        avs_mutex_lock(&mutex_);
+    }
+
+    void unlock() {
+        avs_mutex_unlock(&mutex_);
+    }
 
     InternetSocket *get_socket() {
         return &backend_;
     }
 
-    avs_error_t register_socket(AvsUdpSocket *socket, bool allow_reuse) {
-        MBED_ASSERT(addresses_equal(socket->remote_address_, SocketAddress()));
-        if (!allow_reuse && find_unconnected_socket()) {
-            return avs_errno(AVS_EISCONN);
-        }
-
-        MBED_ASSERT(!socket_registered(socket));
-        if (sockets_.insert(sockets_.end(), socket) == sockets_.end()) {
-            return avs_errno(AVS_ENOMEM);
-        }
-        return AVS_OK;
+    const SocketAddress &local_address() const {
+        return local_address_;
     }
 
+    // On success, the reference held by @p handle is transferred to the
+    // socket, and released by unregister_socket().
+    avs_error_t register_socket(AvsUdpRouterHandle &handle,
+                                AvsUdpSocket *socket,
+                                bool allow_reuse);
+
+    // MUST be called with mutex_ locked
     avs_error_t check_connection_possibility(const SocketAddress &peer) {
         if (!peer || !peer.get_port()) {
             return avs_errno(AVS_EFAULT);
@@ -109,148 +817,134 @@ public:
     }
 
     void unregister_socket(AvsUdpSocket *socket) {
-        avs::ListIterator<AvsUdpSocket *> it;
-        for (it = sockets_.begin(); it != sockets_.end(); ++it) {
-            if (*it == socket) {
+        bool found = false;
+        {
+            ScopedLock<AvsUdpRouter> lock(*this);
+            SocketTable::iterator it =
+                    find(sockets_.begin(), sockets_.end(), socket);
+            if (it != sockets_.end()) {
                 sockets_.erase(it);
-                break;
+                socket->router_ = nullptr;
+                found = true;
             }
         }
+        if (found) {
+            release(this);
+        }
     }
 
     avs_error_t
     send_to(const void *buffer, size_t length, const SocketAddress &dest) {
-        backend_.set_timeout(NET_SEND_TIMEOUT_MS);
-        nsapi_size_or_error_t result = backend_.sendto(dest, buffer, length);
-        if (result < 0) {
-            return avs_errno(nsapi_error_to_errno(result));
-        } else if ((size_t) result < length) {
-            LOG(ERROR, "sending fail (%lu/%lu)", (unsigned long) result,
-                (unsigned long) length);
-            return avs_errno(AVS_EIO);
+        ScopedLock<Mutex> lock(tx_mutex_);
+        avs_time_monotonic_t deadline = send_deadline();
+        nsapi_size_or_error_t result;
+        while (true) {
+            tx_event_.reset();
+            result = backend_.sendto(dest, buffer, length);
+            if (result != NSAPI_ERROR_WOULD_BLOCK
+                || !avs_time_monotonic_before(avs_time_monotonic_now(),
+                                              deadline)) {
+                break;
+            }
+            tx_event_.wait(deadline);
         }
-        return AVS_OK;
+        return send_result(result, length);
     }
 
-    avs_error_t try_recv(const avs_time_monotonic_t &deadline) {
-        while (true) {
-            int64_t timeout_ms;
-            if (avs_time_duration_to_scalar(
-                        &timeout_ms, AVS_TIME_MS,
-                        avs_time_monotonic_diff(deadline,
-                                                avs_time_monotonic_now()))) {
-                timeout_ms = -1;
-            } else if (timeout_ms < 0) {
-                timeout_ms = 0;
-            }
-            SocketAddress peer;
-            backend_.set_blocking(!avs_time_monotonic_valid(deadline));
-            reset_poll_flag();
-            nsapi_size_or_error_t result =
-                    backend_.recvfrom(&peer, recv_buffer_, recv_buffer_size_);
-            while (result == NSAPI_ERROR_WOULD_BLOCK
-                   && avs_time_monotonic_before(avs_time_monotonic_now(),
-                                                deadline)) {
-                wait_on_poll_flag(deadline);
-                result = backend_.recvfrom(&peer, recv_buffer_,
-                                           recv_buffer_size_);
-                reset_poll_flag();
-            }
-            if (result < 0) {
-                return avs_errno(nsapi_error_to_errno(result));
+    avs_error_t send_vectored_to(const AvsIoVec *iov,
+                                 size_t iov_count,
+                                 const SocketAddress &dest) {
+        if (iov_count == 1) {
+            return send_to(iov[0].base, iov[0].length, dest);
+        }
+        size_t length = iov_total_length(iov, iov_count);
+        if (length <= recv_buffer_size_ && SHARED_BUFFERS.enabled()) {
+            return send_vectored_shared(iov, iov_count, length, dest);
+        }
+        ScopedLock<Mutex> lock(tx_mutex_);
+        uint8_t *buffer;
+        if (length > recv_buffer_size_) {
+            // larger than any datagram we could receive; don't keep a buffer
+            // of that size around
+            if ((buffer = new_buffer(length))) {
+                count_temporary_gather_buffer(length);
             }
-            AvsUdpSocket *socket = find_socket_by_peer(peer);
-            if (!socket) {
-                socket = find_unconnected_socket();
+        } else {
+            if (!tx_buffer_) {
+                tx_buffer_ = new_buffer(recv_buffer_size_);
             }
-            if (!socket) {
-                if (avs_time_monotonic_before(avs_time_monotonic_now(),
-                                              deadline)) {
-                    continue;
-                } else {
+            buffer = tx_buffer_;
+        }
+        if (!buffer) {
+            return avs_errno(AVS_ENOMEM);
+        }
+        iov_gather(buffer, iov, iov_count);
+        // tx_mutex_ is recursive
+        avs_error_t err = send_to(buffer, length, dest);
+        if (buffer != tx_buffer_) {
+            delete_buffer(buffer);
+        }
+        return err;
+    }
+
+    // Waits until the receive queue of @p socket is not empty, or the deadline
+    // passes. Only one thread reads from backend_ at a time; the others wait
+    // for it to queue datagrams for them, and take over if it gives up.
+    avs_error_t receive(const AvsUdpSocket *socket,
+                        const avs_time_monotonic_t &deadline) {
+        ScopedLock<AvsUdpRouter> lock(*this);
+        avs_error_t err = AVS_OK;
+        while (socket->recvd_msgs_.empty()) {
+            if (receiving_) {
+                if (avs_condvar_wait(&queue_changed_, &mutex_, deadline)
+                        == AVS_CONDVAR_TIMEOUT
+                    && socket->recvd_msgs_.empty()) {
                     return avs_errno(AVS_ETIMEDOUT);
                 }
+                continue;
             }
-            avs::ListIterator<AvsUdpReceivedMessage> it =
-                    socket->recvd_msgs_.allocate(
-                            socket->recvd_msgs_.end(),
-                            offsetof(AvsUdpReceivedMessage, data) + result);
-            if (it == socket->recvd_msgs_.end()) {
-                return avs_errno(AVS_ENOMEM);
+            receiving_ = true;
+            err = try_recv(socket, deadline);
+            receiving_ = false;
+            avs_condvar_notify_all(&queue_changed_);
+            if (avs_is_err(err)) {
+                return err;
             }
-            new (&it->peer) SocketAddress(peer);
-            it->data_size = result;
-            memcpy(it->data, recv_buffer_, it->data_size);
-            return avs_errno(AVS_NO_ERROR);
         }
+        return err;
     }
 };
 
 class AvsUdpRouterHandle {
-    friend class avs_mbed_impl::AvsUdpRouter;
-    SocketAddress local_address_;
     AvsUdpRouter *router_;
 
-    void update(const SocketAddress &local_address, AvsUdpRouter *router) {
-        if (router == router_) {
-            MBED_ASSERT(addresses_equal(local_address, local_address_));
-        } else {
-            clear();
-            local_address_ = local_address;
-            router_ = router;
-        }
-    }
-
     AvsUdpRouterHandle(const AvsUdpRouterHandle &);
     AvsUdpRouterHandle &operator=(const AvsUdpRouterHandle &);
 
 public:
-    AvsUdpRouterHandle() : local_address_(), router_(nullptr) {}
+    AvsUdpRouterHandle() : router_(nullptr) {}
 
     ~AvsUdpRouterHandle() {
         clear();
     }
 
-    void clear() {
-        if (router_ && router_->sockets_.empty()) {
-            // If we're getting rid of a handle to a router that has no sockets
-            // registered, we get rid of it.
-            //
-            // We can do that, because AvsUdpRouterHandles are basically used in
-            // two contexts:
-            //
-            // - AvsUdpRouter::ROUTERS - well, we're removing it from there, so
-            //   we won't break anything
-            // - methods of AvsUdpSocket - if a socket is able to retrieve a
-            //   router handle, it means it's associated with the router, so it
-            //   will be present on the sockets lists, i.e. it won't be empty,
-            //   unless something goes wrong during e.g. bind() or connect(),
-            //   or when doing close(), and these are places where we may want
-            //   to delete the router
-            //
-            // Dangling handles won't happen unless multiple sockets bound to
-            // the same port will be used in multiple concurrently running
-            // threads.
-            //
-            // But the code in this file IS CURRENTLY NOT THREAD SAFE anyway.
-
-            avs::ListIterator<AvsUdpRouterHandle> it;
-            for (it = AvsUdpRouter::ROUTERS.begin();
-                 it != AvsUdpRouter::ROUTERS.end(); ++it) {
-                if (it->router_ == router_) {
-                    it->router_ = nullptr;
-                    AvsUdpRouter::ROUTERS.erase(it);
-                    break;
-                }
-            }
-            delete router_;
-        }
-        local_address_ = SocketAddress();
+    // takes over a reference that has already been counted
+    void reset(AvsUdpRouter *router) {
+        clear();
+        router_ = router;
+    }
+
+    // gives up the reference without releasing it
+    AvsUdpRouter *detach() {
+        AvsUdpRouter *router = router_;
         router_ = nullptr;
+        return router;
     }
 
-    SocketAddress local_address() const {
-        return local_address_;
+    void clear() {
+        if (router_) {
+            AvsUdpRouter::release(detach());
+        }
     }
 
     operator bool() const {
@@ -266,57 +960,178 @@ public:
     }
 };
 
-avs::List<AvsUdpRouterHandle> AvsUdpRouter::ROUTERS;
+Mutex AvsUdpRouter::ROUTERS_MUTEX;
+RouterTable AvsUdpRouter::ROUTERS;
+size_t AvsUdpRouter::RETIRED_QUEUE_HIGH_WATER = 0;
+volatile uint32_t AvsUdpRouter::RX_HANDOFF_DROPS = 0;
+
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+namespace {
+
+AVS_STATIC_POOL_DEFINE(UDP_ROUTERS,
+                       sizeof(AvsUdpRouter),
+                       ANJAY_MBEDOS_STATIC_MAX_UDP_ROUTERS);
+
+} // namespace
+
+void *AvsUdpRouter::operator new(size_t size, const nothrow_t &) throw() {
+    MBED_ASSERT(size <= UDP_ROUTERS.block_size);
+    return UDP_ROUTERS.allocate();
+}
+
+void AvsUdpRouter::operator delete(void *ptr) {
+    UDP_ROUTERS.free(ptr);
+}
+
+void AvsUdpRouter::operator delete(void *ptr, const nothrow_t &) throw() {
+    UDP_ROUTERS.free(ptr);
+}
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+
+avs_error_t AvsUdpRouter::register_socket(AvsUdpRouterHandle &handle,
+                                          AvsUdpSocket *socket,
+                                          bool allow_reuse) {
+    MBED_ASSERT(&*handle == this);
+    MBED_ASSERT(addresses_equal(socket->remote_address_, SocketAddress()));
+    MBED_ASSERT(!socket->router_);
+    ScopedLock<AvsUdpRouter> lock(*this);
+    if (!allow_reuse && find_unconnected_socket()) {
+        return avs_errno(AVS_EISCONN);
+    }
+
+    MBED_ASSERT(!socket_registered(socket));
+    if (!sockets_.push_back(socket)) {
+        return avs_errno(AVS_ENOMEM);
+    }
+    socket->router_ = handle.detach();
+    return AVS_OK;
+}
+
+void AvsUdpRouter::release(AvsUdpRouter *router) {
+    ScopedLock<Mutex> lock(ROUTERS_MUTEX);
+    MBED_ASSERT(router->refcount_ > 0);
+    if (--router->refcount_) {
+        return;
+    }
+    // No handles point to the router and no sockets are registered in it, so
+    // nothing else can reach it, other than through ROUTERS.
+    MBED_ASSERT(router->sockets_.empty());
+    for (RouterTable::iterator it = ROUTERS.begin(); it != ROUTERS.end();
+         ++it) {
+        if (it->router == router) {
+            ROUTERS.erase(it);
+            break;
+        }
+    }
+    RETIRED_QUEUE_HIGH_WATER =
+            max(RETIRED_QUEUE_HIGH_WATER, router->queue_high_water_);
+    delete router;
+}
+
+void AvsUdpRouter::get_stats(AvsUdpRouterStats *out) {
+    memset(out, 0, sizeof(*out));
+    ScopedLock<Mutex> lock(ROUTERS_MUTEX);
+    out->queue_high_water = RETIRED_QUEUE_HIGH_WATER;
+    for (RouterTable::iterator it = ROUTERS.begin(); it != ROUTERS.end();
+         ++it) {
+        AvsUdpRouter *router = it->router;
+        ScopedLock<AvsUdpRouter> router_lock(*router);
+        ++out->routers;
+        for (SocketTable::iterator sit = router->sockets_.begin();
+             sit != router->sockets_.end(); ++sit) {
+            ++out->sockets;
+            out->queued_messages += (*sit)->recvd_msgs_.size();
+        }
+        out->queue_high_water =
+                max(out->queue_high_water, router->queue_high_water_);
+        if (router->recv_buffer_) {
+            out->buffer_bytes += router->recv_buffer_size_;
+        }
+        ScopedLock<Mutex> tx_lock(router->tx_mutex_);
+        if (router->tx_buffer_) {
+            out->buffer_bytes += router->recv_buffer_size_;
+        }
+    }
+    out->buffer_bytes += SHARED_BUFFERS.footprint();
+    if (AvsUdpRxThread::INSTANCE && AvsUdpRxThread::INSTANCE->buffer_) {
+        out->buffer_bytes += AvsUdpRxThread::INSTANCE->buffer_size_;
+    }
+    out->rx_handoff_drops = atomic_load_u32(&RX_HANDOFF_DROPS);
+    out->stack_rx_drops =
+            get_stack_rx_drops(AvsSocketGlobal::get_interface());
+}
+
+void AvsUdpRouter::reset_stats() {
+    ScopedLock<Mutex> lock(ROUTERS_MUTEX);
+    RETIRED_QUEUE_HIGH_WATER = 0;
+    atomic_store_u32(&RX_HANDOFF_DROPS, 0);
+    for (RouterTable::iterator it = ROUTERS.begin(); it != ROUTERS.end();
+         ++it) {
+        ScopedLock<AvsUdpRouter> router_lock(*it->router);
+        it->router->queue_high_water_ = 0;
+    }
+}
+
+avs_error_t AvsUdpRouter::set_shared_buffers(size_t count) {
+    ScopedLock<Mutex> lock(ROUTERS_MUTEX);
+    if (!ROUTERS.empty()) {
+        return avs_errno(AVS_EBUSY);
+    }
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    if (!count && !AvsUdpRxThread::INSTANCE) {
+        // routers could not receive or send anything
+        return avs_errno(AVS_EINVAL);
+    }
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    return SHARED_BUFFERS.reset(count, AvsSocketGlobal::recv_buffer_size());
+}
 
 void AvsUdpRouter::get(AvsUdpRouterHandle &out,
+                       const NetworkInterface &interface,
                        const SocketAddress &local_addr) {
     MBED_ASSERT(local_addr.get_ip_version() != NSAPI_UNSPEC
                 && local_addr.get_port() != 0);
-    avs::ListIterator<AvsUdpRouterHandle> it;
-    for (it = ROUTERS.begin(); it != ROUTERS.end(); ++it) {
-        if (addresses_equal(it->local_address(), local_addr)) {
-            out.update(local_addr, &**it);
+    ScopedLock<Mutex> lock(ROUTERS_MUTEX);
+    const uint16_t port = local_addr.get_port();
+    for (RouterTable::iterator it = ROUTERS.begin(); it != ROUTERS.end();
+         ++it) {
+        if (it->port == port && it->router->interface_ == &interface
+            && addresses_equal(it->router->local_address_, local_addr)) {
+            ++it->router->refcount_;
+            out.reset(it->router);
             return;
         }
     }
     out.clear();
 }
 
-void AvsUdpRouter::get(AvsUdpRouterHandle &out, const AvsUdpSocket *socket) {
-    avs::ListIterator<AvsUdpRouterHandle> it;
-    for (it = ROUTERS.begin(); it != ROUTERS.end(); ++it) {
-        avs::ListIterator<AvsUdpSocket *> sit;
-        for (sit = it->router_->sockets_.begin();
-             sit != it->router_->sockets_.end(); ++sit) {
-            if (*sit == socket) {
-                out.update(it->local_address(), &**it);
-                return;
-            }
-        }
-    }
-    out.clear();
-}
-
 avs_error_t AvsUdpRouter::get_or_create(AvsUdpRouterHandle &out,
+                                        NetworkInterface &interface,
                                         SocketAddress local_addr) {
     MBED_ASSERT(local_addr.get_ip_version() != NSAPI_UNSPEC);
+    // held during creation, so that concurrent binds to the same port cannot
+    // create two routers; the mutex is recursive, so get() can lock it again
+    ScopedLock<Mutex> lock(ROUTERS_MUTEX);
     if (local_addr.get_port() != 0) {
-        get(out, local_addr);
+        get(out, interface, local_addr);
         if (out) {
             return AVS_OK;
         }
     }
 
-    AvsUniquePtr<AvsUdpRouter> router(new (nothrow) AvsUdpRouter(local_addr));
-    if (!router.get() || !router->recv_buffer_) {
-        return AVS_OK;
+    AvsUniquePtr<AvsUdpRouter> router(
+            new (nothrow) AvsUdpRouter(interface, AvsUdpRxThread::INSTANCE));
+    if (!router.get()
+        || (!router->rx_thread_ && !router->recv_buffer_
+            && !SHARED_BUFFERS.enabled())) {
+        return avs_errno(AVS_ENOMEM);
     }
-    nsapi_error_t err =
-            router->backend_.open(&AvsSocketGlobal::get_interface());
+    nsapi_error_t err = router->backend_.open(&interface);
     if (err) {
         return avs_errno(nsapi_error_to_errno(err));
     }
-    router->backend_.sigio(callback(trigger_poll_flag));
+    router->backend_.set_blocking(false);
+    router->backend_.sigio(callback(router.get(), &AvsUdpRouter::on_sigio));
 
     // mbed OS automatically assigns a random port on socket creation
     // Note: SocketAddress::operator bool tests if IP address is all-zeros, but
@@ -327,40 +1142,31 @@ avs_error_t AvsUdpRouter::get_or_create(AvsUdpRouterHandle &out,
             return avs_errno(nsapi_error_to_errno(err));
         }
     } else {
-        int32_t port = get_local_port(&router->backend_);
+        int32_t port = get_local_port(interface, &router->backend_);
         if (port > 0) {
             local_addr.set_port(port);
         }
     }
-    avs::ListIterator<AvsUdpRouterHandle> it = ROUTERS.allocate(
-            local_addr.get_port() > 0 ? ROUTERS.end() : ROUTERS.begin());
-    if (it == ROUTERS.end()) {
+    router->local_address_ = local_addr;
+    RouterTableEntry entry;
+    entry.port = local_addr.get_port();
+    entry.router = router.get();
+    if (!ROUTERS.insert(entry.port > 0 ? ROUTERS.end() : ROUTERS.begin(),
+                        entry)) {
         return avs_errno(AVS_ENOMEM);
     }
-    (new (&*it) AvsUdpRouterHandle())->update(local_addr, router.release());
-    out.update(local_addr, &**it);
+    router->refcount_ = 1;
+    out.reset(router.release());
     return AVS_OK;
 }
 
-void AvsUdpSocket::get_router(AvsUdpRouterHandle &out) const {
-    if (local_address_.get_ip_version() == NSAPI_UNSPEC) {
-        out.clear();
-    } else if (local_address_.get_port() != 0) {
-        AvsUdpRouter::get(out, local_address_);
-    } else {
-        AvsUdpRouter::get(out, this);
-    }
-}
-
-avs_error_t AvsUdpSocket::ensure_router(AvsUdpRouterHandle &out) {
-    get_router(out);
-    if (!out) {
+avs_error_t AvsUdpSocket::ensure_router() {
+    if (!router_) {
         avs_error_t err = AvsSocket::bind(nullptr, nullptr);
         if (avs_is_err(err)) {
             return err;
         }
-        get_router(out);
-        MBED_ASSERT(out);
+        MBED_ASSERT(router_);
     }
     return AVS_OK;
 }
@@ -392,62 +1198,76 @@ int AvsUdpSocket::get_fallback_inner_mtu() const {
 }
 
 InternetSocket *AvsUdpSocket::mbed_socket() const {
-    AvsUdpRouterHandle router;
-    get_router(router);
-    return router ? router->get_socket() : nullptr;
+    return router_ ? router_->get_socket() : nullptr;
 }
 
 avs_error_t AvsUdpSocket::try_connect(const SocketAddress &address) {
-    AvsUdpRouterHandle router;
-    avs_error_t err = ensure_router(router);
-    if (!router) {
-        MBED_ASSERT(avs_is_err(err));
+    avs_error_t err = ensure_router();
+    if (avs_is_err(err)) {
         return err;
     }
-    if (avs_is_err((err = router->check_connection_possibility(address)))) {
+    ScopedLock<AvsUdpRouter> lock(*router_);
+    if (avs_is_err((err = router_->check_connection_possibility(address)))) {
         return err;
     }
-    // the call site (AvsSocket::connect()) will update this->remote_address_,
-    // which is what the routing is based on
+    // the call site (AvsSocket::connect()) will update this->remote_address_
+    // again, but setting it here already prevents other threads from
+    // connecting their sockets on the same port to the same peer
+    remote_address_ = address;
     return AVS_OK;
 }
 
 bool AvsUdpSocket::ready_to_receive() const {
-    if (!recvd_msgs_.empty()) {
-        return true;
-    }
-    AvsUdpRouterHandle router;
-    get_router(router);
-    if (!router) {
-        return false;
+    return router_
+           && avs_is_ok(router_->receive(this, avs_time_monotonic_now()));
+}
+
+avs_error_t AvsUdpSocket::get_connected_address(SocketAddress *out) {
+    *out = router_ ? remote_address_ : SocketAddress();
+    if (out->get_ip_version() == NSAPI_UNSPEC) {
+        LOG(ERROR, "Attempted send() on an unconnected socket");
+        return avs_errno(AVS_ENOTCONN);
     }
-    avs_time_monotonic_t deadline = avs_time_monotonic_now();
-    while (avs_is_ok(router->try_recv(deadline))) {
-        if (!recvd_msgs_.empty()) {
-            return true;
-        }
+    return AVS_OK;
+}
+
+void AvsUdpSocket::pmtu_on_sent(const SocketAddress &address,
+                                size_t length,
+                                avs_error_t err) {
+    if (pmtu_discovery_ && avs_is_ok(err)) {
+        AvsPmtuCache::on_sent(address, length);
     }
-    return false;
 }
 
 avs_error_t AvsUdpSocket::send(const void *buffer, size_t length) {
-    AvsUdpRouterHandle router;
-    get_router(router);
-    if (!router || remote_address_.get_ip_version() == NSAPI_UNSPEC) {
-        LOG(ERROR, "Attempted send() on an unconnected socket");
-        return avs_errno(AVS_ENOTCONN);
+    SocketAddress remote_address;
+    avs_error_t err = get_connected_address(&remote_address);
+    if (avs_is_err(err)) {
+        return err;
+    }
+    err = router_->send_to(buffer, length, remote_address);
+    pmtu_on_sent(remote_address, length, err);
+    return err;
+}
+
+avs_error_t AvsUdpSocket::send_vectored(const AvsIoVec *iov,
+                                        size_t iov_count) {
+    SocketAddress remote_address;
+    avs_error_t err = get_connected_address(&remote_address);
+    if (avs_is_err(err)) {
+        return err;
     }
-    return router->send_to(buffer, length, remote_address_);
+    err = router_->send_vectored_to(iov, iov_count, remote_address);
+    pmtu_on_sent(remote_address, iov_total_length(iov, iov_count), err);
+    return err;
 }
 
 avs_error_t AvsUdpSocket::send_to(const void *buffer,
                                   size_t length,
                                   const char *host,
                                   const char *port) {
-    AvsUdpRouterHandle router;
-    avs_error_t err = ensure_router(router);
-    if (!router) {
-        MBED_ASSERT(avs_is_err(err));
+    avs_error_t err = ensure_router();
+    if (avs_is_err(err)) {
         return err;
     }
     SocketAddress address;
@@ -460,7 +1280,7 @@ avs_error_t AvsUdpSocket::send_to(const void *buffer,
     if (!info.get() || next_socket_address(info.get(), &address)) {
         return avs_errno(AVS_EADDRNOTAVAIL);
     }
-    return router->send_to(buffer, length, address);
+    return router_->send_to(buffer, length, address);
 }
 
 avs_error_t AvsUdpSocket::receive_from(size_t *out_size,
@@ -470,74 +1290,120 @@ avs_error_t AvsUdpSocket::receive_from(size_t *out_size,
                                        size_t host_size,
                                        char *port_str,
                                        size_t port_str_size) {
-    AvsUdpRouterHandle router;
-    get_router(router);
-    if (!router) {
+    if (!router_) {
         return avs_errno(AVS_ENOTCONN);
     }
     avs_time_monotonic_t deadline =
             avs_time_monotonic_add(avs_time_monotonic_now(), recv_timeout_);
-    avs_error_t err = AVS_OK;
-    while (recvd_msgs_.empty()) {
-        if (avs_is_err((err = router->try_recv(deadline)))) {
-            return err;
-        }
+    avs_error_t err = router_->receive(this, deadline);
+    if (avs_is_err(err)) {
+        return err;
     }
-    avs::ListIterator<AvsUdpReceivedMessage> it = recvd_msgs_.begin();
-    *out_size = it->data_size;
+    ScopedLock<AvsUdpRouter> lock(*router_);
+    AvsUdpReceivedMessage *msg = recvd_msgs_.pop_front();
+    AVS_SOCKET_TRACE(RECV, this, msg->data_size, 0);
+    *out_size = msg->data_size;
     if (buffer_length < *out_size) {
         *out_size = buffer_length;
         err = avs_errno(AVS_EMSGSIZE);
     }
-    memcpy(buffer, it->data, *out_size);
+    memcpy(buffer, msg->data, *out_size);
     if (host_size
-        && avs_simple_snprintf(host, host_size, "%s", it->peer.get_ip_address())
+        && avs_simple_snprintf(host, host_size, "%s",
+                               msg->peer.get_ip_address())
                    < 0
         && avs_is_ok(err)) {
         err = avs_errno(AVS_ERANGE);
     }
     if (port_str_size
         && avs_simple_snprintf(port_str, port_str_size, "%" PRIu16,
-                               it->peer.get_port())
+                               msg->peer.get_port())
                    < 0
         && avs_is_ok(err)) {
         err = avs_errno(AVS_ERANGE);
     }
-    recvd_msgs_.erase(it);
+    if (pmtu_discovery_) {
+        AvsPmtuCache::on_received(msg->peer);
+    }
+    delete_received_message(msg);
     return err;
 }
 
 avs_error_t AvsUdpSocket::try_bind(const SocketAddress &localaddr) {
-    AvsUdpRouterHandle router;
-    get_router(router);
-    if (router) {
+    if (router_) {
         LOG(ERROR, "socket is already bound");
         return avs_errno(AVS_EISCONN);
     }
 
     MBED_ASSERT(localaddr.get_ip_version() != NSAPI_UNSPEC);
-    avs_error_t err = AvsUdpRouter::get_or_create(router, localaddr);
+    AvsUdpRouterHandle router;
+    avs_error_t err =
+            AvsUdpRouter::get_or_create(router, network_interface(), localaddr);
     if (avs_is_ok(err)) {
         remote_address_ = SocketAddress();
-        err = router->register_socket(this, configuration_.reuse_addr);
+        local_address_ = router->local_address();
+        err = router->register_socket(router, this, configuration_.reuse_addr);
     }
     if (avs_is_ok(err)) {
         state_ = AVS_NET_SOCKET_STATE_BOUND;
-        local_address_ = router.local_address();
+    } else {
+        local_address_ = SocketAddress();
     }
     return err;
 }
 
+void AvsUdpSocket::update_remote_endpoint(const char *hostname,
+                                          SocketAddress address) {
+    if (router_) {
+        ScopedLock<AvsUdpRouter> lock(*router_);
+        AvsSocket::update_remote_endpoint(hostname, address);
+    } else {
+        AvsSocket::update_remote_endpoint(hostname, address);
+    }
+}
+
+avs_error_t AvsUdpSocket::set_dtls_connection_id(const void *cid,
+                                                 size_t cid_size) {
+    if (cid_size > sizeof(dtls_cid_) || (cid_size && !cid)) {
+        return avs_errno(AVS_EINVAL);
+    }
+    if (cid_size && remote_address_.get_ip_version() == NSAPI_UNSPEC) {
+        LOG(ERROR, "DTLS Connection ID can only be set on a connected socket");
+        return avs_errno(AVS_ENOTCONN);
+    }
+    if (router_) {
+        router_->lock();
+    }
+    if (cid_size) {
+        memcpy(dtls_cid_, cid, cid_size);
+    }
+    dtls_cid_size_ = (uint8_t) cid_size;
+    if (router_) {
+        router_->unlock();
+    }
+    return AVS_OK;
+}
+
+avs_error_t AvsUdpSocket::set_pmtu_discovery(bool enabled) {
+    pmtu_discovery_ = enabled;
+    return AVS_OK;
+}
+
 avs_error_t AvsUdpSocket::accept(AvsSocket *new_socket) {
     return avs_errno(AVS_ENOTSUP);
 }
 
 void AvsUdpSocket::close() {
-    AvsUdpRouterHandle router;
-    get_router(router);
-    if (router) {
-        router->unregister_socket(this);
+    AVS_SOCKET_TRACE(CLOSE, this, 0, 0);
+    if (router_) {
+        router_->unregister_socket(this);
     }
+    // the router cannot queue any more datagrams for this socket now
+    AvsUdpReceivedMessage *msg;
+    while ((msg = recvd_msgs_.pop_front())) {
+        delete_received_message(msg);
+    }
+    dtls_cid_size_ = 0;
     state_ = AVS_NET_SOCKET_STATE_CLOSED;
     local_address_ = SocketAddress();
     // avs_commons' contract requires that the remote port is not reset when
@@ -553,10 +1419,16 @@ AvsUdpSocket::get_opt(avs_net_socket_opt_key_t option_key,
     case AVS_NET_SOCKET_OPT_INNER_MTU: {
         avs_error_t err =
                 AvsSocket::get_opt(AVS_NET_SOCKET_OPT_MTU, out_option_value);
-        if (avs_is_err(err)) {
+        int udp_overhead;
+        if (avs_is_err(err) && pmtu_discovery_
+            && remote_address_.get_ip_version() != NSAPI_UNSPEC
+            && avs_is_ok(get_udp_overhead(&udp_overhead))) {
+            out_option_value->mtu = (int) AvsPmtuCache::current(
+                    remote_address_, (size_t) get_fallback_inner_mtu(),
+                    (size_t) max(ANJAY_MBEDOS_PMTU_MAX - udp_overhead, 0));
+        } else if (avs_is_err(err)) {
             out_option_value->mtu = get_fallback_inner_mtu();
         } else {
-            int udp_overhead;
             if (avs_is_err((err = get_udp_overhead(&udp_overhead)))) {
                 return err;
             }
@@ -573,3 +1445,78 @@ AvsUdpSocket::get_opt(avs_net_socket_opt_key_t option_key,
 }
 
 } // namespace avs_mbed_impl
+
+void AvsSocketGlobal::get_udp_router_stats(AvsUdpRouterStats *out) {
+    AvsUdpRouter::get_stats(out);
+}
+
+void AvsSocketGlobal::reset_udp_router_stats() {
+    AvsUdpRouter::reset_stats();
+}
+
+avs_error_t AvsSocketGlobal::set_shared_recv_buffers(size_t count) {
+    return AvsUdpRouter::set_shared_buffers(count);
+}
+
+#if PREREQ_MBED_OS(5, 6, 0)
+AvsUdpRxThread *AvsUdpRxThread::INSTANCE = nullptr;
+
+AvsUdpRxThread::AvsUdpRxThread(osPriority priority, uint32_t stack_size)
+        : buffer_size_(AvsSocketGlobal::recv_buffer_size()),
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+          buffer_(buffer_size_ <= sizeof(RX_THREAD_BUFFER_POOL_STORAGE)
+                          ? RX_THREAD_BUFFER_POOL_STORAGE
+                          : nullptr),
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+          buffer_(new (nothrow) uint8_t[buffer_size_]),
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+          stopping_(false),
+          wakeup_(),
+          thread_(priority, stack_size) {
+    if (!buffer_) {
+        LOG(ERROR, "could not allocate UDP RX thread buffer");
+        return;
+    }
+    {
+        ScopedLock<Mutex> lock(AvsUdpRouter::ROUTERS_MUTEX);
+        MBED_ASSERT(!INSTANCE);
+        INSTANCE = this;
+    }
+    thread_.start(callback(this, &AvsUdpRxThread::run));
+}
+
+AvsUdpRxThread::~AvsUdpRxThread() {
+    if (buffer_) {
+        {
+            ScopedLock<Mutex> lock(AvsUdpRouter::ROUTERS_MUTEX);
+#ifndef NDEBUG
+            for (RouterTable::iterator it = AvsUdpRouter::ROUTERS.begin();
+                 it != AvsUdpRouter::ROUTERS.end(); ++it) {
+                MBED_ASSERT(it->router->rx_thread_ != this);
+            }
+#endif // NDEBUG
+            INSTANCE = nullptr;
+        }
+        stopping_ = true;
+        wake_up();
+        thread_.join();
+    }
+#ifndef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    delete[] buffer_;
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+}
+
+void AvsUdpRxThread::wake_up() {
+    wakeup_.set(1);
+}
+
+void AvsUdpRxThread::run() {
+    while (true) {
+        wakeup_.wait_any(1);
+        if (stopping_) {
+            return;
+        }
+        AvsUdpRouter::rx_thread_drain_all(buffer_, buffer_size_);
+    }
+}
+#endif // PREREQ_MBED_OS(5, 6, 0)
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <Mutex.h>
+
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
+#include <avsystem/commons/avs_defs.h>
+#include <avsystem/commons/avs_time.h>
+
+#include "avs_mbed_hacks.h"
+#include "avs_pmtu_cache.h"
+
+using namespace mbed;
+using namespace rtos;
+
+namespace {
+
+// RFC 8899 recommends at least 15 s for PROBE_TIMER, but that assumes probes
+// dedicated to the search; here, a lost probe also means a lost datagram of
+// real data, so the timeout is kept close to CoAP's ACK_TIMEOUT range
+const uint32_t PMTU_PROBE_TIMEOUT_MS = 5000;
+const uint8_t MAX_PROBES = 3;
+// PMTU_RAISE_TIMER from RFC 8899
+const uint32_t PMTU_RAISE_TIMEOUT_MS = 600000;
+// the search stops when the interval is narrower than this
+const size_t PMTU_SEARCH_GRANULARITY = 16;
+
+struct PmtuEntry {
+    SocketAddress peer;
+    avs_time_monotonic_t last_used;
+    // valid while the probe size has been reported by current(), but no
+    // datagram larger than confirmed has been sent yet
+    avs_time_monotonic_t probe_offered_at;
+    // valid while a probe is in flight
+    avs_time_monotonic_t probe_sent_at;
+    // valid once the search is complete
+    avs_time_monotonic_t search_done_at;
+    // valid while nothing has been received since the first datagram larger
+    // than base that was sent after the last received one
+    avs_time_monotonic_t unanswered_since;
+    size_t base;
+    size_t max;
+    size_t confirmed;
+    // lowest size known not to work, minus one
+    size_t ceiling;
+    // 0 if the search is complete
+    size_t probe;
+    uint8_t failed_probes;
+    bool in_use;
+};
+
+Mutex PMTU_CACHE_MUTEX;
+PmtuEntry PMTU_CACHE[ANJAY_MBEDOS_PMTU_CACHE_SIZE];
+
+bool timed_out(const avs_time_monotonic_t &since,
+               const avs_time_monotonic_t &now,
+               uint32_t timeout_ms) {
+    return !avs_time_monotonic_before(
+            now,
+            avs_time_monotonic_add(
+                    since,
+                    avs_time_duration_from_scalar(timeout_ms, AVS_TIME_MS)));
+}
+
+void next_probe(PmtuEntry *entry, const avs_time_monotonic_t &now) {
+    entry->probe_offered_at = AVS_TIME_MONOTONIC_INVALID;
+    entry->probe_sent_at = AVS_TIME_MONOTONIC_INVALID;
+    entry->failed_probes = 0;
+    if (entry->ceiling < entry->confirmed + PMTU_SEARCH_GRANULARITY) {
+        entry->probe = 0;
+        entry->search_done_at = now;
+    } else if (entry->ceiling == entry->max) {
+        // nothing failed yet; most paths support the full size, so try it
+        // right away
+        entry->probe = entry->max;
+    } else {
+        entry->probe = (entry->confirmed + entry->ceiling + 1) / 2;
+    }
+}
+
+void update_timers(PmtuEntry *entry, const avs_time_monotonic_t &now) {
+    if (entry->confirmed > entry->base
+        && avs_time_monotonic_valid(entry->unanswered_since)
+        && timed_out(entry->unanswered_since, now,
+                     MAX_PROBES * PMTU_PROBE_TIMEOUT_MS)) {
+        // black hole detection (RFC 8899, section 4.3): the confirmed size
+        // may have been confirmed by an unrelated datagram, or the path may
+        // have changed; fall back to the base size and search again below
+        // the size that stopped working
+        entry->ceiling = entry->confirmed - 1;
+        entry->confirmed = entry->base;
+        entry->unanswered_since = AVS_TIME_MONOTONIC_INVALID;
+        next_probe(entry, now);
+    }
+    if (avs_time_monotonic_valid(entry->probe_offered_at)
+        && timed_out(entry->probe_offered_at, now, PMTU_PROBE_TIMEOUT_MS)) {
+        // whoever got the probe size did not use it; offer it again
+        entry->probe_offered_at = AVS_TIME_MONOTONIC_INVALID;
+    }
+    if (entry->probe && avs_time_monotonic_valid(entry->probe_sent_at)
+        && timed_out(entry->probe_sent_at, now, PMTU_PROBE_TIMEOUT_MS)) {
+        if (++entry->failed_probes < MAX_PROBES) {
+            // the next datagram of that size is another attempt
+            entry->probe_sent_at = AVS_TIME_MONOTONIC_INVALID;
+        } else {
+            entry->ceiling = entry->probe - 1;
+            next_probe(entry, now);
+        }
+    } else if (!entry->probe
+               && timed_out(entry->search_done_at, now,
+                            PMTU_RAISE_TIMEOUT_MS)) {
+        // the path might have changed since the last search
+        entry->ceiling = entry->max;
+        next_probe(entry, now);
+    }
+}
+
+PmtuEntry *find_entry(const SocketAddress &peer) {
+    for (size_t i = 0; i < AVS_ARRAY_SIZE(PMTU_CACHE); ++i) {
+        // SocketAddress::operator==() compares addresses only, not ports
+        if (PMTU_CACHE[i].in_use && PMTU_CACHE[i].peer == peer) {
+            return &PMTU_CACHE[i];
+        }
+    }
+    return nullptr;
+}
+
+PmtuEntry *create_entry(const SocketAddress &peer,
+                        size_t base,
+                        size_t max,
+                        const avs_time_monotonic_t &now) {
+    PmtuEntry *entry = &PMTU_CACHE[0];
+    for (size_t i = 0; i < AVS_ARRAY_SIZE(PMTU_CACHE); ++i) {
+        if (!PMTU_CACHE[i].in_use) {
+            entry = &PMTU_CACHE[i];
+            break;
+        }
+        if (avs_time_monotonic_before(PMTU_CACHE[i].last_used,
+                                      entry->last_used)) {
+            entry = &PMTU_CACHE[i];
+        }
+    }
+    entry->in_use = true;
+    entry->peer = peer;
+    entry->last_used = now;
+    entry->unanswered_since = AVS_TIME_MONOTONIC_INVALID;
+    entry->base = base;
+    entry->max = max > base ? max : base;
+    entry->confirmed = base;
+    entry->ceiling = entry->max;
+    next_probe(entry, now);
+    return entry;
+}
+
+} // namespace
+
+size_t
+AvsPmtuCache::current(const SocketAddress &peer, size_t base, size_t max) {
+    avs_time_monotonic_t now = avs_time_monotonic_now();
+    ScopedLock<Mutex> lock(PMTU_CACHE_MUTEX);
+    PmtuEntry *entry = find_entry(peer);
+    if (!entry) {
+        entry = create_entry(peer, base, max, now);
+    }
+    entry->last_used = now;
+    update_timers(entry, now);
+    if (entry->probe && !avs_time_monotonic_valid(entry->probe_sent_at)
+        && !avs_time_monotonic_valid(entry->probe_offered_at)) {
+        // only one datagram at a time is built with the unconfirmed size, so
+        // that real traffic is not blackholed if the probe gets lost
+        entry->probe_offered_at = now;
+        return entry->probe;
+    }
+    return entry->confirmed;
+}
+
+void AvsPmtuCache::on_sent(const SocketAddress &peer, size_t size) {
+    avs_time_monotonic_t now = avs_time_monotonic_now();
+    ScopedLock<Mutex> lock(PMTU_CACHE_MUTEX);
+    PmtuEntry *entry = find_entry(peer);
+    if (!entry) {
+        return;
+    }
+    update_timers(entry, now);
+    if (size > entry->base
+        && !avs_time_monotonic_valid(entry->unanswered_since)) {
+        entry->unanswered_since = now;
+    }
+    if (entry->probe && size > entry->confirmed
+        && !avs_time_monotonic_valid(entry->probe_sent_at)) {
+        // the datagram might be smaller than the probed size if the upper
+        // layer had less data to send; then it only confirms its own size
+        if (size < entry->probe) {
+            entry->probe = size;
+        }
+        entry->probe_offered_at = AVS_TIME_MONOTONIC_INVALID;
+        entry->probe_sent_at = now;
+    }
+}
+
+void AvsPmtuCache::on_received(const SocketAddress &peer) {
+    avs_time_monotonic_t now = avs_time_monotonic_now();
+    ScopedLock<Mutex> lock(PMTU_CACHE_MUTEX);
+    PmtuEntry *entry = find_entry(peer);
+    if (!entry) {
+        return;
+    }
+    entry->unanswered_since = AVS_TIME_MONOTONIC_INVALID;
+    if (entry->probe && avs_time_monotonic_valid(entry->probe_sent_at)) {
+        entry->confirmed = entry->probe;
+        next_probe(entry, now);
+    }
+}
+
+void AvsPmtuCache::flush() {
+    ScopedLock<Mutex> lock(PMTU_CACHE_MUTEX);
+    for (size_t i = 0; i < AVS_ARRAY_SIZE(PMTU_CACHE); ++i) {
+        PMTU_CACHE[i].in_use = false;
+    }
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AVS_PMTU_CACHE_H
+#define AVS_PMTU_CACHE_H
+
+#include <stddef.h>
+
+#include <SocketAddress.h>
+
+// Per-destination path MTU estimates for UDP sockets that have path MTU
+// discovery enabled (see AvsSocketGlobal::set_pmtu_discovery()).
+//
+// The search loosely follows Datagram PLPMTUD (RFC 8899), with regular
+// application datagrams used as probes: while a larger size is being probed,
+// current() reports it once, so that the upper layers (DTLS, CoAP block-wise
+// transfers) build one datagram of that size. Until that datagram is
+// confirmed or lost, and for PMTU_PROBE_TIMEOUT_MS if nothing larger than the
+// confirmed size is sent after all, current() reports the confirmed size, so
+// that a lost probe costs a single datagram. A probe is considered
+// acknowledged if any datagram is received from the destination after it was
+// sent, which holds for request/response protocols such as CoAP, and lost if
+// nothing arrives for PMTU_PROBE_TIMEOUT_MS in MAX_PROBES consecutive
+// attempts. The size is then lowered back to the last confirmed one, and the
+// search continues between the two with binary search.
+//
+// As any received datagram confirms a probe, a late response to an earlier
+// request may confirm a size that does not work. Black hole detection
+// (RFC 8899, section 4.3) recovers from that, as well as from path changes:
+// if datagrams larger than the base size are sent, but nothing is received
+// for MAX_PROBES * PMTU_PROBE_TIMEOUT_MS, the confirmed size drops back to
+// the base size and the search restarts below the size that stopped working.
+//
+// All sizes are UDP payload sizes. Entries are keyed by destination IP
+// address only, and the least recently used one is evicted if all
+// ANJAY_MBEDOS_PMTU_CACHE_SIZE are taken. All methods are thread-safe.
+class AvsPmtuCache {
+public:
+    // Returns the payload size to use for the next datagram to @p peer,
+    // creating the entry if necessary. @p base is the size that is assumed to
+    // always work (e.g. 548 for IPv4) and @p max is the upper limit of the
+    // search.
+    static size_t current(const SocketAddress &peer, size_t base, size_t max);
+
+    // Shall be called after a datagram of @p size bytes has been sent to
+    // @p peer.
+    static void on_sent(const SocketAddress &peer, size_t size);
+
+    // Shall be called after a datagram has been received from @p peer.
+    static void on_received(const SocketAddress &peer);
+
+    // Forgets all estimates, e.g. after a network interface change.
+    static void flush();
+};
+
+#endif /* AVS_PMTU_CACHE_H */
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+
+#include <avsystem/commons/avs_list_cxx.hpp>
+#include <avsystem/commons/avs_log.h>
+#include <avsystem/commons/avs_memory.h>
+
+#include "anjay_mbedos_posix_compat.h"
+#include "avs_mbed_hacks.h"
+#include "avs_serve_loop.h"
+#include "avs_socket_global.h"
+#include "avs_static_pool.h"
+
+using namespace avs_mbed_hacks;
+
+namespace {
+
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+// each loop gets a block large enough for the largest possible socket set
+AVS_STATIC_POOL_DEFINE(SERVE_LOOP_FDS,
+                       ANJAY_MBEDOS_STATIC_MAX_SOCKETS
+                               * sizeof(struct avs_mbedos_pollfd),
+                       ANJAY_MBEDOS_STATIC_MAX_SERVE_LOOPS);
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+
+void free_fds(struct avs_mbedos_pollfd *fds) {
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    SERVE_LOOP_FDS.free(fds);
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    avs_free(fds);
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+}
+
+struct avs_mbedos_pollfd *allocate_fds(size_t count) {
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    if (count > ANJAY_MBEDOS_STATIC_MAX_SOCKETS) {
+        return nullptr;
+    }
+    return (struct avs_mbedos_pollfd *) SERVE_LOOP_FDS.allocate();
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    return (struct avs_mbedos_pollfd *) avs_calloc(
+            count, sizeof(struct avs_mbedos_pollfd));
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+}
+
+} // namespace
+
+AvsServeLoop::AvsServeLoop(anjay_t *anjay)
+        : anjay_(anjay),
+          fds_(nullptr),
+          fds_count_(0),
+          fds_capacity_(0),
+          stop_requested_(0),
+          stats_() {
+    MBED_ASSERT(anjay);
+}
+
+AvsServeLoop::~AvsServeLoop() {
+    free_fds(fds_);
+}
+
+int AvsServeLoop::update_sockets() {
+    avs::ListView<avs_net_socket_t *const> sockets(anjay_get_sockets(anjay_));
+
+    size_t count = 0;
+    bool changed = false;
+    for (avs::ListIterator<avs_net_socket_t *const> it = sockets.begin();
+         it != sockets.end(); ++it, ++count) {
+        if (count >= fds_count_ || fds_[count].fd != *it) {
+            changed = true;
+        }
+    }
+    if (!changed && count == fds_count_) {
+        return 0;
+    }
+
+    if (count > fds_capacity_) {
+        struct avs_mbedos_pollfd *new_fds = allocate_fds(count);
+        if (!new_fds) {
+            avs_log(mbed_serve_loop, ERROR, "out of memory");
+            return -1;
+        }
+        free_fds(fds_);
+        fds_ = new_fds;
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+        fds_capacity_ = ANJAY_MBEDOS_STATIC_MAX_SOCKETS;
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+        fds_capacity_ = count;
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    }
+    fds_count_ = 0;
+    for (avs::ListIterator<avs_net_socket_t *const> it = sockets.begin();
+         it != sockets.end(); ++it) {
+        fds_[fds_count_].fd = *it;
+        fds_[fds_count_].events = AVS_MBEDOS_POLLIN;
+        ++fds_count_;
+    }
+    ++stats_.socket_set_changes;
+    return 0;
+}
+
+int AvsServeLoop::run_once(int max_wait_ms) {
+    if (update_sockets()) {
+        return -1;
+    }
+    for (size_t i = 0; i < fds_count_; ++i) {
+        fds_[i].revents = 0;
+    }
+
+    const int wait_ms = anjay_sched_calculate_wait_time_ms(anjay_, max_wait_ms);
+    const int ready = _anjay_mbedos_poll(fds_, fds_count_, wait_ms);
+    ++stats_.wakeups;
+    if (ready > 0) {
+        ++stats_.socket_wakeups;
+        for (size_t i = 0; i < fds_count_; ++i) {
+            if ((fds_[i].revents & AVS_MBEDOS_POLLIN)
+                && anjay_serve(anjay_, fds_[i].fd)) {
+                avs_log(mbed_serve_loop, ERROR, "anjay_serve failed");
+            }
+        }
+    }
+    anjay_sched_run(anjay_);
+    return 0;
+}
+
+int AvsServeLoop::run() {
+    while (!atomic_load_u32(&stop_requested_)) {
+        if (run_once()) {
+            return -1;
+        }
+    }
+    atomic_store_u32(&stop_requested_, 0);
+    return 0;
+}
+
+void AvsServeLoop::stop() {
+    atomic_store_u32(&stop_requested_, 1);
+    wake_up();
+}
+
+void AvsServeLoop::wake_up() {
+    AvsSocketGlobal::interrupt_poll();
+}
+
+void AvsServeLoop::get_stats(AvsServeLoopStats *out) const {
+    *out = stats_;
+}
+
+void AvsServeLoop::reset_stats() {
+    memset(&stats_, 0, sizeof(stats_));
+}
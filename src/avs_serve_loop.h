@@ -0,0 +1,109 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef AVS_SERVE_LOOP_H
+#define AVS_SERVE_LOOP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <anjay/anjay.h>
+
+struct avs_mbedos_pollfd;
+
+struct AvsServeLoopStats {
+    // number of loop iterations, i.e. times the loop woke up (or did not need
+    // to sleep at all, because a scheduler job was already due)
+    uint32_t wakeups;
+    // iterations in which at least one socket was ready for reading
+    uint32_t socket_wakeups;
+    // number of times the set of polled sockets had to be rebuilt
+    uint32_t socket_set_changes;
+};
+
+/**
+ * Event loop that serves an Anjay instance.
+ *
+ * Unlike a loop with a fixed maximum wait time, it sleeps until exactly one of
+ * these happens:
+ * - a socket becomes ready for reading,
+ * - the next job in Anjay's scheduler is due,
+ * - wake_up() or stop() is called from another thread.
+ *
+ * It does not hold any sleep manager locks, so in a tickless Mbed OS
+ * configuration the MCU can enter deep sleep while the loop is waiting,
+ * unless something else (e.g. the network driver) prevents it.
+ *
+ * The set of sockets to poll is only rebuilt when the list returned by
+ * anjay_get_sockets() actually changes.
+ */
+class AvsServeLoop {
+    anjay_t *anjay_;
+    struct avs_mbedos_pollfd *fds_;
+    size_t fds_count_;
+    size_t fds_capacity_;
+    volatile uint32_t stop_requested_;
+    AvsServeLoopStats stats_;
+
+    AvsServeLoop(const AvsServeLoop &);
+    AvsServeLoop &operator=(const AvsServeLoop &);
+
+    int update_sockets();
+
+public:
+    explicit AvsServeLoop(anjay_t *anjay);
+    ~AvsServeLoop();
+
+    /**
+     * Waits for the next event, serves all sockets that are ready and runs
+     * the scheduler jobs that are due.
+     *
+     * @param max_wait_ms Maximum time to wait, in milliseconds; negative
+     *                    means no limit.
+     *
+     * @returns 0 on success, or a negative value in case of an out-of-memory
+     *          condition.
+     */
+    int run_once(int max_wait_ms = -1);
+
+    /**
+     * Calls run_once() until stop() is called.
+     *
+     * @returns 0 after stop(), or a negative value if run_once() failed.
+     */
+    int run();
+
+    /**
+     * Makes run() return after the current iteration. Can be called from any
+     * thread.
+     */
+    void stop();
+
+    /**
+     * Makes the loop re-evaluate its wait time immediately; needs to be called
+     * after interacting with Anjay from other threads in a way that schedules
+     * new jobs. Can be called from any thread.
+     */
+    static void wake_up();
+
+    // NOTE: Statistics are not synchronized; reading them from a thread other
+    // than the one running the loop may yield slightly outdated values.
+    void get_stats(AvsServeLoopStats *out) const;
+    void reset_stats();
+};
+
+#endif /* AVS_SERVE_LOOP_H */
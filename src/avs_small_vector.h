@@ -0,0 +1,151 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AVS_SMALL_VECTOR_H
+#define AVS_SMALL_VECTOR_H
+
+#include <stddef.h>
+#include <string.h>
+
+#include <new>
+
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
+// Contiguous vector of trivially copyable elements (pointers, PODs), stored
+// inside the object itself as long as there are at most N of them, and in a
+// heap buffer otherwise. If ANJAY_MBEDOS_WITH_STATIC_ALLOCATION is enabled, it
+// never grows beyond N elements instead.
+//
+// Unlike avs::List, scanning it does not chase a pointer per element, and
+// adding elements only allocates memory when the inline storage is exhausted.
+// Iterators are plain pointers, so they work with <algorithm> in C++98, and
+// are invalidated by any modification.
+template <typename T, size_t N>
+class AvsSmallVector {
+    typedef char inline_capacity_must_be_positive[N > 0 ? 1 : -1];
+
+    T *data_;
+    size_t size_;
+    size_t capacity_;
+    T inline_[N];
+
+    AvsSmallVector(const AvsSmallVector &);
+    AvsSmallVector &operator=(const AvsSmallVector &);
+
+public:
+    typedef T *iterator;
+    typedef const T *const_iterator;
+
+    AvsSmallVector() : data_(inline_), size_(0), capacity_(N) {}
+
+    ~AvsSmallVector() {
+        if (data_ != inline_) {
+            operator delete(data_);
+        }
+    }
+
+    iterator begin() {
+        return data_;
+    }
+
+    iterator end() {
+        return data_ + size_;
+    }
+
+    const_iterator begin() const {
+        return data_;
+    }
+
+    const_iterator end() const {
+        return data_ + size_;
+    }
+
+    T &operator[](size_t index) {
+        return data_[index];
+    }
+
+    const T &operator[](size_t index) const {
+        return data_[index];
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return !size_;
+    }
+
+    // Number of bytes currently allocated on the heap.
+    size_t heap_bytes() const {
+        return data_ == inline_ ? 0 : capacity_ * sizeof(T);
+    }
+
+    // Returns false if the memory could not be allocated, in which case the
+    // vector is left unchanged.
+    bool reserve(size_t capacity) {
+        if (capacity <= capacity_) {
+            return true;
+        }
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+        return false;
+#else  // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+        T *data = static_cast<T *>(
+                operator new(capacity * sizeof(T), std::nothrow));
+        if (!data) {
+            return false;
+        }
+        memcpy(data, data_, size_ * sizeof(T));
+        if (data_ != inline_) {
+            operator delete(data_);
+        }
+        data_ = data;
+        capacity_ = capacity;
+        return true;
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+    }
+
+    // Inserts @p value before @p pos. Returns false if the memory could not be
+    // allocated.
+    bool insert(iterator pos, const T &value) {
+        size_t index = (size_t) (pos - data_);
+        if (size_ == capacity_ && !reserve(2 * capacity_)) {
+            return false;
+        }
+        memmove(&data_[index + 1], &data_[index],
+                (size_ - index) * sizeof(T));
+        data_[index] = value;
+        ++size_;
+        return true;
+    }
+
+    bool push_back(const T &value) {
+        return insert(end(), value);
+    }
+
+    // Returns the iterator to the element that followed the erased one.
+    iterator erase(iterator pos) {
+        memmove(pos, pos + 1, (size_t) (end() - pos - 1) * sizeof(T));
+        --size_;
+        return pos;
+    }
+
+    void clear() {
+        size_ = 0;
+    }
+};
+
+#endif /* AVS_SMALL_VECTOR_H */
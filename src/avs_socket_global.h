@@ -22,6 +22,52 @@
 #include <avsystem/commons/avs_list_cxx.hpp>
 #include <avsystem/commons/avs_net.h>
 
+struct AvsUdpRouterStats {
+    // number of mbed UDP sockets currently open
+    size_t routers;
+    // number of AvsUdpSockets registered in all routers
+    size_t sockets;
+    // number of datagrams currently waiting in per-socket receive queues
+    size_t queued_messages;
+    // largest receive queue length observed since the last reset
+    size_t queue_high_water;
+    // datagrams dropped by AvsUdpRxThread since the last reset, because the
+    // handoff ring of their router was full or memory ran out
+    uint32_t rx_handoff_drops;
+    // total number of incoming packets dropped by the default interface's
+    // network stack (not affected by reset), or -1 if not supported
+    long stack_rx_drops;
+    // RAM currently taken by datagram staging buffers: those of individual
+    // routers, the shared ones and the one of AvsUdpRxThread
+    size_t buffer_bytes;
+};
+
+struct AvsSocketModeStats {
+    // blocking mode and timeout changes of TCP sockets passed to the network
+    // stack since the last reset
+    uint32_t applied;
+    // changes skipped since the last reset, because the mbed socket already
+    // was in the requested mode
+    uint32_t skipped;
+};
+
+struct AvsSendVectoredStats {
+    // bytes copied by send_vectored() to gather scattered buffers into
+    // contiguous ones since the last reset
+    uint32_t copied_bytes;
+    // total size of gather buffers that send_vectored() allocated for the
+    // duration of a single call since the last reset; the UDP routers' TX and
+    // shared buffers are reused, and thus not included
+    uint32_t temporary_buffer_bytes;
+};
+
+// One element of a scatter-gather buffer list, see
+// AvsSocketGlobal::send_vectored()
+struct AvsIoVec {
+    const void *base;
+    size_t length;
+};
+
 class AvsSocketGlobal {
     static NetworkInterface *INTERFACE;
     static uint8_t MAX_DNS_RESULTS;
@@ -36,6 +82,43 @@ public:
     ~AvsSocketGlobal();
 
     static NetworkInterface &get_interface();
+
+    /**
+     * Registers an additional network interface under a given name. Sockets
+     * created with <c>avs_net_socket_configuration_t::interface_name</c> set
+     * to @p name will use that interface for opening mbed sockets and for DNS
+     * resolution. Sockets with an empty interface name use the default
+     * interface passed to the constructor.
+     *
+     * Each interface gets its own set of UDP routers, so sockets bound to the
+     * same local port on different interfaces are independent of each other.
+     *
+     * NOTE: Not thread safe - interfaces are meant to be registered during
+     * startup, before any sockets are created.
+     *
+     * @param name      Interface name, at most <c>IF_NAMESIZE - 1</c>
+     *                  characters long; MUST NOT be empty.
+     * @param interface Network interface to register.
+     *
+     * @returns AVS_OK for success, <c>AVS_EINVAL</c> if the name is invalid,
+     *          <c>AVS_EEXIST</c> if it is already registered, or
+     *          <c>AVS_ENOMEM</c> if <c>ANJAY_MBEDOS_MAX_NAMED_INTERFACES</c>
+     *          interfaces are already registered.
+     */
+    static avs_error_t add_interface(const char *name,
+                                     NetworkInterface *interface);
+
+    /**
+     * Unregisters an interface previously registered using add_interface().
+     * All sockets that use it MUST be closed beforehand.
+     */
+    static void remove_interface(const char *name);
+
+    /**
+     * Returns the interface registered under @p name, the default interface
+     * if @p name is empty, or NULL if no such interface is registered.
+     */
+    static NetworkInterface *find_interface(const char *name);
     static uint8_t max_dns_result();
     static size_t recv_buffer_size();
     static avs_net_af_t preferred_family();
@@ -43,6 +126,180 @@ public:
     static int poll(avs::List<avs_net_socket_t *> &out,
                     const avs::ListView<avs_net_socket_t *const> &avs_sockets,
                     uint32_t timeout_ms);
+
+    /**
+     * Causes a poll() (or the Anjay event loop's equivalent) that is currently
+     * waiting in another thread to return early, as if the timeout expired.
+     * If no poll is in progress, the next one returns immediately.
+     *
+     * Can be called from any thread; intended e.g. for notifying the thread
+     * that runs the event loop about new jobs scheduled from other threads.
+     */
+    static void interrupt_poll();
+
+    static void get_udp_router_stats(AvsUdpRouterStats *out);
+    static void reset_udp_router_stats();
+    static void get_socket_mode_stats(AvsSocketModeStats *out);
+    static void reset_socket_mode_stats();
+    static void get_send_vectored_stats(AvsSendVectoredStats *out);
+    static void reset_send_vectored_stats();
+
+    /**
+     * Configures the number of receive buffers shared by all UDP routers
+     * (i.e. mbed UDP sockets, one per local port).
+     *
+     * By default (@p count equal to 0), each router allocates its own buffer
+     * of <c>recv_buffer_size</c> bytes for reading datagrams from the network
+     * stack, and another one on first use of send_vectored(). With a shared
+     * pool, routers borrow one of @p count buffers only while reading or
+     * gathering a single datagram, so RAM use no longer grows with the number
+     * of ports in use. A pool of 1 is enough if only one thread uses sockets;
+     * if more threads use them at the same time, they may briefly wait for a
+     * buffer, but never while holding a router locked or while the network
+     * stack is not accepting data, and readiness checks (e.g. poll()) do not
+     * wait at all. Routers drained by AvsUdpRxThread do not use receive
+     * buffers at all.
+     *
+     * The current footprint is reported in AvsUdpRouterStats::buffer_bytes.
+     *
+     * If <c>ANJAY_MBEDOS_WITH_STATIC_ALLOCATION</c> is enabled, the buffers
+     * are taken from static storage for at most
+     * <c>ANJAY_MBEDOS_STATIC_RECV_BUFFERS</c> of them, and this is called
+     * with that number when AvsSocketGlobal is created. Routers never have
+     * buffers of their own in that mode, so @p count may only be 0 while
+     * AvsUdpRxThread is running.
+     *
+     * @returns AVS_OK for success, <c>AVS_EBUSY</c> if any UDP socket is
+     *          currently bound, <c>AVS_EINVAL</c> if @p count is 0 in the
+     *          static allocation mode and AvsUdpRxThread is not running, or
+     *          <c>AVS_ENOMEM</c> if the buffers could not be allocated; in
+     *          case of an error, the previous configuration is retained.
+     */
+    static avs_error_t set_shared_recv_buffers(size_t count);
+
+    /**
+     * Enables DTLS Connection ID based routing (RFC 9146) for a connected UDP
+     * socket.
+     *
+     * Normally, incoming datagrams are routed to connected sockets based on
+     * the source address only. If the peer's address changes (e.g. due to NAT
+     * rebinding), its datagrams would not reach the socket and the DTLS
+     * session would need to be established anew. If a Connection ID is set,
+     * datagrams from unknown addresses that contain a DTLS 1.2 record
+     * carrying this Connection ID are routed to the socket, so that the DTLS
+     * layer can still receive them.
+     *
+     * @param socket   UDP socket, or a DTLS socket on top of one.
+     * @param cid      Connection ID that the peer uses in records sent to us,
+     *                 i.e. the one set locally using mbedtls_ssl_set_cid().
+     * @param cid_size Size of @p cid; 0 disables Connection ID routing.
+     *
+     * NOTE: The socket's remote address is NOT updated to the new source
+     * address, so outgoing datagrams are still sent to the address the socket
+     * is connected to. RFC 9146 only allows updating it after the record has
+     * been authenticated, and the DTLS implementation in avs_commons provides
+     * no way to notify this layer about that.
+     */
+    static avs_error_t set_dtls_connection_id(avs_net_socket_t *socket,
+                                              const void *cid,
+                                              size_t cid_size);
+
+    /**
+     * Sends a single message (a datagram for UDP sockets) consisting of
+     * concatenated contents of @p iov_count buffers, as if they were passed
+     * to avs_net_socket_send() as one contiguous buffer.
+     *
+     * For TCP sockets, the buffers are passed to the network stack one by
+     * one, without being copied. For UDP sockets, they are gathered into a
+     * buffer shared by all sockets bound to the same local port, so that the
+     * caller does not need a staging buffer of its own.
+     *
+     * Sockets not created by this integration layer, e.g. DTLS sockets, can
+     * only send contiguous data, so for them the buffers are gathered into
+     * a temporary heap buffer (unless there is only one).
+     */
+    static avs_error_t send_vectored(avs_net_socket_t *socket,
+                                     const AvsIoVec *iov,
+                                     size_t iov_count);
+
+    /**
+     * Enables or disables path MTU discovery for a UDP socket.
+     *
+     * By default, unless <c>forced_mtu</c> is configured, the
+     * AVS_NET_SOCKET_OPT_INNER_MTU option of UDP sockets reports sizes that
+     * are safe on any path: 548 bytes for IPv4 and 1232 bytes for IPv6. With
+     * discovery enabled, it reports the largest size found to reach the
+     * remote host, up to ANJAY_MBEDOS_PMTU_MAX minus the IP and UDP headers,
+     * which allows e.g. larger DTLS records and CoAP blocks. The estimates
+     * are cached per remote IP address and shared by all sockets.
+     *
+     * Larger sizes are probed with regular datagrams and confirmed by any
+     * datagram received from the remote host afterwards, as is the case for
+     * CoAP requests and responses. A datagram lost while probing is not
+     * retransmitted by this layer, so this is intended for protocols that
+     * cope with lost datagrams on their own.
+     *
+     * To limit the damage of a lost probe, the size being probed is reported
+     * by a single AVS_NET_SOCKET_OPT_INNER_MTU query; other queries report the
+     * last confirmed size until that probe is confirmed or times out (after
+     * 5 seconds; the size is then retried up to 3 times before the search
+     * moves on). The remaining risks are:
+     * - if the probe is lost, so are the upper layer's retransmissions of
+     *   the same datagram, as they have the same size; e.g. the CoAP exchange
+     *   that carried the probe fails,
+     * - an upper layer that caches the reported value keeps building
+     *   datagrams of the probed size until it queries the option again.
+     *
+     * A size may also be confirmed wrongly, e.g. by a late response to an
+     * earlier, smaller request, or stop working when the path changes. If
+     * datagrams larger than the base size are sent, but nothing is received
+     * from the remote host for 15 seconds, the reported size therefore falls
+     * back to the base size, and the search starts again below the size that
+     * stopped working. Protocols in which the remote host may legitimately
+     * stay silent for that long, e.g. non-confirmable notifications, cause
+     * such fallbacks as well; they only cost another search.
+     *
+     * @param socket  UDP socket, or a DTLS socket on top of one.
+     * @param enabled Whether to enable path MTU discovery.
+     */
+    static avs_error_t set_pmtu_discovery(avs_net_socket_t *socket,
+                                          bool enabled);
+
+    /**
+     * Enables or disables non-blocking connect mode for a TCP socket. It
+     * needs to be set before calling avs_net_socket_connect().
+     *
+     * By default, avs_net_socket_connect() blocks for up to 10 seconds for
+     * every address the host name resolves to. In non-blocking mode, if the
+     * connection cannot be established immediately, it returns
+     * <c>AVS_EINPROGRESS</c> after starting an attempt to connect to the
+     * first address (name resolution is still blocking). The attempt then
+     * progresses in the network stack; when it finishes, the socket's sigio
+     * wakes up AvsSocketGlobal::poll() and the Anjay event loop, and the socket
+     * becomes ready for writing, i.e. reported with <c>AVS_MBEDOS_POLLOUT</c>
+     * by <c>_anjay_mbedos_poll()</c>. The result can then be collected using
+     * finish_connect(). Sending and receiving also finish the connection
+     * first, and fail with <c>AVS_EINPROGRESS</c> while it is pending.
+     *
+     * Only plain TCP sockets are supported, as TLS sockets perform the
+     * handshake right after connecting.
+     *
+     * @returns AVS_OK for success, or <c>AVS_ENOTSUP</c> if @p socket is not
+     *          a TCP socket created by this integration layer.
+     */
+    static avs_error_t set_nonblocking_connect(avs_net_socket_t *socket,
+                                               bool enabled);
+
+    /**
+     * Collects the result of a non-blocking connection attempt, see
+     * set_nonblocking_connect().
+     *
+     * @returns AVS_OK if the socket is connected, <c>AVS_EINPROGRESS</c> if
+     *          the attempt is still in progress, or the error that made it
+     *          fail, in which case the socket is closed. If no connection has
+     *          been attempted, <c>AVS_ENOTCONN</c> is returned.
+     */
+    static avs_error_t finish_connect(avs_net_socket_t *socket);
 };
 
 #endif /* AVS_SOCKET_GLOBAL_H */
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <hal/us_ticker_api.h>
+#include <mbed_assert.h>
+#include <mbed_critical.h>
+
+#include "avs_socket_trace.h"
+
+#ifdef ANJAY_MBEDOS_WITH_SOCKET_TRACE
+
+namespace {
+
+MBED_STATIC_ASSERT(sizeof(AvsSocketTraceRecord) == 16,
+                   "AvsSocketTraceRecord is expected to be 16 bytes long");
+MBED_STATIC_ASSERT((ANJAY_MBEDOS_SOCKET_TRACE_BUFFER_SIZE
+                    & (ANJAY_MBEDOS_SOCKET_TRACE_BUFFER_SIZE - 1))
+                           == 0,
+                   "ANJAY_MBEDOS_SOCKET_TRACE_BUFFER_SIZE must be a power "
+                   "of two");
+
+AvsSocketTraceRecord TRACE_BUFFER[ANJAY_MBEDOS_SOCKET_TRACE_BUFFER_SIZE];
+volatile uint32_t TRACE_RECORDS_WRITTEN;
+
+} // namespace
+
+void AvsSocketTrace::record(AvsSocketTraceEvent event,
+                            const void *object,
+                            uint32_t arg0,
+                            uint32_t arg1) {
+    // reserve a slot first, so that concurrent writers never share one
+    uint32_t index = core_util_atomic_incr_u32(&TRACE_RECORDS_WRITTEN, 1) - 1;
+    AvsSocketTraceRecord &record =
+            TRACE_BUFFER[index & (ANJAY_MBEDOS_SOCKET_TRACE_BUFFER_SIZE - 1)];
+    record.timestamp_us = us_ticker_read();
+    record.event = (uint16_t) event;
+    record.socket_id = (uint16_t) ((uintptr_t) object >> 2);
+    record.arg0 = arg0;
+    record.arg1 = arg1;
+}
+
+void AvsSocketTrace::dump(WriteFunc *write, void *arg) {
+    uint32_t written = TRACE_RECORDS_WRITTEN;
+    AvsSocketTraceDumpHeader header;
+    memcpy(header.magic, "AMST", sizeof(header.magic));
+    header.version = 1;
+    header.record_size = sizeof(AvsSocketTraceRecord);
+    header.capacity = ANJAY_MBEDOS_SOCKET_TRACE_BUFFER_SIZE;
+    header.records_written = written;
+    write(&header, sizeof(header), arg);
+
+    uint32_t count = written;
+    if (count > ANJAY_MBEDOS_SOCKET_TRACE_BUFFER_SIZE) {
+        count = ANJAY_MBEDOS_SOCKET_TRACE_BUFFER_SIZE;
+    }
+    for (uint32_t i = written - count; i != written; ++i) {
+        write(&TRACE_BUFFER[i & (ANJAY_MBEDOS_SOCKET_TRACE_BUFFER_SIZE - 1)],
+              sizeof(AvsSocketTraceRecord), arg);
+    }
+}
+
+void AvsSocketTrace::reset() {
+    core_util_critical_section_enter();
+    TRACE_RECORDS_WRITTEN = 0;
+    core_util_critical_section_exit();
+}
+
+#endif // ANJAY_MBEDOS_WITH_SOCKET_TRACE
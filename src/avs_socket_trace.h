@@ -0,0 +1,110 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AVS_SOCKET_TRACE_H
+#define AVS_SOCKET_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
+#include <avsystem/commons/avs_errno.h>
+
+// Binary trace of the socket layer. Each trace point stores a fixed-size
+// record in a RAM ring buffer, so unlike avs_log, it does not format any
+// strings and does not block on the output device. The buffer is dumped as raw
+// bytes and decoded offline with tools/socket_trace_decode.py.
+//
+// NOTE: Event identifiers and the dump format are mirrored in the decoder;
+// please keep both in sync when changing them.
+
+enum AvsSocketTraceEvent {
+    // arg0: number of sockets, arg1: timeout in ms
+    AVS_SOCKET_TRACE_POLL_BEGIN = 1,
+    // arg0: number of sockets ready
+    AVS_SOCKET_TRACE_POLL_END = 2,
+    // arg0: 1 if ready, 0 otherwise; arg1: nsapi result of the probe
+    AVS_SOCKET_TRACE_READY = 3,
+    // arg0: error, arg1: remote port
+    AVS_SOCKET_TRACE_CONNECT = 4,
+    // arg0: error, arg1: local port
+    AVS_SOCKET_TRACE_BIND = 5,
+    // arg0: error
+    AVS_SOCKET_TRACE_ACCEPT = 6,
+    // arg0: length, arg1: error
+    AVS_SOCKET_TRACE_SEND = 7,
+    // arg0: length, arg1: error
+    AVS_SOCKET_TRACE_RECV = 8,
+    AVS_SOCKET_TRACE_CLOSE = 9,
+    // arg0: datagram size, arg1: peer port
+    AVS_SOCKET_TRACE_ROUTER_RECV = 10,
+    // arg0: datagram size, arg1: peer port
+    AVS_SOCKET_TRACE_ROUTER_DROP = 11,
+    // arg0: datagram size, arg1: new peer port
+    AVS_SOCKET_TRACE_ROUTER_CID_MATCH = 12
+};
+
+struct AvsSocketTraceRecord {
+    uint32_t timestamp_us; // lower 32 bits of the microsecond ticker
+    uint16_t event;        // AvsSocketTraceEvent
+    uint16_t socket_id;    // derived from the address of the traced object
+    uint32_t arg0;
+    uint32_t arg1;
+};
+
+struct AvsSocketTraceDumpHeader {
+    char magic[4]; // "AMST"
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t capacity;
+    uint32_t records_written;
+};
+
+class AvsSocketTrace {
+public:
+    typedef void WriteFunc(const void *data, size_t size, void *arg);
+
+    static void record(AvsSocketTraceEvent event,
+                       const void *object,
+                       uint32_t arg0,
+                       uint32_t arg1);
+
+    static uint32_t error_arg(avs_error_t err) {
+        return ((uint32_t) err.category << 16) | err.code;
+    }
+
+    /**
+     * Writes AvsSocketTraceDumpHeader followed by all records that are still
+     * in the buffer, oldest first.
+     *
+     * Records are not locked while being dumped, so the last few records might
+     * be inconsistent if trace points are hit concurrently.
+     */
+    static void dump(WriteFunc *write, void *arg);
+
+    static void reset();
+};
+
+#ifdef ANJAY_MBEDOS_WITH_SOCKET_TRACE
+#define AVS_SOCKET_TRACE(Event, Object, Arg0, Arg1)                 \
+    AvsSocketTrace::record(AVS_SOCKET_TRACE_##Event, (Object),      \
+                           (uint32_t) (Arg0), (uint32_t) (Arg1))
+#else // ANJAY_MBEDOS_WITH_SOCKET_TRACE
+#define AVS_SOCKET_TRACE(Event, Object, Arg0, Arg1) ((void) 0)
+#endif // ANJAY_MBEDOS_WITH_SOCKET_TRACE
+
+#endif /* AVS_SOCKET_TRACE_H */
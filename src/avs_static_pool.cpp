@@ -0,0 +1,50 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <mbed_assert.h>
+#include <mbed_critical.h>
+
+#include "avs_static_pool.h"
+
+#ifdef ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
+
+void *AvsStaticPool::allocate() {
+    void *block = NULL;
+    core_util_critical_section_enter();
+    if (free_list) {
+        block = free_list;
+        free_list = *static_cast<void **>(block);
+    } else if (touched_count < block_count) {
+        block = &storage[touched_count++ * block_size];
+    }
+    core_util_critical_section_exit();
+    return block;
+}
+
+void AvsStaticPool::free(void *block) {
+    if (!block) {
+        return;
+    }
+    MBED_ASSERT(static_cast<uint8_t *>(block) >= storage
+                && static_cast<uint8_t *>(block)
+                           < &storage[touched_count * block_size]);
+    core_util_critical_section_enter();
+    *static_cast<void **>(block) = free_list;
+    free_list = block;
+    core_util_critical_section_exit();
+}
+
+#endif // ANJAY_MBEDOS_WITH_STATIC_ALLOCATION
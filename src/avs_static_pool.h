@@ -0,0 +1,64 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AVS_STATIC_POOL_H
+#define AVS_STATIC_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
+// Allocator of fixed-size blocks carved out of statically allocated storage,
+// used instead of the heap if ANJAY_MBEDOS_WITH_STATIC_ALLOCATION is enabled.
+//
+// Pools are aggregates, so that they are initialized at compile time and can
+// be used during static initialization of other objects; they MUST only be
+// defined using AVS_STATIC_POOL_DEFINE(). Blocks that have never been used are
+// handed out in order, and freed ones are linked through their first bytes,
+// so both operations take constant time. They are done in critical sections,
+// so pools can be used from any thread, without a mutex.
+//
+// The storage of each pool is named <name>_POOL_STORAGE, which is what
+// tools/static_ram_report.py looks for in the linked firmware.
+struct AvsStaticPool {
+    uint8_t *const storage;
+    const size_t block_size;
+    const size_t block_count;
+    // number of blocks that have been handed out at least once
+    size_t touched_count;
+    void *free_list;
+
+    // Returns NULL if all blocks are in use.
+    void *allocate();
+    // @p block MUST have been returned by allocate() of this pool, or be NULL.
+    void free(void *block);
+};
+
+// blocks are aligned for any type that the network layer stores in them
+#define AVS_STATIC_POOL_BLOCK_SIZE(BlockSize) \
+    (((BlockSize) + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t))
+
+#define AVS_STATIC_POOL_DEFINE(Name, BlockSize, BlockCount)                 \
+    uint64_t Name##_POOL_STORAGE                                            \
+            [(BlockCount) ? (BlockCount) *AVS_STATIC_POOL_BLOCK_SIZE(       \
+                                    BlockSize) / sizeof(uint64_t)           \
+                          : 1];                                             \
+    AvsStaticPool Name = { reinterpret_cast<uint8_t *>(Name##_POOL_STORAGE), \
+                           AVS_STATIC_POOL_BLOCK_SIZE(BlockSize),           \
+                           (BlockCount), 0, NULL }
+
+#endif /* AVS_STATIC_POOL_H */
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AVS_UDP_RX_THREAD_H
+#define AVS_UDP_RX_THREAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <EventFlags.h>
+#include <Thread.h>
+
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
+namespace avs_mbed_impl {
+class AvsUdpRouter;
+} // namespace avs_mbed_impl
+
+/**
+ * Dedicated thread that receives datagrams on behalf of UDP sockets.
+ *
+ * By default, datagrams are read from the network stack only when a thread
+ * calls avs_net_socket_receive() or checks the socket for readiness, i.e.
+ * typically on the Anjay thread. While that thread is busy, e.g. in a
+ * long-running data model handler, incoming datagrams occupy the network
+ * stack's buffers (the pbuf pool on lwIP), and further ones are dropped by the
+ * stack.
+ *
+ * While an instance of this class exists, newly bound UDP sockets are instead
+ * drained by a separate, typically high-priority, thread as soon as the
+ * network stack signals incoming data. The datagrams are passed to the
+ * sockets' receive queues through a lock-free ring of
+ * ANJAY_MBEDOS_UDP_RX_RING_SIZE entries per local port; if the ring is full,
+ * they are dropped and counted in AvsUdpRouterStats::rx_handoff_drops.
+ *
+ * Only one instance may exist at a time. It only affects sockets bound after
+ * it has been created, so it shall be created right after AvsSocketGlobal:
+ *
+ * @code
+ * AvsSocketGlobal avs(&network, 4, 4096, AVS_NET_AF_INET4);
+ * AvsUdpRxThread rx_thread;
+ * @endcode
+ *
+ * It MUST NOT be destroyed before all UDP sockets are closed. If the receive
+ * buffer (of the size configured in AvsSocketGlobal) cannot be allocated, the
+ * thread is not started and sockets are drained as if it did not exist. If
+ * ANJAY_MBEDOS_WITH_STATIC_ALLOCATION is enabled, the buffer and the handed
+ * off datagrams are statically allocated; the thread stack is still allocated
+ * by Mbed OS when the thread is started.
+ *
+ * Requires mbed OS 5.6 or newer.
+ */
+class AvsUdpRxThread {
+public:
+    AvsUdpRxThread(osPriority priority = osPriorityHigh,
+                   uint32_t stack_size = 2048);
+    ~AvsUdpRxThread();
+
+private:
+    friend class avs_mbed_impl::AvsUdpRouter;
+
+    static AvsUdpRxThread *INSTANCE;
+
+    size_t buffer_size_;
+    uint8_t *buffer_;
+    volatile bool stopping_;
+    rtos::EventFlags wakeup_;
+    rtos::Thread thread_;
+
+    AvsUdpRxThread(const AvsUdpRxThread &);
+    AvsUdpRxThread &operator=(const AvsUdpRxThread &);
+
+    void run();
+    void wake_up();
+};
+
+#endif /* AVS_UDP_RX_THREAD_H */
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef AVS_X509_CACHE_H
+#define AVS_X509_CACHE_H
+
+// Certificates loaded from files (e.g. trust stores configured using
+// avs_crypto_certificate_chain_info_from_file() or _from_path()) are cached
+// in RAM in DER form, so that subsequent TLS connections do not need to read
+// and decode them again. Cache entries are invalidated when the file's
+// modification time or size changes.
+//
+// Some file systems (e.g. LittleFS) do not track modification times, so if a
+// certificate file is replaced with one of the same size, the cache needs to
+// be flushed explicitly.
+
+class AvsX509Cache {
+public:
+    static void flush();
+};
+
+#endif /* AVS_X509_CACHE_H */
@@ -0,0 +1,278 @@
+/*
+ * Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef TARGET_ANJAY_MBEDOS_HOST
+#include <dirent.h>
+#include <sys/stat.h>
+#else // TARGET_ANJAY_MBEDOS_HOST
+#include <mbed_retarget.h>
+#endif // TARGET_ANJAY_MBEDOS_HOST
+
+#include <Mutex.h>
+
+#include <anjay_mbedos/anjay_mbedos_config.h>
+
+#include <avsystem/commons/avs_defs.h>
+#include <avsystem/commons/avs_memory.h>
+#include <avsystem/commons/avs_utils.h>
+
+/*
+ * Mbed OS configures Mbed TLS without MBEDTLS_FS_IO, but avs_commons SSL
+ * implementation calls the functions below nevertheless. We implement them
+ * here using the POSIX-like file API that Mbed OS provides for mounted
+ * FileSystem instances (e.g. paths like "/fs/certs/ca.pem").
+ */
+#define MBEDTLS_FS_IO
+#include "mbedtls/pk.h"
+#include "mbedtls/platform_util.h"
+#include "mbedtls/x509_crt.h"
+
+#include "avs_mbed_hacks.h"
+#include "avs_x509_cache.h"
+
+using namespace rtos;
+
+namespace {
+
+struct X509CacheEntry {
+    char *path;
+    time_t mtime;
+    off_t size;
+    uint32_t last_used;
+    // number of certificates in the file that failed to parse
+    int parse_result;
+    size_t der_size;
+    // sequence of: uint32_t length (unaligned), DER-encoded certificate
+    uint8_t *der;
+};
+
+Mutex X509_CACHE_MUTEX;
+X509CacheEntry X509_CACHE[ANJAY_MBEDOS_X509_CACHE_SIZE];
+uint32_t X509_CACHE_CLOCK;
+
+void clear_entry(X509CacheEntry *entry) {
+    avs_free(entry->path);
+    avs_free(entry->der);
+    memset(entry, 0, sizeof(*entry));
+}
+
+X509CacheEntry *find_entry(const char *path) {
+    for (size_t i = 0; i < AVS_ARRAY_SIZE(X509_CACHE); ++i) {
+        if (X509_CACHE[i].path && !strcmp(X509_CACHE[i].path, path)) {
+            return &X509_CACHE[i];
+        }
+    }
+    return nullptr;
+}
+
+X509CacheEntry *least_recently_used_entry() {
+    X509CacheEntry *result = &X509_CACHE[0];
+    for (size_t i = 1; i < AVS_ARRAY_SIZE(X509_CACHE); ++i) {
+        if (!X509_CACHE[i].path) {
+            return &X509_CACHE[i];
+        }
+        if (X509_CACHE_CLOCK - X509_CACHE[i].last_used
+            > X509_CACHE_CLOCK - result->last_used) {
+            result = &X509_CACHE[i];
+        }
+    }
+    return result;
+}
+
+/**
+ * Reads the whole file into a newly allocated, nullbyte-terminated buffer.
+ * Like in mbedtls_pk_load_file(), the terminator is included in the size for
+ * PEM files, as Mbed TLS requires that.
+ */
+int load_file(const char *path, unsigned char **out_buf, size_t *out_size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+    int result = -1;
+    long size;
+    if (!fseek(f, 0, SEEK_END) && (size = ftell(f)) >= 0
+        && !fseek(f, 0, SEEK_SET)
+        && (*out_buf = (unsigned char *) avs_malloc((size_t) size + 1))) {
+        if (fread(*out_buf, 1, (size_t) size, f) == (size_t) size) {
+            (*out_buf)[size] = '\0';
+            *out_size = (size_t) size;
+            if (strstr((const char *) *out_buf, "-----BEGIN ")) {
+                ++*out_size;
+            }
+            result = 0;
+        } else {
+            avs_free(*out_buf);
+            *out_buf = nullptr;
+        }
+    }
+    fclose(f);
+    return result;
+}
+
+int fill_entry(X509CacheEntry *entry, const char *path) {
+    unsigned char *buf = nullptr;
+    size_t size = 0;
+    if (load_file(path, &buf, &size)) {
+        return MBEDTLS_ERR_X509_FILE_IO_ERROR;
+    }
+    mbedtls_x509_crt chain;
+    mbedtls_x509_crt_init(&chain);
+    int result = mbedtls_x509_crt_parse(&chain, buf, size);
+    avs_free(buf);
+    if (result < 0) {
+        mbedtls_x509_crt_free(&chain);
+        return result;
+    }
+
+    size_t der_size = 0;
+    for (mbedtls_x509_crt *crt = &chain; crt && crt->raw.len;
+         crt = crt->next) {
+        der_size += sizeof(uint32_t) + crt->raw.len;
+    }
+    uint8_t *der = (uint8_t *) avs_malloc(der_size);
+    char *path_copy = avs_strdup(path);
+    if (!der || !path_copy) {
+        avs_free(der);
+        avs_free(path_copy);
+        mbedtls_x509_crt_free(&chain);
+        return MBEDTLS_ERR_X509_ALLOC_FAILED;
+    }
+    uint8_t *ptr = der;
+    for (mbedtls_x509_crt *crt = &chain; crt && crt->raw.len;
+         crt = crt->next) {
+        const uint32_t len = (uint32_t) crt->raw.len;
+        memcpy(ptr, &len, sizeof(len));
+        memcpy(ptr + sizeof(len), crt->raw.p, crt->raw.len);
+        ptr += sizeof(len) + crt->raw.len;
+    }
+    mbedtls_x509_crt_free(&chain);
+
+    clear_entry(entry);
+    entry->path = path_copy;
+    entry->parse_result = result;
+    entry->der_size = der_size;
+    entry->der = der;
+    return 0;
+}
+
+int append_from_entry(mbedtls_x509_crt *chain, const X509CacheEntry *entry) {
+    const uint8_t *ptr = entry->der;
+    const uint8_t *end = entry->der + entry->der_size;
+    while (ptr < end) {
+        uint32_t len;
+        memcpy(&len, ptr, sizeof(len));
+        int result = mbedtls_x509_crt_parse_der(chain, ptr + sizeof(len), len);
+        if (result) {
+            return result;
+        }
+        ptr += sizeof(len) + len;
+    }
+    return entry->parse_result;
+}
+
+} // namespace
+
+void AvsX509Cache::flush() {
+    X509_CACHE_MUTEX.lock();
+    for (size_t i = 0; i < AVS_ARRAY_SIZE(X509_CACHE); ++i) {
+        clear_entry(&X509_CACHE[i]);
+    }
+    X509_CACHE_MUTEX.unlock();
+}
+
+extern "C" {
+
+int mbedtls_x509_crt_parse_file(mbedtls_x509_crt *chain, const char *path) {
+    struct stat st;
+    if (stat(path, &st) || !S_ISREG(st.st_mode)) {
+        return MBEDTLS_ERR_X509_FILE_IO_ERROR;
+    }
+
+    X509_CACHE_MUTEX.lock();
+    X509CacheEntry *entry = find_entry(path);
+    int result = 0;
+    if (!entry || entry->mtime != st.st_mtime || entry->size != st.st_size) {
+        if (!entry) {
+            entry = least_recently_used_entry();
+        }
+        if ((result = fill_entry(entry, path))) {
+            clear_entry(entry);
+        } else {
+            entry->mtime = st.st_mtime;
+            entry->size = st.st_size;
+        }
+    }
+    if (!result) {
+        entry->last_used = ++X509_CACHE_CLOCK;
+        result = append_from_entry(chain, entry);
+    }
+    X509_CACHE_MUTEX.unlock();
+    return result;
+}
+
+int mbedtls_x509_crt_parse_path(mbedtls_x509_crt *chain, const char *path) {
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return MBEDTLS_ERR_X509_FILE_IO_ERROR;
+    }
+    // semantics as in Mbed TLS: number of certificates or files that failed
+    // to parse, or a negative error code if the directory could not be read
+    int result = 0;
+    const size_t path_length = strlen(path);
+    struct dirent *dirent;
+    while ((dirent = readdir(dir))) {
+        const size_t entry_path_size =
+                path_length + strlen(dirent->d_name) + 2;
+        char *entry_path = (char *) avs_malloc(entry_path_size);
+        if (!entry_path) {
+            result = MBEDTLS_ERR_X509_ALLOC_FAILED;
+            break;
+        }
+        snprintf(entry_path, entry_path_size, "%s/%s", path, dirent->d_name);
+        struct stat st;
+        if (!stat(entry_path, &st) && S_ISREG(st.st_mode)) {
+            int file_result = mbedtls_x509_crt_parse_file(chain, entry_path);
+            result += (file_result < 0 ? 1 : file_result);
+        }
+        avs_free(entry_path);
+    }
+    closedir(dir);
+    return result;
+}
+
+int mbedtls_pk_parse_keyfile(mbedtls_pk_context *ctx,
+                             const char *path,
+                             const char *password) {
+    // private keys are deliberately not cached
+    unsigned char *buf = nullptr;
+    size_t size = 0;
+    if (load_file(path, &buf, &size)) {
+        return MBEDTLS_ERR_PK_FILE_IO_ERROR;
+    }
+    int result = mbedtls_pk_parse_key(
+            ctx, buf, size, (const unsigned char *) password,
+            password ? strlen(password) : 0);
+    mbedtls_platform_zeroize(buf, size);
+    avs_free(buf);
+    return result;
+}
+
+} // extern "C"
@@ -18,16 +18,6 @@
 #include <avsystem/commons/avs_time.h>
 
 #include "timing_alt.h"
-/*
- * For forward declarations of:
- * - mbedtls_x509_crt_parse_path
- * - mbedtls_x509_crt_parse_file
- * - mbedtls_pk_parse_keyfile
- */
-#define MBEDTLS_FS_IO
-#include "mbedtls/entropy_poll.h"
-#include "mbedtls/pk.h"
-#include "mbedtls/x509_crt.h"
 
 /*
  * mbedtls_timing_set_delay, mbedtls_timing_get_delay and
@@ -37,6 +27,12 @@
 
 /*
  * Set delays to watch
+ *
+ * Expiring delays do not wake up AvsSocketGlobal::poll() or
+ * _anjay_mbedos_poll(): that would only help if the socket owning the delay
+ * was reported as ready, but avs_commons keeps the context private to its SSL
+ * socket, so there is no way to map it back. Handshakes are unaffected, as the
+ * receive timeouts in avs_net_socket_connect() follow these delays.
  */
 void mbedtls_timing_set_delay(void *data, uint32_t int_ms, uint32_t fin_ms) {
     mbedtls_timing_delay_context *ctx = (mbedtls_timing_delay_context *) data;
@@ -87,27 +83,3 @@ unsigned long mbedtls_timing_get_timer(struct mbedtls_timing_hr_time *val,
                                 avs_time_monotonic_diff(offset, *start));
     return (unsigned long) delta;
 }
-
-/** We do not implement any kind of filesystem; these mocks are required
- * by avs_commons SSL implementation, even though we do not use them */
-int mbedtls_x509_crt_parse_path(mbedtls_x509_crt *chain, const char *path) {
-    (void) chain;
-    (void) path;
-    puts("filesystem not supported");
-    return -1;
-}
-int mbedtls_x509_crt_parse_file(mbedtls_x509_crt *chain, const char *path) {
-    (void) chain;
-    (void) path;
-    puts("filesystem not supported");
-    return -1;
-}
-int mbedtls_pk_parse_keyfile(mbedtls_pk_context *ctx,
-                             const char *path,
-                             const char *password) {
-    (void) ctx;
-    (void) path;
-    (void) password;
-    puts("filesystem not supported");
-    return -1;
-}
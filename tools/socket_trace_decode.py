@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Decodes socket trace dumps produced by AvsSocketTrace::dump().
+
+The input is either the raw dump (default) or its hexadecimal representation
+(--hex), e.g. copied from a serial console. Whitespace in hex input is ignored.
+"""
+
+import argparse
+import binascii
+import struct
+import sys
+
+HEADER = struct.Struct('<4sHHII')
+RECORD = struct.Struct('<IHHII')
+
+# NOTE: keep in sync with AvsSocketTraceEvent in src/avs_socket_trace.h
+EVENTS = {
+    1: ('POLL_BEGIN', 'sockets', 'timeout_ms'),
+    2: ('POLL_END', 'ready', None),
+    3: ('READY', 'ready', 'nsapi_result'),
+    4: ('CONNECT', 'error', 'port'),
+    5: ('BIND', 'error', 'port'),
+    6: ('ACCEPT', 'nsapi_result', 'port'),
+    7: ('SEND', 'length', 'nsapi_result'),
+    8: ('RECV', 'length', 'nsapi_result'),
+    9: ('CLOSE', None, None),
+    10: ('ROUTER_RECV', 'length', 'peer_port'),
+    11: ('ROUTER_DROP', 'length', 'peer_port'),
+    12: ('ROUTER_CID_MATCH', 'length', 'peer_port'),
+}
+
+
+def format_arg(name, value):
+    if name == 'error':
+        if value == 0:
+            return 'error=OK'
+        return 'error=%d:%d' % (value >> 16, value & 0xFFFF)
+    if name == 'nsapi_result' or name == 'timeout_ms':
+        # these are signed values
+        return '%s=%d' % (name, struct.unpack('<i', struct.pack('<I', value))[0])
+    return '%s=%d' % (name, value)
+
+
+def decode(data):
+    if len(data) < HEADER.size:
+        raise ValueError('dump too short')
+    magic, version, record_size, capacity, written = HEADER.unpack_from(data)
+    if magic != b'AMST' or version != 1:
+        raise ValueError('not a socket trace dump (version 1)')
+    if record_size != RECORD.size:
+        raise ValueError('unexpected record size: %d' % (record_size,))
+
+    count = min(written, capacity)
+    print('# %d records written, %d available, %d lost'
+          % (written, count, written - count))
+    offset = HEADER.size
+    base_us = None
+    wraps = 0
+    last_ts = None
+    for _ in range(count):
+        if offset + RECORD.size > len(data):
+            print('# dump truncated')
+            break
+        ts, event, socket_id, arg0, arg1 = RECORD.unpack_from(data, offset)
+        offset += RECORD.size
+        # the ticker is only stored as 32 bits, it wraps every ~71 minutes
+        if last_ts is not None and ts < last_ts:
+            wraps += 1
+        last_ts = ts
+        ts += wraps << 32
+        if base_us is None:
+            base_us = ts
+        name, arg0_name, arg1_name = EVENTS.get(
+            event, ('UNKNOWN(%d)' % (event,), 'arg0', 'arg1'))
+        args = []
+        if arg0_name:
+            args.append(format_arg(arg0_name, arg0))
+        if arg1_name:
+            args.append(format_arg(arg1_name, arg1))
+        print('%12.6f %04x %-12s %s' % ((ts - base_us) / 1e6, socket_id, name,
+                                        ' '.join(args)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('file', nargs='?', default='-',
+                        help='dump file, or - for standard input')
+    parser.add_argument('--hex', action='store_true',
+                        help='input is hex-encoded')
+    args = parser.parse_args()
+
+    if args.file == '-':
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.file, 'rb') as f:
+            data = f.read()
+    if args.hex:
+        data = binascii.unhexlify(b''.join(data.split()))
+
+    try:
+        decode(data)
+    except ValueError as e:
+        sys.exit('error: %s' % (e,))
+
+
+if __name__ == '__main__':
+    main()
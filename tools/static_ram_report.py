@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020-2022 AVSystem <avsystem@avsystem.com>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Reports RAM reserved by the static allocation mode of the network layer.
+
+If ANJAY_MBEDOS_WITH_STATIC_ALLOCATION is enabled, all pools and buffers of
+the network layer are arrays named <name>_POOL_STORAGE (see
+src/avs_static_pool.h). This script lists them, with their sizes, in a linked
+firmware image or in an object file, using GNU nm or a compatible tool, e.g.:
+
+    tools/static_ram_report.py --nm arm-none-eabi-nm BUILD/firmware.elf
+
+The output of "nm -S -C" may also be passed on standard input instead.
+"""
+
+import argparse
+import json
+import re
+import subprocess
+import sys
+
+STORAGE_RE = re.compile(r'(?:^|::)(\w+)_POOL_STORAGE$')
+
+
+def parse_nm(lines):
+    pools = {}
+    for line in lines:
+        # address, size, type, name; symbols without a size are skipped
+        fields = line.split(None, 3)
+        if len(fields) != 4:
+            continue
+        match = STORAGE_RE.search(fields[3].strip())
+        if not match:
+            continue
+        try:
+            size = int(fields[1], 16)
+        except ValueError:
+            continue
+        # the same symbol may appear in several object files
+        pools[match.group(1)] = size
+    return pools
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument('file', nargs='?', default='-',
+                        help='firmware image or object file, or - to read '
+                             'nm output from standard input')
+    parser.add_argument('--nm', default='nm', help='nm executable to use')
+    parser.add_argument('--json', action='store_true',
+                        help='print the report as JSON')
+    args = parser.parse_args()
+
+    if args.file == '-':
+        lines = sys.stdin.read().splitlines()
+    else:
+        try:
+            output = subprocess.check_output([args.nm, '-S', '-C', args.file],
+                                             universal_newlines=True)
+        except (OSError, subprocess.CalledProcessError) as e:
+            sys.exit('error: could not run %s: %s' % (args.nm, e))
+        lines = output.splitlines()
+
+    pools = parse_nm(lines)
+    if not pools:
+        sys.exit('error: no static pools found; is '
+                 'ANJAY_MBEDOS_WITH_STATIC_ALLOCATION enabled?')
+    total = sum(pools.values())
+    if args.json:
+        json.dump({'pools': pools, 'total_bytes': total}, sys.stdout,
+                  indent=2, sort_keys=True)
+        sys.stdout.write('\n')
+        return
+    width = max(len(name) for name in pools)
+    for name in sorted(pools, key=lambda name: (-pools[name], name)):
+        print('%-*s %8d' % (width, name, pools[name]))
+    print('%-*s %8d' % (width, 'total', total))
+
+
+if __name__ == '__main__':
+    main()